@@ -1,15 +1,26 @@
 #pragma once
 
 #include "window.hpp"
-#include "game_object.hpp"
+#include "bench.hpp"
+#include "bvh.hpp"
+#include "components.hpp"
+#include "scene.hpp"
 #include "device.hpp"
+#include "geometry_arena.hpp"
 #include "renderer.hpp"
 #include "descriptors.hpp"
 #include "object_manager.hpp"
+#include "static_batcher.hpp"
+#include "static_chunks.hpp"
 #include "light_object.hpp"
 #include "frame_info.hpp"
+#include "frame_ring_buffer.hpp"
+#include "render_stats.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
 
 // std
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -20,38 +31,70 @@ namespace vke
     class App
     {
     public:
-        App();
+        explicit App(const VkeBenchConfig &config = VkeBenchConfig{});
         ~App();
 
         App(const App &) = delete;
         App &operator=(const App &) = delete;
         void run();
 
-        ObjectManager objectManager{vkeDevice};
+        ObjectManager objectManager{vkeDevice, geometryArena};
 
     private:
         VkDescriptorSet createDescriptorSet(VkeTexture &texture);
         void loadGameObjects();
         void loadLights();
+        // benchConfig.instances copies of the bundled models on a grid, plus benchConfig.lights point lights
+        void loadStressScene();
+        // adds a finished --bench frame to the report, returns true once the last one was added and the report written
+        bool recordBenchFrame(uint32_t frame, uint64_t frameBeginNs);
+        void writeBenchReport();
         void createDescriptors();
-        void createUBOBuffers();
-        void renderImGuiFrame(VkCommandBuffer commandBuffer, VkeGameObject &sun, glm::vec3 &cameraOffset);
-            VkeWindow vkeWindow { WIDTH,
-                                  HEIGHT,
-                                  "VKEngine v2" };
+        void renderImGuiFrame(VkCommandBuffer commandBuffer, glm::vec3 &sunPosition, glm::vec3 &sunColor, glm::vec3 &cameraOffset, int &shadowFilter, bool &batchStatic, bool &rebatch);
+        // before the window, benchmark runs hide it
+        VkeBenchConfig benchConfig;
+        VkeWindow vkeWindow{WIDTH,
+                            HEIGHT,
+                            "VKEngine v2",
+                            !benchConfig.enabled};
         VkeDevice vkeDevice{vkeWindow};
-        VkeRenderer vkeRenderer{vkeWindow, vkeDevice};
+        // declared before the scene, every model frees its geometry into it
+        VkeGeometryArena geometryArena{vkeDevice};
+        VkeThreadPool threadPool{};
+        // one recording slot per worker plus one for the main thread
+        VkeRenderer vkeRenderer{vkeWindow, vkeDevice, threadPool.getThreadCount() + 1};
 
-        std::unique_ptr<VkeDescriptorPool> globalPool{};
-        VkeGameObject::Map gameObjects;
+        // every long lived descriptor set, a material set holds the most of each type
+        VkeDescriptorAllocator descriptorAllocator{vkeDevice, {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1}, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5}}};
+        // sets only recorded into one frame, reset whenever its frame slot begins again
+        std::array<std::unique_ptr<VkeDescriptorAllocator>, MAX_FRAMES_IN_FLIGHT> transientDescriptors;
+        // ImGui allocates its font set from a plain pool
+        std::unique_ptr<VkeDescriptorPool> uiPool{};
+        VkeScene scene;
+        VkeBvh sceneBvh;
+        VkeStaticChunks staticChunks;
+        VkeStaticBatcher staticBatcher{vkeDevice, geometryArena, vkeRenderer};
 
-        std::vector<std::unique_ptr<VkeBuffer>> uboBuffers;
-        std::vector<std::unique_ptr<VkeBuffer>> shadowUboBuffers;
+        // transient uniform data of every frame in flight, the global and shadow UBOs included
+        VkeFrameRingBuffer frameRing{vkeDevice};
         std::unique_ptr<VkeDescriptorSetLayout> globalSetLayout;
         std::unique_ptr<VkeDescriptorSetLayout> shadowSetLayout;
         std::unique_ptr<VkeDescriptorSetLayout> materialSetLayout;
 
-        std::vector<VkDescriptorSet> globalDescriptorSets;
-        std::vector<VkDescriptorSet> shadowDescriptorSets;
+        // shared by every frame in flight, their UBOs are selected with dynamic offsets
+        VkDescriptorSet globalDescriptorSet = VK_NULL_HANDLE;
+        VkDescriptorSet shadowDescriptorSet = VK_NULL_HANDLE;
+
+        VkeStatsHistory renderStats{};
+        VkeFlightRecorder flightRecorder{};
+
+        VkeBenchReport benchReport{};
+        uint64_t benchGpuFramesRead = 0;
+        // the camera orbits this far around the origin in benchmark runs without a recorded path
+        float sceneRadius = 15.f;
+        // recorded from the UI for --camera-path
+        VkeCameraPath recordedCameraPath{};
+        bool recordingCameraPath = false;
+        float cameraPathTime = 0.f;
     };
 } // namespace vke
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "components.hpp"
+#include "settings.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vke
+{
+    // command line options of the benchmark mode, see VkeBenchConfig::usage()
+    struct VkeBenchConfig
+    {
+        bool enabled = false;
+        uint32_t frames = BENCH_DEFAULT_FRAMES;
+        uint32_t warmupFrames = BENCH_WARMUP_FRAMES;
+        // 0 loads the regular scene instead of the stress scene
+        uint32_t instances = 0;
+        uint32_t lights = 0;
+        // empty plays back the default orbit around the scene
+        std::string cameraPath;
+        std::string output = "bench_results.json";
+
+        // throws std::invalid_argument on unknown or malformed options
+        static VkeBenchConfig parse(int argc, char **argv);
+        static const char *usage();
+    };
+
+    // Camera keys interpolated linearly in time, clamped to the first and last key. Saved as text, one
+    // "time tx ty tz rx ry rz" key per line, so recorded paths can be checked in next to the baselines.
+    class VkeCameraPath
+    {
+    public:
+        struct Key
+        {
+            float time;
+            glm::vec3 translation;
+            glm::vec3 rotation;
+        };
+
+        // a full circle around center, looking at it, in duration seconds
+        static VkeCameraPath orbit(glm::vec3 center, float radius, float height, float duration);
+
+        // throws std::runtime_error when the file can't be read or holds no keys
+        void load(const std::string &path);
+        bool save(const std::string &path) const;
+
+        // keys must be added in time order
+        void addKey(const Key &key) { keys.push_back(key); }
+        void clear() { keys.clear(); }
+        bool empty() const { return keys.empty(); }
+        float getDuration() const { return keys.empty() ? 0.f : keys.back().time; }
+
+        void sample(float time, TransformComponent &transform) const;
+
+    private:
+        std::vector<Key> keys;
+    };
+
+    // Collects a benchmark run and writes it as JSON, with percentiles of the CPU and GPU frame times
+    class VkeBenchReport
+    {
+    public:
+        void addCpuFrame(double milliseconds) { cpuFrameTimes.push_back(milliseconds); }
+        void addGpuFrame(double milliseconds) { gpuFrameTimes.push_back(milliseconds); }
+        void addLoadTime(const std::string &stage, double milliseconds) { loadTimes.emplace_back(stage, milliseconds); }
+        void addInfo(const std::string &key, const std::string &value) { info.emplace_back(key, value); }
+        void addCount(const std::string &key, uint64_t value) { counts.emplace_back(key, value); }
+        void addMemory(const std::string &key, uint64_t bytes) { memory.emplace_back(key, bytes); }
+
+        // returns false if the file can't be written
+        bool write(const std::string &path) const;
+
+        // peak resident set size of the process in bytes, 0 where it can't be queried
+        static uint64_t getPeakResidentBytes();
+
+    private:
+        std::vector<double> cpuFrameTimes;
+        std::vector<double> gpuFrameTimes;
+        std::vector<std::pair<std::string, double>> loadTimes;
+        std::vector<std::pair<std::string, std::string>> info;
+        std::vector<std::pair<std::string, uint64_t>> counts;
+        std::vector<std::pair<std::string, uint64_t>> memory;
+    };
+} // namespace vke
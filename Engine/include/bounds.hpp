@@ -0,0 +1,117 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANT
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <limits>
+
+namespace vke
+{
+    // Axis aligned box, default constructed empty so growing it by anything yields that thing
+    struct VkeAabb
+    {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{-std::numeric_limits<float>::max()};
+
+        bool isEmpty() const { return min.x > max.x; }
+        glm::vec3 center() const { return (min + max) * 0.5f; }
+        glm::vec3 extent() const { return max - min; }
+
+        void grow(const glm::vec3 &point)
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+        void grow(const VkeAabb &other)
+        {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+        float surfaceArea() const
+        {
+            if (isEmpty())
+            {
+                return 0.f;
+            }
+            glm::vec3 e = extent();
+            return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+        bool overlapsSphere(const glm::vec3 &sphereCenter, float radius) const
+        {
+            glm::vec3 closest = glm::clamp(sphereCenter, min, max);
+            glm::vec3 offset = sphereCenter - closest;
+            return glm::dot(offset, offset) <= radius * radius;
+        }
+
+        // bounds of this box after transform, tight for the box itself (Arvo)
+        VkeAabb transformed(const glm::mat4 &transform) const
+        {
+            glm::vec3 halfExtent = extent() * 0.5f;
+            glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center(), 1.f));
+            glm::vec3 newHalfExtent =
+                glm::abs(glm::vec3(transform[0])) * halfExtent.x +
+                glm::abs(glm::vec3(transform[1])) * halfExtent.y +
+                glm::abs(glm::vec3(transform[2])) * halfExtent.z;
+            return VkeAabb{newCenter - newHalfExtent, newCenter + newHalfExtent};
+        }
+    };
+
+    // Six inward facing planes (xyz normal, w distance) of a view projection volume
+    struct VkeFrustum
+    {
+        enum Containment
+        {
+            OUTSIDE,
+            INTERSECTING,
+            INSIDE
+        };
+
+        glm::vec4 planes[6];
+
+        // clip space depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE), so the near plane is the z row alone
+        static VkeFrustum fromViewProjection(const glm::mat4 &viewProjection)
+        {
+            glm::vec4 rows[4];
+            for (int i = 0; i < 4; i++)
+            {
+                rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+            }
+            VkeFrustum frustum{};
+            frustum.planes[0] = rows[3] + rows[0];
+            frustum.planes[1] = rows[3] - rows[0];
+            frustum.planes[2] = rows[3] + rows[1];
+            frustum.planes[3] = rows[3] - rows[1];
+            frustum.planes[4] = rows[2];
+            frustum.planes[5] = rows[3] - rows[2];
+            for (auto &plane : frustum.planes)
+            {
+                plane /= glm::length(glm::vec3(plane));
+            }
+            return frustum;
+        }
+
+        Containment classify(const VkeAabb &box) const
+        {
+            Containment result = INSIDE;
+            for (const auto &plane : planes)
+            {
+                glm::vec3 normal{plane};
+                // corner furthest along the normal, and the one furthest against it
+                glm::vec3 positive = glm::mix(box.min, box.max, glm::step(glm::vec3(0.f), normal));
+                glm::vec3 negative = glm::mix(box.max, box.min, glm::step(glm::vec3(0.f), normal));
+                if (glm::dot(normal, positive) + plane.w < 0.f)
+                {
+                    return OUTSIDE;
+                }
+                if (glm::dot(normal, negative) + plane.w < 0.f)
+                {
+                    result = INTERSECTING;
+                }
+            }
+            return result;
+        }
+    };
+} // namespace vke
@@ -16,7 +16,8 @@ namespace vke
             uint32_t instanceCount,
             VkBufferUsageFlags usageFlags,
             VkMemoryPropertyFlags memoryPropertyFlags,
-            VkDeviceSize minOffsetAlignment = 1);
+            VkDeviceSize minOffsetAlignment = 1,
+            bool concurrent = false);
         ~VkeBuffer();
 
         VkeBuffer(const VkeBuffer &) = delete;
@@ -44,6 +45,8 @@ namespace vke
         VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
         VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
         VkDeviceSize getBufferSize() const { return bufferSize; }
+        // shared by every queue family in use, see VkeDevice::createBuffer
+        bool isConcurrent() const { return concurrent; }
 
     private:
         static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
@@ -59,6 +62,7 @@ namespace vke
         VkDeviceSize alignmentSize;
         VkBufferUsageFlags usageFlags;
         VkMemoryPropertyFlags memoryPropertyFlags;
+        bool concurrent;
     };
 
 } // namespace vke
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "scene.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vke
+{
+    struct VkeRay
+    {
+        glm::vec3 origin{};
+        glm::vec3 direction{0.f, 0.f, 1.f};
+        float maxDistance = std::numeric_limits<float>::max();
+    };
+    struct VkeRayHit
+    {
+        // VkeBvh::NO_HIT when the ray missed every item
+        uint32_t item;
+        // along the ray direction, in units of its length
+        float distance;
+    };
+
+    // Bounding volume hierarchy over item boxes, built with binned SAH and kept up to date by refitting.
+    // Refitting only grows or shrinks node boxes, so once movement has made the tree too loose compared
+    // to a fresh build it is rebuilt from scratch.
+    // update() keeps it in sync with the world space bounds of a scene's renderables, an item is then
+    // the renderable's dense index and stays valid until renderables or transforms are added or removed.
+    class VkeBvh
+    {
+    public:
+        static constexpr uint32_t NO_HIT = std::numeric_limits<uint32_t>::max();
+        // frustums per queryFrustums() call, one bit each in the traversal masks
+        static constexpr uint32_t MAX_BATCHED_FRUSTUMS = 32;
+
+        // Call once per frame after updateMatrices(). Rebuilds on layout changes and refits the
+        // renderables whose transform was recomputed otherwise.
+        void update(const VkeScene &scene);
+
+        // build over arbitrary boxes, item i is itemBounds[i]
+        void build(std::vector<VkeAabb> itemBounds);
+        // moves one item, refit() has to follow before the next query
+        void setItemBounds(uint32_t item, const VkeAabb &bounds);
+        // Recomputes the boxes of the nodes above items moved since the last refit, rebuilds instead
+        // when the tree got too loose. Returns true when it rebuilt.
+        bool refit();
+
+        // Appends to results[f] every item whose box is not outside frustums[f]. All frustums share
+        // one traversal, a subtree fully inside a frustum is accepted without testing its items.
+        void queryFrustums(const VkeFrustum *frustums, uint32_t frustumCount, std::vector<uint32_t> *results) const;
+        void queryFrustum(const VkeFrustum &frustum, std::vector<uint32_t> &results) const { queryFrustums(&frustum, 1, &results); }
+        // appends every item whose box overlaps the sphere
+        void querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &results) const;
+        // nearest item box hit per ray, rays are traced in SIMD packets that share one traversal
+        void raycast(const VkeRay *rays, uint32_t rayCount, VkeRayHit *hits) const;
+        VkeRayHit raycast(const VkeRay &ray) const;
+
+        uint32_t getItemCount() const { return static_cast<uint32_t>(itemBounds.size()); }
+        uint32_t getNodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+        // Sum of internal node surface areas over the root's, the expected number of node visits of
+        // a random ray (SAH). Compared against its value at build time to decide on rebuilds.
+        float getCost() const;
+        const VkeAabb &getBounds() const { return nodes.empty() ? emptyBounds : nodes[0].bounds; }
+
+    private:
+        // Children of an internal node are adjacent, the left one at firstIndex and holding the items
+        // with the lower centroids along splitAxis. A leaf (count > 0) holds items
+        // itemOrder[firstIndex, firstIndex + count).
+        struct Node
+        {
+            VkeAabb bounds;
+            uint32_t firstIndex = 0;
+            uint32_t count = 0;
+            uint32_t splitAxis = 0;
+            bool isLeaf() const { return count > 0; }
+        };
+
+        // splits nodeIndex if that lowers the SAH cost, returns false when it stays a leaf
+        bool subdivide(uint32_t nodeIndex, const std::vector<glm::vec3> &centroids);
+        void refitNode(uint32_t nodeIndex);
+        void refitAll();
+        void syncItemBounds(const VkeScene &scene, uint32_t item, uint32_t transformIndex);
+        template <typename Lanes>
+        void raycastPacket(const VkeRay *rays, VkeRayHit *hits) const;
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> itemOrder;
+        std::vector<uint32_t> leafOfItem;
+        std::vector<VkeAabb> itemBounds;
+
+        // items moved since the last refit
+        std::vector<uint32_t> movedItems;
+        std::vector<uint8_t> itemMoved;
+        // scratch for refit
+        std::vector<uint32_t> refitNodes;
+        std::vector<uint8_t> nodeQueued;
+
+        float internalAreaSum = 0.f;
+        float builtCost = 0.f;
+
+        // what update() last synced against
+        uint64_t renderableLayout = ~0ull;
+        uint64_t transformLayout = ~0ull;
+        uint64_t transformUpdates = 0;
+        std::vector<uint32_t> itemOfTransform;
+
+        static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+        static const VkeAabb emptyBounds;
+    };
+} // namespace vke
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "model.hpp"
+#include "texture.hpp"
+#include "descriptors.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vulkan/vulkan.h>
+// std
+#include <memory>
+
+namespace vke
+{
+    struct VkeMaterialFlags
+    {
+        bool hasAlbedo = false;
+        bool hasNormal = false;
+        bool hasRoughness = false;
+        bool hasMetallic = false;
+        bool hasAO = false;
+    };
+    struct VkeMaterial
+    {
+        std::shared_ptr<VkeTexture> albedo;
+        std::shared_ptr<VkeTexture> normal;
+        std::shared_ptr<VkeTexture> roughness;
+        std::shared_ptr<VkeTexture> metallic;
+        std::shared_ptr<VkeTexture> ao;
+        VkeMaterialFlags flags;
+    };
+
+    struct TransformComponent
+    {
+        glm::vec3 translation{};
+        glm::vec3 scale{1.f, 1.f, 1.f};
+        glm::vec3 rotation{};
+
+        glm::mat4 mat4() const;
+        glm::mat3 normalMatrix() const;
+    };
+
+    struct PointLightComponent
+    {
+        glm::vec3 color{1.f};
+        float lightIntensity{1.f};
+        float radius{0.1f};
+    };
+} // namespace vke
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "device.hpp"
+#include "settings.hpp"
 
 // std
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -40,10 +43,21 @@ namespace vke
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
 
+        // bytes between two descriptor infos in the data of an update template
+        static constexpr size_t DESCRIPTOR_INFO_STRIDE =
+            sizeof(VkDescriptorImageInfo) > sizeof(VkDescriptorBufferInfo) ? sizeof(VkDescriptorImageInfo) : sizeof(VkDescriptorBufferInfo);
+
+        // Template updating one descriptor of every binding in bindingMask, from infos packed in binding
+        // order DESCRIPTOR_INFO_STRIDE bytes apart. Created on first use, needs the device to support
+        // VK_KHR_descriptor_update_template.
+        VkDescriptorUpdateTemplateKHR getUpdateTemplate(uint64_t bindingMask);
+
     private:
         VkeDevice &vkeDevice;
         VkDescriptorSetLayout descriptorSetLayout;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+        std::mutex updateTemplateMutex;
+        std::unordered_map<uint64_t, VkDescriptorUpdateTemplateKHR> updateTemplates;
 
         friend class VkeDescriptorWriter;
     };
@@ -78,6 +92,7 @@ namespace vke
         VkeDescriptorPool(const VkeDescriptorPool &) = delete;
         VkeDescriptorPool &operator=(const VkeDescriptorPool &) = delete;
 
+        // returns false once the pool is full, VkeDescriptorAllocator chains pools instead
         bool allocateDescriptor(
             const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet &descriptor) const;
 
@@ -92,10 +107,51 @@ namespace vke
         friend class VkeDescriptorWriter;
     };
 
+    // Allocates descriptor sets from a chain of pools, adding a pool twice as large as the last one
+    // whenever the current ones are full, so allocating never fails for want of pool space. reset()
+    // returns every set at once and keeps the pools, which is how the per frame transient allocators
+    // are recycled once their frame finished on the GPU. Not thread safe.
+    class VkeDescriptorAllocator
+    {
+    public:
+        // poolSizes are descriptors per set, every pool holds them times its set count
+        VkeDescriptorAllocator(
+            VkeDevice &vkeDevice,
+            std::vector<VkDescriptorPoolSize> poolSizes,
+            uint32_t initialSets = DESCRIPTOR_POOL_INITIAL_SETS,
+            VkDescriptorPoolCreateFlags poolFlags = 0);
+        VkeDescriptorAllocator(const VkeDescriptorAllocator &) = delete;
+        VkeDescriptorAllocator &operator=(const VkeDescriptorAllocator &) = delete;
+
+        // throws std::runtime_error only when even a new, empty pool can't hold the set
+        VkDescriptorSet allocate(VkDescriptorSetLayout descriptorSetLayout);
+        // every set allocated so far becomes invalid
+        void reset();
+
+        size_t getPoolCount() const { return pools.size(); }
+        uint32_t getAllocatedSets() const { return allocatedSets; }
+
+    private:
+        VkeDescriptorPool &addPool();
+
+        VkeDevice &vkeDevice;
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        VkDescriptorPoolCreateFlags poolFlags;
+        uint32_t nextPoolSets;
+        std::vector<std::unique_ptr<VkeDescriptorPool>> pools;
+        // the pools before it are full
+        size_t currentPool = 0;
+        uint32_t allocatedSets = 0;
+    };
+
+    // Collects writes of single descriptors and applies them with one update template call when the
+    // device supports them, vkUpdateDescriptorSets otherwise. The infos must outlive build or overwrite.
     class VkeDescriptorWriter
     {
     public:
         VkeDescriptorWriter(VkeDescriptorSetLayout &setLayout, VkeDescriptorPool &pool);
+        // build() never fails with an allocator
+        VkeDescriptorWriter(VkeDescriptorSetLayout &setLayout, VkeDescriptorAllocator &allocator);
 
         VkeDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
         VkeDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
@@ -105,7 +161,8 @@ namespace vke
 
     private:
         VkeDescriptorSetLayout &setLayout;
-        VkeDescriptorPool &pool;
+        VkeDescriptorPool *pool = nullptr;
+        VkeDescriptorAllocator *allocator = nullptr;
         std::vector<VkWriteDescriptorSet> writes;
     };
 
@@ -4,11 +4,14 @@
 
 // std lib headers
 #include <vulkan/vulkan_beta.h>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace vke
 {
+  class VkeTimeline;
+  class VkeUploadQueue;
 
   struct SwapChainSupportDetails
   {
@@ -21,6 +24,10 @@ namespace vke
   {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    // a transfer only family when the device has one, the graphics family otherwise
+    uint32_t transferFamily;
+    // a compute family without graphics when async compute is used, the graphics family otherwise
+    uint32_t computeFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
@@ -50,24 +57,40 @@ namespace vke
     VkSurfaceKHR surface() { return surface_; }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
+    // the graphics queue when there is no dedicated transfer family
+    VkQueue transferQueue() { return transferQueue_; }
+    VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+    bool hasDedicatedTransferQueue() const { return dedicatedTransfer; }
+    // the graphics queue and command pool without an async compute queue
+    VkQueue computeQueue() { return computeQueue_; }
+    VkCommandPool getComputeCommandPool() { return asyncCompute ? computeCommandPool : commandPool; }
+    // a compute family without graphics runs next to the graphics queue
+    bool hasAsyncComputeQueue() const { return asyncCompute; }
+    // signaled by every submission to the graphics queue, in submission order
+    VkeTimeline &getGraphicsTimeline() { return *graphicsTimeline; }
+    // streaming uploads, see VkeUploadQueue
+    VkeUploadQueue &getUploadQueue() { return *uploadQueue; }
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-    QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+    // the families the device was created with
+    QueueFamilyIndices findPhysicalQueueFamilies() { return queueFamilyIndices; }
     VkInstance getInstance() { return instance; }
     VkFormat findSupportedFormat(
         const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-    // Buffer Helper Functions
+    // Buffer Helper Functions, the copies wait for their own submission to finish. Concurrent buffers
+    // are shared by every queue family in use, so other queues access them without ownership transfers.
     void createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory);
+        VkDeviceMemory &bufferMemory,
+        bool concurrent = false);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
     void copyBufferToImage(
         VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -78,6 +101,19 @@ namespace vke
         VkDeviceMemory &imageMemory);
 
     VkPhysicalDeviceProperties properties;
+    // optional features are enabled whenever the device supports them
+    const VkPhysicalDeviceFeatures &getEnabledFeatures() const { return enabledFeatures; }
+    // optional extensions are enabled whenever the device supports them too
+    bool isExtensionEnabled(const char *extension) const;
+
+    // VK_KHR_descriptor_update_template entry points, null when the extension isn't enabled
+    PFN_vkCreateDescriptorUpdateTemplateKHR createDescriptorUpdateTemplate = nullptr;
+    PFN_vkDestroyDescriptorUpdateTemplateKHR destroyDescriptorUpdateTemplate = nullptr;
+    PFN_vkUpdateDescriptorSetWithTemplateKHR updateDescriptorSetWithTemplate = nullptr;
+
+    // VK_KHR_timeline_semaphore entry points, see VkeTimeline
+    PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
 
   private:
     void createInstance();
@@ -89,6 +125,7 @@ namespace vke
 
     // helper functions
     bool isDeviceSuitable(VkPhysicalDevice device);
+    bool supportsTimelineSemaphores(VkPhysicalDevice device);
     std::vector<const char *> getRequiredExtensions();
     bool checkValidationLayerSupport();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
@@ -102,15 +139,29 @@ namespace vke
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkeWindow &window;
     VkCommandPool commandPool;
+    VkCommandPool transferCommandPool;
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
 
     VkDevice device_;
     VkSurfaceKHR surface_;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
+    VkQueue transferQueue_;
+    VkQueue computeQueue_;
+    bool dedicatedTransfer = false;
+    bool asyncCompute = false;
+    std::unique_ptr<VkeTimeline> graphicsTimeline;
+    QueueFamilyIndices queueFamilyIndices{};
+    // the families concurrent buffers are shared between
+    std::vector<uint32_t> sharedQueueFamilies;
+    std::unique_ptr<VkeUploadQueue> uploadQueue;
+    VkPhysicalDeviceFeatures enabledFeatures{};
+    std::vector<const char *> enabledExtensions;
 
     const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, // frame, upload and compute synchronization
 #ifdef __APPLE__
         VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME,
 #endif
@@ -119,6 +170,9 @@ namespace vke
         // VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
         // VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME
     };
+    const std::vector<const char *> optionalDeviceExtensions = {
+        VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME, // one call per descriptor set update
+    };
   };
 
 } // namespace vke
\ No newline at end of file
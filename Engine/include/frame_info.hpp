@@ -1,8 +1,13 @@
 #pragma once
 
 #include "camera.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
+#include "descriptors.hpp"
+#include "frame_ring_buffer.hpp"
 #include "light_object.hpp"
+#include "renderer.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
 
 // libs
 #include <vulkan/vulkan.h>
@@ -36,6 +41,8 @@ namespace vke
         PointLight pointLights[MAX_LIGHTS];
         alignas(16) DirectionalLight dirLight;
         int numLights;
+        int shadowFilter{0};          // ShadowFilterMode
+        glm::vec2 evsmExponents{5.f}; // positive / negative warp exponents
     };
     struct FrameInfo
     {
@@ -44,10 +51,24 @@ namespace vke
         float currentTimeInSeconds;
         VkCommandBuffer commandBuffer;
         VkeCamera &camera;
+        // bound with globalUboOffset and shadowUboOffset as their dynamic offsets
         VkDescriptorSet globalDescriptorSet;
         VkDescriptorSet shadowDescriptorSet;
-        VkeGameObject::Map &gameObjects;
+        VkeScene &scene;
+        VkeRenderer &renderer;
+        VkeThreadPool &threadPool;
+        VkeFrameRingBuffer &frameRing;
+        // sets allocated from it are only valid for this frame
+        VkeDescriptorAllocator &transientDescriptors;
+        uint32_t globalUboOffset = 0;
+        uint32_t shadowUboOffset = 0;
     };
+
+    // pixel size of one unit at distance one in the main view, what LOD errors are projected with
+    inline float getLodPixelScale(const FrameInfo &frameInfo)
+    {
+        return frameInfo.camera.getProjection()[1][1] * 0.5f * static_cast<float>(frameInfo.renderer.getSwapChainExtent().height);
+    }
    
 
 } // namespace vke
\ No newline at end of file
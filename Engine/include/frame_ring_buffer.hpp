@@ -0,0 +1,67 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "settings.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace vke
+{
+    // One persistently mapped, host coherent buffer with a region of FRAME_RING_CAPACITY bytes per frame
+    // in flight. A frame's transient uniform and storage data is sub-allocated linearly from its region
+    // and bound through VK_DESCRIPTOR_TYPE_*_DYNAMIC descriptors at the returned offsets, so nothing is
+    // mapped or flushed per buffer. Allocation is thread safe, recording workers may allocate too.
+    class VkeFrameRingBuffer
+    {
+    public:
+        struct Allocation
+        {
+            void *data = nullptr;
+            // from the start of the buffer, the dynamic offset to bind the data with
+            uint32_t offset = 0;
+        };
+
+        VkeFrameRingBuffer(VkeDevice &device, VkDeviceSize capacity = FRAME_RING_CAPACITY);
+
+        VkeFrameRingBuffer(const VkeFrameRingBuffer &) = delete;
+        VkeFrameRingBuffer &operator=(const VkeFrameRingBuffer &) = delete;
+
+        // Starts frameIndex's region over. Call once the slot's last frame finished, before any allocation
+        // of the frame. Allocations then happen in the same order every frame, so their offsets repeat.
+        void beginFrame(int frameIndex);
+
+        // size bytes aligned for uniform and storage dynamic offsets, throws when the frame's region is full
+        Allocation allocate(VkDeviceSize size);
+        // copies value into a new allocation and returns its dynamic offset
+        template <typename T>
+        uint32_t push(const T &value)
+        {
+            Allocation allocation = allocate(sizeof(T));
+            std::memcpy(allocation.data, &value, sizeof(T));
+            return allocation.offset;
+        }
+
+        // descriptor of range bytes at offset 0, the dynamic offset selects the allocation
+        VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const { return {buffer->getBuffer(), 0, range}; }
+        VkBuffer getBuffer() const { return buffer->getBuffer(); }
+        VkDeviceSize getAlignment() const { return alignment; }
+        VkDeviceSize getFrameCapacity() const { return frameCapacity; }
+        // bytes allocated by the current frame, padding included
+        VkDeviceSize getUsedBytes() const { return head.load(std::memory_order_relaxed); }
+
+    private:
+        VkDeviceSize alignment;
+        VkDeviceSize frameCapacity;
+        std::unique_ptr<VkeBuffer> buffer;
+        char *mapped = nullptr;
+        VkDeviceSize frameBegin = 0;
+        std::atomic<VkDeviceSize> head{0};
+    };
+} // namespace vke
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "settings.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+
+namespace vke
+{
+    // elements [first, first + count) of one of the arena's buffers
+    struct VkeGeometryRange
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    // First fit allocator of element ranges, freed ranges merge with the free ranges next to them
+    class VkeRangeAllocator
+    {
+    public:
+        static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+        VkeRangeAllocator(uint32_t capacity);
+
+        // first element of count free elements, NONE when no free range is large enough
+        uint32_t allocate(uint32_t count);
+        void free(uint32_t first, uint32_t count);
+
+        uint32_t getFreeCount() const { return freeCount; }
+
+    private:
+        // first element -> element count of every free range, never two adjacent ones
+        std::map<uint32_t, uint32_t> freeRanges;
+        uint32_t freeCount;
+    };
+
+    // One device local vertex buffer and one index buffer per index width that the geometry of every
+    // model is sub-allocated from. Models only differ in firstIndex and vertexOffset, so consecutive
+    // draws of different models keep the buffers bound. A model's position stream lives at the same
+    // range of the position buffer as its vertices. When full, another arena is chained behind it, at
+    // least as large as the geometry that didn't fit.
+    class VkeGeometryArena
+    {
+    public:
+        VkeGeometryArena(VkeDevice &device, uint32_t vertexCapacity = GEOMETRY_VERTEX_CAPACITY, uint32_t indexCapacity = GEOMETRY_INDEX_CAPACITY);
+        ~VkeGeometryArena();
+
+        VkeGeometryArena(const VkeGeometryArena &) = delete;
+        VkeGeometryArena &operator=(const VkeGeometryArena &) = delete;
+
+        // Reserves the vertices and indices of one model in the first arena of the chain with room for
+        // both, chaining a new one when none has, and returns that arena. The ranges are written and
+        // freed through it.
+        VkeGeometryArena &allocate(uint32_t vertexCount, VkIndexType indexType, uint32_t indexCount, VkeGeometryRange &vertexRange, VkeGeometryRange &indexRange);
+        // Copies range.count VkeModel::PackedVertex, and as many VkeModel::PositionVertex when
+        // hasPositionStream(), into an allocated range.
+        void writeVertices(const VkeGeometryRange &range, const void *vertices, const void *positions);
+        // copies range.count 16 or 32 bit indices into an allocated range
+        void writeIndices(VkIndexType indexType, const VkeGeometryRange &range, const void *indices);
+        // Ranges are reused by the next allocation, only free them once no frame in flight draws from them
+        void freeVertices(const VkeGeometryRange &range);
+        void freeIndices(VkIndexType indexType, const VkeGeometryRange &range);
+
+        // binds the vertex buffers, and the index buffer of indexType unless it is VK_INDEX_TYPE_MAX_ENUM
+        void bind(VkCommandBuffer commandBuffer, VkIndexType indexType);
+        // same as bind() with the position stream, only valid when hasPositionStream()
+        void bindPositions(VkCommandBuffer commandBuffer, VkIndexType indexType);
+        void bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+        bool hasPositionStream() const { return positionBuffer != nullptr; }
+        // the 32 bit one can also be bound as a storage buffer
+        VkeBuffer *getIndexBuffer(VkIndexType indexType) const { return indexBuffers[indexSlot(indexType)].get(); }
+        // of this arena and the ones chained behind it
+        uint64_t getUsedVertexCount() const;
+        uint64_t getUsedIndexCount(VkIndexType indexType) const;
+
+    private:
+        static uint32_t indexSlot(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1; }
+        // queues a copy of size bytes into buffer at offset, visible to frames submitted after the next flush
+        void upload(VkeBuffer &buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+
+        VkeDevice &vkeDevice;
+        uint32_t vertexCapacity;
+        uint32_t indexCapacity;
+        // the next arena of the chain, created once this one ran out of space
+        std::unique_ptr<VkeGeometryArena> next;
+
+        std::unique_ptr<VkeBuffer> vertexBuffer;
+        std::unique_ptr<VkeBuffer> positionBuffer;
+#if !VERTEX_FORMAT_COLOR
+        // a single white color read by every vertex through a zero stride binding
+        std::unique_ptr<VkeBuffer> defaultColorBuffer;
+#endif
+        VkeRangeAllocator vertexAllocator;
+
+        // 16 bit, then 32 bit
+        std::array<std::unique_ptr<VkeBuffer>, 2> indexBuffers;
+        std::array<VkeRangeAllocator, 2> indexAllocators;
+    };
+} // namespace vke
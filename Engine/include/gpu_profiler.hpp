@@ -0,0 +1,104 @@
+#pragma once
+
+#include "device.hpp"
+#include "settings.hpp"
+
+#include <vulkan/vulkan.h>
+// std
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace vke
+{
+    // GPU time of named scopes, plus vertex, fragment and clipping counts for scopes that ask for them.
+    // Every frame in flight has its own query pools, which are read back when the frame index comes
+    // around again after its last submission was waited for, so results are MAX_FRAMES_IN_FLIGHT frames old and
+    // reading them never stalls. Scopes are recorded from the main thread only.
+    class VkeGpuProfiler
+    {
+    public:
+        static constexpr uint32_t NO_SCOPE = std::numeric_limits<uint32_t>::max();
+
+        struct ScopeResult
+        {
+            std::string name;
+            // scopes opened inside another scope are one deeper
+            uint32_t depth = 0;
+            double milliseconds = 0.0;
+            bool hasStatistics = false;
+            uint64_t vertexInvocations = 0;
+            uint64_t clippingPrimitives = 0;
+            uint64_t fragmentInvocations = 0;
+        };
+
+        VkeGpuProfiler(VkeDevice &device);
+        ~VkeGpuProfiler();
+
+        VkeGpuProfiler(const VkeGpuProfiler &) = delete;
+        VkeGpuProfiler &operator=(const VkeGpuProfiler &) = delete;
+
+        // Collects frameIndex's previous results and resets its queries. Call once the slot's last frame
+        // finished, with commandBuffer begun and outside any render pass.
+        void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+        // name must stay valid until the frame is read back, a string literal. Returns NO_SCOPE when
+        // timestamps are unsupported or the frame ran out of scopes. Statistics are only gathered for
+        // scopes begun in the primary command buffer outside a render pass, and never for two scopes at
+        // once. Secondary command buffers executed inside such a scope must be begun with
+        // getInheritedPipelineStatistics(), so passes made of secondaries only gather them when
+        // canInheritStatistics().
+        uint32_t beginScope(VkCommandBuffer commandBuffer, const char *name, bool pipelineStatistics = false);
+        void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+        // the latest frame read back, in the order its scopes were begun
+        const std::vector<ScopeResult> &getResults() const { return results; }
+        // from the first scope's begin to the last scope's end of the latest frame read back
+        double getFrameMilliseconds() const { return frameMilliseconds; }
+        // frames read back so far, tells whether the results changed
+        uint64_t getCollectedFrameCount() const { return collectedFrames; }
+        bool isSupported() const { return timestampPool[0] != VK_NULL_HANDLE; }
+        // without the inheritedQueries feature no query may be active while secondaries run
+        bool canInheritStatistics() const { return statisticFlags != 0 && vkeDevice.getEnabledFeatures().inheritedQueries; }
+        VkQueryPipelineStatisticFlags getInheritedPipelineStatistics() const { return canInheritStatistics() ? statisticFlags : 0; }
+
+        // appends every frame read back from now on to a CSV file, returns false if it can't be opened
+        bool startCsvCapture(const std::string &path);
+        void stopCsvCapture();
+        bool isCapturingCsv() const { return csvFile.is_open(); }
+
+    private:
+        struct Scope
+        {
+            const char *name;
+            uint32_t depth;
+            uint32_t statisticsQuery;
+        };
+
+        void collect(int frameIndex);
+
+        VkeDevice &vkeDevice;
+        std::array<VkQueryPool, MAX_FRAMES_IN_FLIGHT> timestampPool{};
+        std::array<VkQueryPool, MAX_FRAMES_IN_FLIGHT> statisticsPool{};
+        VkQueryPipelineStatisticFlags statisticFlags = 0;
+        double timestampPeriod = 1.0;
+        uint64_t timestampMask = 0;
+
+        // scopes recorded into each frame in flight, and which statistics query is open in the current one
+        std::array<std::vector<Scope>, MAX_FRAMES_IN_FLIGHT> frameScopes;
+        std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> statisticsQueryCounts{};
+        int currentFrame = 0;
+        uint32_t openDepth = 0;
+        bool statisticsOpen = false;
+
+        std::vector<ScopeResult> results;
+        double frameMilliseconds = 0.0;
+        std::vector<uint64_t> timestampScratch;
+        std::vector<uint64_t> statisticsScratch;
+        uint64_t collectedFrames = 0;
+        std::ofstream csvFile;
+    };
+} // namespace vke
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "game_object.hpp"
+#include "components.hpp"
 #include "window.hpp"
 
 namespace vke
@@ -24,7 +24,7 @@ namespace vke
         };
 
         // depends on the GLFW...
-        void moveInPlainXZ(GLFWwindow *window, float dt, VkeGameObject &gameObject);
+        void moveInPlainXZ(GLFWwindow *window, float dt, TransformComponent &transform);
         void updateShortcuts(GLFWwindow *window);
         KeyMappings keys{};
         float moveSpeed{3.f};
@@ -3,7 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include "game_object.hpp"
+#include "components.hpp"
 
 #include <vulkan/vulkan.h>
 
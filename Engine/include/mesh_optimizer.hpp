@@ -0,0 +1,28 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vke
+{
+    // Reorders the triangles of an index list in place for the post transform vertex cache, with Tom
+    // Forsyth's linear speed vertex cache optimisation.
+    void optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+    // Reorders cache optimized triangles to reduce overdraw while keeping most of the cache locality.
+    // The list is cut into clusters where the cache order jumps to unconnected geometry, and clusters
+    // facing away from the mesh center are drawn first, since they are the likeliest to occlude the rest.
+    void optimizeOverdraw(uint32_t *indices, size_t indexCount, const std::vector<glm::vec3> &positions);
+
+    // Vertex renumbering into first use order of the index list, so vertex fetch walks memory forward.
+    // Returns the new index of every old vertex, unreferenced vertices are moved to the end.
+    std::vector<uint32_t> optimizeVertexFetchRemap(const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+    // Average cache misses per triangle of a VERTEX_CACHE_SIZE entry FIFO cache, between 0.5 and 3
+    float computeAcmr(const uint32_t *indices, size_t indexCount, size_t vertexCount);
+} // namespace vke
@@ -0,0 +1,24 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vke
+{
+    // Quadric error edge collapse over an indexed triangle list. Vertices are only ever merged into
+    // one of their neighbours, never moved or created, so the result indexes the same vertex buffer.
+    // Vertices on an open border, which includes uv and normal seams since their copies do not share
+    // edges, are kept in place so the outline and seams do not tear.
+    // Stops at targetIndexCount or once the next collapse would exceed maxError. Writes the largest
+    // error introduced, in position units, to resultError when given.
+    std::vector<uint32_t> simplifyMesh(
+        const std::vector<glm::vec3> &positions,
+        const std::vector<uint32_t> &indices,
+        size_t targetIndexCount,
+        float maxError,
+        float *resultError = nullptr);
+} // namespace vke
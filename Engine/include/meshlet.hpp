@@ -0,0 +1,34 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vke
+{
+    // A small cluster of triangles with the bounds the cull pass tests it by. Laid out to match the
+    // std430 Meshlet struct in meshlet_cull.comp.
+    struct VkeMeshlet
+    {
+        // object space center in xyz, radius in w
+        glm::vec4 boundingSphere{0.f};
+        // Average facing in xyz, and in w the sine of the cone half angle. The whole cluster faces away
+        // from a viewer for which dot(normalize(coneApex - viewer), axis) >= w. A w above one never culls.
+        glm::vec4 cone{0.f, 0.f, 0.f, 2.f};
+        glm::vec4 coneApex{0.f};
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        uint32_t padding[2]{};
+    };
+
+    // Greedily grows meshlets of at most MESHLET_MAX_VERTICES unique vertices and MESHLET_MAX_TRIANGLES
+    // triangles over shared vertices, and returns the triangle list reordered so every meshlet is a
+    // contiguous range of it. Meshlet firstIndex is relative to the start of indices.
+    std::vector<uint32_t> buildMeshlets(
+        const std::vector<glm::vec3> &positions,
+        const std::vector<uint32_t> &indices,
+        std::vector<VkeMeshlet> &meshlets);
+} // namespace vke
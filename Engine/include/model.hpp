@@ -1,6 +1,10 @@
 #pragma once
+#include "bounds.hpp"
 #include "buffer.hpp"
 #include "device.hpp"
+#include "geometry_arena.hpp"
+#include "meshlet.hpp"
+#include "settings.hpp"
 
 // libs
 #define GLM_FORCE_RADIANT
@@ -9,6 +13,8 @@
 #include <vulkan/vulkan.h>
 
 // std
+#include <functional>
+#include <string>
 #include <vector>
 #include <memory>
 
@@ -17,6 +23,7 @@ namespace vke
     class VkeModel
     {
     public:
+        // full precision vertex the builder loads and processes
         struct Vertex
         {
             glm::vec3 position{};
@@ -24,43 +31,166 @@ namespace vke
             glm::vec3 normal{};
             glm::vec2 uv{};
 
-            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
             bool operator==(const Vertex &other) const
             {
                 return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
             }
         };
 
+        // Vertex as stored in the vertex buffer, see VERTEX_FORMAT_COMPACT and VERTEX_FORMAT_COLOR.
+        // Positions are in [0, 1] over the model bounds when compact, getPositionDecodeMatrix() maps
+        // them back. Normals are always octahedral encoded and decoded in the vertex shader.
+        struct PackedVertex
+        {
+#if VERTEX_FORMAT_COMPACT
+            uint16_t position[4]; // unorm, w unused
+            int16_t normal[2];    // snorm
+            uint32_t uv;          // two half floats
+#if VERTEX_FORMAT_COLOR
+            uint32_t color; // rgba8 unorm
+#endif
+#else
+            glm::vec3 position;
+            glm::vec2 normal;
+            glm::vec2 uv;
+#if VERTEX_FORMAT_COLOR
+            glm::vec3 color;
+#endif
+#endif
+            static PackedVertex pack(const Vertex &vertex, const VkeAabb &bounds);
+            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        };
+
+        // Position alone, for passes that read nothing else. Stored the same way as in PackedVertex so
+        // getPositionDecodeMatrix() applies to both.
+        struct PositionVertex
+        {
+#if VERTEX_FORMAT_COMPACT
+            uint16_t position[3];
+#else
+            glm::vec3 position;
+#endif
+            static VkFormat getFormat();
+            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        };
+        // Whether models keep a position stream. 3 component 16 bit vertex formats are optional, without
+        // them the compact stream is skipped and position only passes bind the full vertices instead.
+        static bool hasPositionStreams(VkeDevice &device);
+
+        // A level of detail is a range of the model's indices, all levels draw from the same vertices
+        struct Lod
+        {
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            // largest distance, in object space units, the simplified surface strays from the original
+            float error = 0.f;
+        };
+
         struct Builder
         {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            std::vector<Lod> lods{};
+            std::vector<VkeMeshlet> meshlets{};
 
             void loadModels(const std::string &filepath);
+            // Welds vertices within VERTEX_WELD_EPSILON, then orders triangles for the vertex cache and
+            // overdraw and vertices for fetch locality. Call before buildMeshlets and generateLods.
+            void optimize();
+            // splits the full detail level into meshlets, reordering its indices, when it has at least
+            // MESHLET_MIN_TRIANGLES triangles
+            void buildMeshlets();
+            // appends up to MAX_LOD_COUNT - 1 simplified index lists after the full detail one
+            void generateLods();
         };
 
-        VkeModel(VkeDevice &device, const std::string &filepath);
+        // The model's vertices and indices are sub-allocated from geometryArena, or an arena chained
+        // behind it, which must outlive it.
+        VkeModel(VkeDevice &device, VkeGeometryArena &geometryArena, const std::string &filepath);
+        // from already loaded geometry, which goes through the same processing as a loaded file
+        VkeModel(VkeDevice &device, VkeGeometryArena &geometryArena, Builder builder);
+        // Frees the geometry right away, so the last reference to a model frames in flight may still draw
+        // is released through VkeRenderer::deferDestroy().
         ~VkeModel();
 
         VkeModel(const VkeModel &) = delete;
         VkeModel &operator=(const VkeModel &) = delete;
 
+        // Binds the arena's vertex and index buffers. Every model of the arena with the same index type
+        // draws from the same bindings, see getGeometryArena().
         void bind(VkCommandBuffer commandBuffer);
-        void draw(VkCommandBuffer commandBuffer);
+        // binds the position stream and the index buffer, only valid when hasPositionStreams()
+        void bindPositions(VkCommandBuffer commandBuffer);
+        // rebinds only the index buffer, for switching between models with different index types
+        void bindIndices(VkCommandBuffer commandBuffer);
+        void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+
+        uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+        const Lod &getLod(uint32_t lod) const { return lods[lod]; }
+        // Coarsest level whose error stays under maxErrorPixels on screen, for an instance placed by
+        // worldMatrix. pixelScale is the pixel size of one unit at distance one, projection[1][1] * height / 2.
+        uint32_t selectLod(const glm::mat4 &worldMatrix, const glm::vec3 &cameraPosition, float pixelScale, float maxErrorPixels) const;
+        // The same for an orthographic view, where one unit covers pixelsPerUnit pixels at any distance.
+        uint32_t selectLodOrthographic(const glm::mat4 &worldMatrix, float pixelsPerUnit, float maxErrorPixels) const;
+
+        // object space bounds of the vertex positions
+        const VkeAabb &getBounds() const { return bounds; }
+        // Maps stored positions back to object space, fold it into the model matrix the vertex shader
+        // transforms positions with. Identity unless positions are quantized.
+        const glm::mat4 &getPositionDecodeMatrix() const { return positionDecodeMatrix; }
+
+        // Meshlets cover the full detail level only. Their index ranges point straight into the arena's
+        // 32 bit index buffer, which the cull pass binds as a storage buffer to copy the surviving ones out.
+        uint32_t getMeshletCount() const { return meshletCount; }
+        VkeBuffer *getMeshletBuffer() const { return meshletBuffer.get(); }
+        VkeBuffer *getIndexBuffer() const { return geometryArena->getIndexBuffer(indexType); }
+        // 16 bit when every vertex can be addressed with it, unless the cull pass has to read the indices
+        VkIndexType getIndexType() const { return indexType; }
+        // added to every index the model draws with, the start of its vertices in the arena
+        int32_t getVertexOffset() const { return static_cast<int32_t>(vertexRange.first); }
+        // the arena of the chain holding the model's geometry
+        VkeGeometryArena &getGeometryArena() const { return *geometryArena; }
+        // The file the model was loaded from, empty when it was built from geometry. No CPU copy of the
+        // geometry is kept, whoever needs it again loads it from here.
+        const std::string &getSourcePath() const { return sourcePath; }
 
     private:
+        void create(Builder &builder);
+        // coarsest level whose object space error times pixelsPerUnit stays under maxErrorPixels
+        uint32_t selectLodForPixels(float pixelsPerUnit, float maxErrorPixels) const;
         void createVertexBuffers(const std::vector<Vertex> &vertices);
         void createIndexBuffers(const std::vector<uint32_t> &indices);
+        void createMeshletBuffers(const std::vector<VkeMeshlet> &meshlets);
 
         VkeDevice &vkeDevice;
+        VkeGeometryArena *geometryArena;
 
-        std::unique_ptr<VkeBuffer> vertexBuffer;
+        VkeGeometryRange vertexRange{};
         uint32_t vertexCount;
+        glm::mat4 positionDecodeMatrix{1.f};
 
         bool hasIndexBuffer = false;
-        std::unique_ptr<VkeBuffer> indexBuffer;
+        VkeGeometryRange indexRange{};
         uint32_t indexCount;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        std::vector<Lod> lods;
+
+        std::unique_ptr<VkeBuffer> meshletBuffer;
+        uint32_t meshletCount = 0;
+
+        VkeAabb bounds{};
+        std::string sourcePath;
+    };
+}
+
+namespace std
+{
+    // hash function for Vertex to check for duplicates
+    template <>
+    struct hash<vke::VkeModel::Vertex>
+    {
+        size_t operator()(vke::VkeModel::Vertex const &vertex) const;
     };
 }
\ No newline at end of file
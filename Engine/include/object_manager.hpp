@@ -2,10 +2,14 @@
 
 #include "texture.hpp"
 #include "model.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
+#include "scene.hpp"
 #include "settings.hpp"
 
 #include "memory"
+#include <array>
+#include <map>
+#include <string>
 #include <unordered_map>
 #include <vulkan/vulkan.h>
 
@@ -22,7 +26,7 @@ namespace vke
     class ObjectManager
     {
     public:
-        ObjectManager(VkeDevice &vkeDevice);
+        ObjectManager(VkeDevice &vkeDevice, VkeGeometryArena &geometryArena);
         ~ObjectManager() = default;
         // Not copyable or movable
         ObjectManager(ObjectManager &&) = delete;
@@ -32,12 +36,19 @@ namespace vke
 
         ObjectManager &addModel(const std::string &filepath);
         ObjectManager &addTexture(const std::string &filepath, TextureType type = TextureType::VKE_TEXTURE_TYPE_ALBEDO);
-        VkeGameObject build(glm::vec3 translation = {0.f, 0.f, 0.f}, glm::vec3 scale = {1.f, 1.f, 1.f});
+        ObjectManager &setStatic(bool isStatic = true);
+        // creates an entity in scene with a transform and a renderable made of the pending model and textures
+        VkeEntity build(VkeScene &scene, glm::vec3 translation = {0.f, 0.f, 0.f}, glm::vec3 scale = {1.f, 1.f, 1.f});
 
         float getTextureCount() { return textureCount; }
 
     private:
+        // the material of the pending textures, created when no live object uses it yet
+        std::shared_ptr<VkeMaterial> getMaterial();
+        std::shared_ptr<VkeTexture> getTexture(const std::string &filepath);
+
         VkeDevice &vkeDevice;
+        VkeGeometryArena &geometryArena;
         float textureCount{0};
         const std::string defaultTexturePath = std::string(VKENGINE_ABSOLUTE_PATH) + "textures/default_albedo.jpg";
         const std::string defaultNormalPath = std::string(VKENGINE_ABSOLUTE_PATH) + "textures/default_normal.jpg";
@@ -45,12 +56,15 @@ namespace vke
         const std::string defaultMetallicPath = std::string(VKENGINE_ABSOLUTE_PATH) + "textures/default_metallic.jpg";
         const std::string defaultAOPath = std::string(VKENGINE_ABSOLUTE_PATH) + "textures/default_AO.jpg";
 
-        std::shared_ptr<VkeModel> currentModel;
+        // the model is only loaded in build(), once it is known whether it is static
+        std::string currentModelPath;
+        bool currentIsStatic{false};
+
+        // indexed by TextureType, empty for the ones left at their default
+        std::array<std::string, 5> currentTexturePaths;
 
-        std::shared_ptr<VkeTexture> currentAlbedo;
-        std::shared_ptr<VkeTexture> currentNormal;
-        std::shared_ptr<VkeTexture> currentRoughness;
-        std::shared_ptr<VkeTexture> currentMetallic;
-        std::shared_ptr<VkeTexture> currentAO;
+        // shared while any object uses them
+        std::map<std::array<std::string, 5>, std::weak_ptr<VkeMaterial>> materials;
+        std::unordered_map<std::string, std::weak_ptr<VkeTexture>> textures;
     };
 } // namespace vke
\ No newline at end of file
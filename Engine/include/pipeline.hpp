@@ -46,11 +46,13 @@ namespace vke
         void bind(VkCommandBuffer commandBuffer);
 
         static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo, float depthBiasConstantFactor = 0.f, float depthBiasSlopeFactor = 0.f);
-        static void defaultShadowPipelineConfigInfo(PipelineConfigInfo &configInfo);
+        // positionStream reads VkeModel::PositionVertex instead of the full vertices, see VkeModel::hasPositionStreams
+        static void defaultShadowPipelineConfigInfo(PipelineConfigInfo &configInfo, bool positionStream);
         static void enableAlphaBlending(PipelineConfigInfo &configInfo);
 
+        static std::vector<char> readFile(const std::string &filePath);
+
     private:
-        std::vector<char> readFile(const std::string &filePath);
         void createGraphicsPipeline(
             const std::string &vertFilePath,
             const std::string &fragFilePath,
@@ -62,4 +64,19 @@ namespace vke
         VkShaderModule vertShaderModule;
         VkShaderModule fragShaderModule;
     };
+
+    class VkeComputePipeline
+    {
+    public:
+        VkeComputePipeline(VkeDevice &device, const std::string &compFilepath, VkPipelineLayout pipelineLayout);
+        ~VkeComputePipeline();
+        VkeComputePipeline(const VkeComputePipeline &) = delete;
+        VkeComputePipeline operator=(const VkeComputePipeline &) = delete;
+
+        void bind(VkCommandBuffer commandBuffer);
+
+    private:
+        VkeDevice &vkeDevice;
+        VkPipeline computePipeline;
+    };
 } // namespace vke
\ No newline at end of file
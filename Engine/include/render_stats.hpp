@@ -0,0 +1,87 @@
+#pragma once
+
+#include "settings.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+
+namespace vke
+{
+    typedef enum VkeStatCounter
+    {
+        VKE_STAT_DRAW_CALLS = 0,
+        VKE_STAT_TRIANGLES,            // of direct draws, meshlet culled draws leave the count to the GPU
+        VKE_STAT_PIPELINE_BINDS,
+        VKE_STAT_DESCRIPTOR_SET_BINDS, // one per vkCmdBindDescriptorSets call
+        VKE_STAT_PUSH_CONSTANT_BYTES,
+        VKE_STAT_BUFFER_WRITE_BYTES,   // through VkeBuffer::writeToBuffer
+        VKE_STAT_STAGING_BYTES,        // copied from staging buffers to device local memory
+        VKE_STAT_OBJECTS_CULLED,       // by the camera frustum
+        VKE_STAT_STATIC_CHUNKS_CULLED, // by the camera frustum, the objects in them included in the count above
+        VKE_STAT_COUNT
+    } VkeStatCounter;
+
+    // Engine wide render counters. Every thread adds to running totals of its own, so recording
+    // workers never share a cache line, and VkeStatsHistory turns the sum of all threads into per frame values.
+    class VkeRenderStats
+    {
+    public:
+        using Counters = std::array<uint64_t, VKE_STAT_COUNT>;
+
+        static const char *getName(VkeStatCounter counter);
+
+        static void add(VkeStatCounter counter, uint64_t value);
+        static void add(const Counters &counters);
+        // running totals of the calling thread, the difference of two calls is what it added in between
+        static Counters getThreadTotals();
+        // running totals of every thread that ever added a counter
+        static Counters getTotals();
+    };
+
+    // Per frame counter values and frame times over the last RENDER_STATS_HISTORY frames
+    class VkeStatsHistory
+    {
+    public:
+        struct FrameTimes
+        {
+            float min = 0.f;
+            float average = 0.f;
+            float max = 0.f;
+            float p99 = 0.f;
+        };
+
+        VkeStatsHistory();
+
+        VkeStatsHistory(const VkeStatsHistory &) = delete;
+        VkeStatsHistory &operator=(const VkeStatsHistory &) = delete;
+
+        // Call once at the end of every frame, after all its recording threads are done. Frame times are
+        // measured between calls, in milliseconds.
+        void endFrame();
+
+        uint64_t getLatest(VkeStatCounter counter) const { return latest[counter]; }
+        const FrameTimes &getFrameTimes() const { return frameTimes; }
+        // oldest first when read from getHistoryOffset(), wrapping around, as ImGui::PlotLines takes them
+        const float *getHistory(VkeStatCounter counter) const { return counterHistory[counter].data(); }
+        const float *getFrameTimeHistory() const { return frameTimeHistory.data(); }
+        int getHistoryOffset() const { return static_cast<int>(next); }
+        int getHistorySize() const { return RENDER_STATS_HISTORY; }
+
+    private:
+        VkeRenderStats::Counters previousTotals{};
+        VkeRenderStats::Counters latest{};
+        std::array<std::array<float, RENDER_STATS_HISTORY>, VKE_STAT_COUNT> counterHistory{};
+        std::array<float, RENDER_STATS_HISTORY> frameTimeHistory{};
+        uint32_t next = 0;
+        uint32_t recordedFrames = 0;
+        uint64_t lastFrameNs = 0;
+        FrameTimes frameTimes{};
+    };
+} // namespace vke
+
+#if RENDER_STATS_ENABLED
+#define VKE_STAT_ADD(counter, value) ::vke::VkeRenderStats::add(counter, static_cast<uint64_t>(value))
+#else
+#define VKE_STAT_ADD(counter, value) ((void)0)
+#endif
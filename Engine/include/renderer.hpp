@@ -2,11 +2,17 @@
 
 #include "window.hpp"
 #include "device.hpp"
+#include "gpu_profiler.hpp"
 #include "swap_chain.hpp"
+#include "settings.hpp"
+#include "timeline.hpp"
 
 #include <vulkan/vulkan.h>
 // std
+#include <array>
 #include <cassert>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -15,7 +21,7 @@ namespace vke
     class VkeRenderer
     {
     public:
-        VkeRenderer(VkeWindow &vkeWindow, VkeDevice &vkeDevice);
+        VkeRenderer(VkeWindow &vkeWindow, VkeDevice &vkeDevice, uint32_t recordingThreadCount = 1);
         ~VkeRenderer();
 
         VkeRenderer(const VkeRenderer &) = delete;
@@ -27,12 +33,13 @@ namespace vke
         VkFramebuffer getSwapChainFrameBuffer(int index) const { return vkeSwapChain->getFrameBuffer(index); }
         VkFramebuffer getShadowMapFrameBuffer() const { return vkeSwapChain->getShadowMapFrameBuffer(); }
         float getAspectRatio() const { return vkeSwapChain->extentAspectRatio(); }
+        VkExtent2D getSwapChainExtent() const { return vkeSwapChain->getSwapChainExtent(); }
         bool isFrameInProgress() const { return isFrameStarted; }
 
         VkCommandBuffer getCurrentCommandBuffer() const
         {
             assert(isFrameStarted && "cannot get command buffer when frame not in progress");
-            return commandBuffers[currentFrameIndex];
+            return commandBuffers[currentFrameIndex * 2 + (earlyCommandsSubmitted ? 1 : 0)];
         }
         int getFrameIndex() const
         {
@@ -41,23 +48,87 @@ namespace vke
         }
 
         VkCommandBuffer beginFrame();
+        // Submits the commands recorded so far on their own and continues the frame in the command buffer
+        // returned. They carry none of the frame's waits, so passes that don't depend on other queues run
+        // while the rest of the frame waits for them. At most once per frame, outside of render passes.
+        VkCommandBuffer submitEarlyCommands();
         void endFrame();
-        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-        void beginShadowSwapChainRenderPass(VkCommandBuffer commandBuffer);
+        // each render pass is measured as a GPU profiler scope with pipeline statistics
+        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+        void beginShadowSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
         void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+        VkeGpuProfiler &getGpuProfiler() { return *gpuProfiler; }
+        // Makes this frame's submission, not its early commands, wait at stage for work another queue
+        // signals, value being the timeline value to reach.
+        void waitBeforeFrame(VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value);
+        // Runs destroy once the graphics queue finished the frame being recorded, or everything
+        // submitted so far outside of a frame. For resources the frames in flight may still use.
+        void deferDestroy(std::function<void()> destroy);
+
+        // Secondary command buffers continue the render pass that is currently open on the primary.
+        // Each recording thread owns its own command pool per frame in flight, so threadIndex must be
+        // unique among the threads recording concurrently.
+        VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex);
+        // reports failures instead of throwing, for worker threads, which must not throw
+        VkResult beginSecondaryCommandBuffer(uint32_t threadIndex, VkCommandBuffer *commandBuffer);
+        void executeSecondaryCommandBuffers(VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer> &secondaryCommandBuffers);
+        uint32_t getRecordingThreadCount() const { return static_cast<uint32_t>(secondaryPools.size()); }
+        VkRenderPass getActiveRenderPass() const { return activeRenderPass; }
+        const VkViewport &getActiveViewport() const { return activeViewport; }
+        const VkRect2D &getActiveScissor() const { return activeScissor; }
+
     private:
+        struct DeferredDestroy
+        {
+            // on the device's graphics timeline
+            uint64_t value;
+            std::function<void()> destroy;
+        };
+
+        struct SecondaryCommandPool
+        {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> commandBuffers;
+            uint32_t usedCount = 0;
+        };
+
         void createCommandBuffers();
         void freeCommandBuffers();
+        void createSecondaryCommandPools(uint32_t threadCount);
+        void destroySecondaryCommandPools();
+        void resetSecondaryCommandPools();
         void recreateSwapChain();
+        // runs the deferred destructions whose frames finished, waiting for all of them when wait is set
+        void retireDeferredDestroys(bool wait);
 
         VkeWindow &vkeWindow;
         VkeDevice &vkeDevice;
         std::unique_ptr<VkeSwapChain> vkeSwapChain;
+        std::unique_ptr<VkeGpuProfiler> gpuProfiler;
+        // two per frame slot, the second continues a frame after submitEarlyCommands()
         std::vector<VkCommandBuffer> commandBuffers;
+        VkeSubmitSemaphores frameSemaphores{};
+        // graphics timeline value each frame slot and swap chain image was last submitted with
+        std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frameValues{};
+        std::vector<uint64_t> imageValues;
+        // destructions deferred while recording, valued once the frame is submitted
+        std::vector<std::function<void()>> frameDestroys;
+        // oldest first
+        std::deque<DeferredDestroy> deferredDestroys;
+        // [thread][frame in flight]
+        std::vector<std::array<SecondaryCommandPool, MAX_FRAMES_IN_FLIGHT>> secondaryPools;
+
+        // state of the render pass currently recorded, inherited by secondary command buffers
+        VkRenderPass activeRenderPass = VK_NULL_HANDLE;
+        VkFramebuffer activeFramebuffer = VK_NULL_HANDLE;
+        VkViewport activeViewport{};
+        VkRect2D activeScissor{};
+        uint32_t activeProfilerScope = VkeGpuProfiler::NO_SCOPE;
 
         uint32_t currentImageIndex;
-        int currentFrameIndex;
+        int currentFrameIndex = 0;
         bool isFrameStarted = false;
+        bool earlyCommandsSubmitted = false;
     };
 } // namespace vke
\ No newline at end of file
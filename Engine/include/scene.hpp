@@ -0,0 +1,229 @@
+#pragma once
+
+#include "components.hpp"
+#include "model.hpp"
+#include "thread_pool.hpp"
+
+#include <vulkan/vulkan.h>
+// std
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vke
+{
+    // Generational handle, stale handles to a destroyed entity never alias the entity that reuses its slot
+    struct VkeEntity
+    {
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+        uint32_t index = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        bool isValid() const { return index != INVALID_INDEX; }
+        bool operator==(const VkeEntity &other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const VkeEntity &other) const { return !(*this == other); }
+    };
+
+    // Hands out entity slots, safe to call from any thread
+    class VkeEntityAllocator
+    {
+    public:
+        VkeEntity create();
+        // returns false if the handle was already stale
+        bool destroy(VkeEntity entity);
+        bool isAlive(VkeEntity entity) const;
+        uint32_t getAliveCount() const;
+
+    private:
+        mutable std::mutex mutex;
+        std::vector<uint32_t> generations;
+        std::vector<uint32_t> freeIndices;
+        uint32_t aliveCount = 0;
+    };
+
+    // Maps entities to a densely packed index. Component stores derive from it and keep one
+    // vector per field, so a system only touches the fields it reads.
+    class VkeSparseSet
+    {
+    public:
+        static constexpr uint32_t NOT_FOUND = std::numeric_limits<uint32_t>::max();
+
+        bool contains(VkeEntity entity) const { return indexOf(entity) != NOT_FOUND; }
+        uint32_t indexOf(VkeEntity entity) const;
+        uint32_t size() const { return static_cast<uint32_t>(entities.size()); }
+        bool empty() const { return entities.empty(); }
+        // bumped when a slot is added or removed, dense indices held elsewhere stay valid while it is unchanged
+        uint64_t getLayoutVersion() const { return layoutVersion; }
+
+        // owner of each dense slot
+        std::vector<VkeEntity> entities;
+
+    protected:
+        // returns the dense index the caller has to push its fields to
+        uint32_t insertEntity(VkeEntity entity);
+        // Removes the entity by moving the last slot into its place. Returns the dense index that was
+        // removed, the caller does the same swap on its fields, or NOT_FOUND if the entity had no slot.
+        uint32_t eraseEntity(VkeEntity entity);
+
+        template <typename T>
+        static void swapRemove(std::vector<T> &field, uint32_t index)
+        {
+            if (index + 1 != field.size())
+            {
+                field[index] = std::move(field.back());
+            }
+            field.pop_back();
+        }
+
+    private:
+        std::vector<uint32_t> sparse;
+        uint64_t layoutVersion = 0;
+    };
+
+    // World and normal matrices are cached per transform. The setters mark a transform dirty and
+    // updateMatrices() recomputes only the dirty ones, once per frame before any pass reads them.
+    // A transform may have a parent, its translation, rotation and scale are then relative to the
+    // parent and moving the parent moves the whole subtree.
+    class TransformStore : public VkeSparseSet
+    {
+    public:
+        uint32_t add(VkeEntity entity, const TransformComponent &transform);
+        void remove(VkeEntity entity);
+        TransformComponent get(uint32_t index) const;
+
+        void setTranslation(uint32_t index, const glm::vec3 &translation);
+        void setRotation(uint32_t index, const glm::vec3 &rotation);
+        void setScale(uint32_t index, const glm::vec3 &scale);
+        const glm::vec3 &getTranslation(uint32_t index) const { return translations[index]; }
+        const glm::vec3 &getRotation(uint32_t index) const { return rotations[index]; }
+        const glm::vec3 &getScale(uint32_t index) const { return scales[index]; }
+
+        // An invalid parent detaches the transform. The parent needs a transform and must not be a
+        // descendant. Local values are kept, so the transform jumps to its new parent's space.
+        void setParent(uint32_t index, VkeEntity parent);
+        VkeEntity getParent(uint32_t index) const { return parents[index]; }
+        uint32_t getDepth(uint32_t index) const { return depths[index]; }
+
+        // Returns how many matrices were recomputed. Large batches are split across threadPool when given.
+        uint32_t updateMatrices(VkeThreadPool *threadPool = nullptr);
+        // bumped whenever any transform changes, lets caches of derived data skip unchanged frames
+        uint64_t getVersion() const { return version; }
+        // Counts the updateMatrices() calls that recomputed anything. getUpdatedIndices() holds the
+        // slots recomputed by the latest of them, subtree children included.
+        uint64_t getUpdateCount() const { return updateCount; }
+        const std::vector<uint32_t> &getUpdatedIndices() const { return dirtyIndices; }
+        // the update count when the slot's matrices were last recomputed, changes whenever it moves
+        uint64_t getMatrixVersion(uint32_t index) const { return matrixVersions[index]; }
+
+        const glm::mat4 &getWorldMatrix(uint32_t index) const
+        {
+            assert(!dirty[index] && "world matrix read before updateMatrices");
+            return worldMatrices[index];
+        }
+        // stored as a mat4 since that is what the push constants take
+        const glm::mat4 &getNormalMatrix(uint32_t index) const
+        {
+            assert(!dirty[index] && "normal matrix read before updateMatrices");
+            return normalMatrices[index];
+        }
+
+    private:
+        void markDirty(uint32_t index);
+        void unlinkFromParent(uint32_t index);
+        void updateSubtreeDepths(uint32_t index);
+        void collectDirtySubtrees();
+        void propagateToChildren(VkeThreadPool *threadPool);
+
+        std::vector<glm::vec3> translations;
+        std::vector<glm::vec3> rotations;
+        std::vector<glm::vec3> scales;
+        std::vector<glm::mat4> worldMatrices;
+        std::vector<glm::mat4> normalMatrices;
+        std::vector<uint8_t> dirty;
+        std::vector<uint64_t> matrixVersions;
+        // hierarchy, children form a singly linked list through firstChildren / nextSiblings
+        std::vector<VkeEntity> parents;
+        std::vector<VkeEntity> firstChildren;
+        std::vector<VkeEntity> nextSiblings;
+        std::vector<uint32_t> depths;
+        uint32_t parentedCount = 0;
+
+        // scratch for updateMatrices
+        std::vector<uint32_t> dirtyIndices;
+        std::vector<uint32_t> propagationOrder;
+        std::vector<uint32_t> levelOffsets;
+        uint32_t dirtyCount = 0;
+        uint64_t version = 0;
+        uint64_t updateCount = 0;
+    };
+
+    struct RenderableComponent
+    {
+        std::shared_ptr<VkeModel> model;
+        std::shared_ptr<VkeMaterial> material;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        // static objects are expected to rarely move, their draws are recorded once and replayed until they do
+        bool isStatic = false;
+    };
+
+    class RenderableStore : public VkeSparseSet
+    {
+    public:
+        uint32_t add(VkeEntity entity, const RenderableComponent &renderable);
+        void remove(VkeEntity entity);
+        RenderableComponent get(uint32_t index) const;
+
+        // hot, read every frame while recording
+        std::vector<VkeModel *> models;
+        std::vector<VkDescriptorSet> descriptorSets;
+        std::vector<int> hasNormalMap;
+        std::vector<uint8_t> isStatic;
+        // cold, keep the assets alive
+        std::vector<std::shared_ptr<VkeModel>> modelRefs;
+        std::vector<std::shared_ptr<VkeMaterial>> materials;
+    };
+
+    class PointLightStore : public VkeSparseSet
+    {
+    public:
+        uint32_t add(VkeEntity entity, const PointLightComponent &light);
+        void remove(VkeEntity entity);
+        // light indices farthest from viewer first, so blended billboards draw back to front
+        void sortBackToFront(const TransformStore &transforms, glm::vec3 viewer, std::vector<uint32_t> &order) const;
+
+        std::vector<glm::vec3> colors;
+        std::vector<float> intensities;
+        std::vector<float> radii;
+    };
+
+    // Owns every entity and its components. Entity creation is thread safe. Stores may be read from
+    // several threads at once but only written from one, with no readers running.
+    class VkeScene
+    {
+    public:
+        VkeScene() = default;
+
+        VkeScene(const VkeScene &) = delete;
+        VkeScene &operator=(const VkeScene &) = delete;
+
+        VkeEntity createEntity() { return allocator.create(); }
+        void destroyEntity(VkeEntity entity);
+        bool isAlive(VkeEntity entity) const { return allocator.isAlive(entity); }
+        uint32_t getEntityCount() const { return allocator.getAliveCount(); }
+
+        // new entity carrying a copy of every component of source
+        VkeEntity clone(VkeEntity source);
+        VkeEntity createPointLight(float intensity = 10.f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
+
+        TransformStore transforms;
+        RenderableStore renderables;
+        PointLightStore pointLights;
+
+    private:
+        VkeEntityAllocator allocator;
+    };
+} // namespace vke
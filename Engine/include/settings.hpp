@@ -11,9 +11,73 @@
 #endif
 
 #define MAX_FRAMES_IN_FLIGHT 2
+// below this many draws per worker, command recording is not worth splitting across threads
+#define RENDER_OBJECTS_PER_THREAD 256
+// below this many dirty transforms per worker, matrix updates are not worth splitting across threads
+#define TRANSFORMS_PER_THREAD 1024
+// SAH candidates per axis when splitting a BVH node, and the item count below which a node may stay a leaf
+#define BVH_SAH_BINS 16
+#define BVH_MAX_LEAF_SIZE 4
+// a refitted BVH is rebuilt once its SAH cost exceeds the cost it was built with by this factor
+#define BVH_REBUILD_RATIO 1.5f
+// levels per model including the full detail one, and the largest simplification error as a
+// fraction of the model's bounds diagonal
+#define MAX_LOD_COUNT 5
+#define LOD_MAX_ERROR_RATIO 0.05f
+// projected LOD error allowed before a finer level is picked, the shadow pass accepts coarser meshes
+#define LOD_ERROR_PIXELS 1.0f
+#define SHADOW_LOD_ERROR_PIXELS 4.0f
+// FIFO post transform cache size ACMR is measured with and overdraw clusters are cut against
+#define VERTEX_CACHE_SIZE 16
+// loaded vertices closer than this in every attribute are merged, positions relative to the bounds diagonal
+#define VERTEX_WELD_EPSILON 1e-5f
+// meshlet size limits, and the triangle count below which a mesh is only culled as a whole
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MIN_TRIANGLES 4096
+// Vertex buffer layout. Compact stores 16 bit positions within the mesh bounds, 16 bit octahedral normals
+// and half float uvs (16 bytes), otherwise full floats (28 bytes). Colors add 4 or 12 bytes when stored,
+// without them every vertex reads as white.
+#define VERTEX_FORMAT_COMPACT 1
+#define VERTEX_FORMAT_COLOR 0
+// models also keep a tightly packed copy of their positions (6 bytes compact, 12 full) for the shadow pass
+#define SHADOW_POSITION_STREAM 1
+// element capacities of the shared buffers every model's geometry is sub-allocated from, the index
+// capacity applies to the 16 and the 32 bit index buffer each
+#define GEOMETRY_VERTEX_CAPACITY (1u << 20)
+#define GEOMETRY_INDEX_CAPACITY (1u << 22)
+// bytes of transient uniform and storage data every frame in flight can sub-allocate from the frame ring
+#define FRAME_RING_CAPACITY (1u << 20)
+// sets in the first pool of a descriptor allocator, every pool it adds holds twice as many up to the max
+#define DESCRIPTOR_POOL_INITIAL_SETS 64u
+#define DESCRIPTOR_POOL_MAX_SETS 4096u
+// static objects are culled per cube of this many world units, and those sharing a material are merged
+// per cube, so every merged batch is still culled with its chunk
+#define STATIC_BATCH_CHUNK_SIZE 16.f
 
 #define WIDTH 1920
 #define HEIGHT 1080
 
 #define MAX_FRAME_TIME 0.1f
+// scopes the GPU profiler measures per frame, later ones are skipped
+#define GPU_PROFILER_MAX_SCOPES 32
+// CPU trace markers compile to nothing when 0
+#define TRACE_ENABLED 1
+// finished scopes every thread keeps, a power of two
+#define TRACE_RING_CAPACITY 16384
+// the flight recorder dumps the trace of this many seconds when a frame takes longer than the budget
+#define TRACE_FLIGHT_RECORDER_SECONDS 5.0
+#define TRACE_HITCH_BUDGET_MS 50.0
+// render counters compile to nothing when 0, frame times are still kept
+#define RENDER_STATS_ENABLED 1
+// frames the stats HUD graphs and takes frame time percentiles over
+#define RENDER_STATS_HISTORY 240
+// --bench: frames measured after the warm up frames, and the fixed simulation step of every frame
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_WARMUP_FRAMES 60
+#define BENCH_TIMESTEP (1.f / 60.f)
+// the stress scene generator always places the same instances
+#define BENCH_SEED 1234u
 #define SHADOWMAP_DIM 4096
+// EVSM moments are prefiltered down from the depth map, one texel per 4x4 depth texels
+#define SHADOWMAP_MOMENTS_DIM 1024
@@ -0,0 +1,119 @@
+#pragma once
+
+// std
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define VKE_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VKE_SIMD_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define VKE_SIMD_NEON
+#endif
+
+namespace vke
+{
+    namespace simd
+    {
+        // Each Lanes type wraps one register width, kernels are written once against them and
+        // instantiated for VectorLanes plus ScalarLanes for the tail of a batch
+        struct ScalarLanes
+        {
+            using Reg = float;
+            static constexpr uint32_t WIDTH = 1;
+            static constexpr const char *NAME = "scalar";
+
+            static Reg load(const float *p) { return *p; }
+            static void store(float *p, Reg v) { *p = v; }
+            static Reg set1(float v) { return v; }
+            static Reg add(Reg a, Reg b) { return a + b; }
+            static Reg sub(Reg a, Reg b) { return a - b; }
+            static Reg mul(Reg a, Reg b) { return a * b; }
+            static Reg div(Reg a, Reg b) { return a / b; }
+            // a * b + c
+            static Reg fmadd(Reg a, Reg b, Reg c) { return a * b + c; }
+            static Reg floor(Reg a) { return std::floor(a); }
+            static Reg min(Reg a, Reg b) { return a < b ? a : b; }
+            static Reg max(Reg a, Reg b) { return a > b ? a : b; }
+            // bit i set when lane i of a <= lane i of b
+            static uint32_t lessEqual(Reg a, Reg b) { return a <= b ? 1u : 0u; }
+        };
+
+#if defined(VKE_SIMD_AVX2)
+        struct VectorLanes
+        {
+            using Reg = __m256;
+            static constexpr uint32_t WIDTH = 8;
+            static constexpr const char *NAME = "avx2";
+
+            static Reg load(const float *p) { return _mm256_load_ps(p); }
+            static void store(float *p, Reg v) { _mm256_store_ps(p, v); }
+            static Reg set1(float v) { return _mm256_set1_ps(v); }
+            static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+            static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+            static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+            static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+            static Reg fmadd(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+            static Reg floor(Reg a) { return _mm256_floor_ps(a); }
+            static Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+            static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+            static uint32_t lessEqual(Reg a, Reg b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))); }
+        };
+#elif defined(VKE_SIMD_SSE2)
+        struct VectorLanes
+        {
+            using Reg = __m128;
+            static constexpr uint32_t WIDTH = 4;
+            static constexpr const char *NAME = "sse2";
+
+            static Reg load(const float *p) { return _mm_load_ps(p); }
+            static void store(float *p, Reg v) { _mm_store_ps(p, v); }
+            static Reg set1(float v) { return _mm_set1_ps(v); }
+            static Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+            static Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+            static Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+            static Reg div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+            static Reg fmadd(Reg a, Reg b, Reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+            static Reg floor(Reg a)
+            {
+                // SSE2 has no floor, truncate and step down where truncation rounded up
+                Reg truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+                return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.f)));
+            }
+            static Reg min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+            static Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+            static uint32_t lessEqual(Reg a, Reg b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(a, b))); }
+        };
+#elif defined(VKE_SIMD_NEON)
+        struct VectorLanes
+        {
+            using Reg = float32x4_t;
+            static constexpr uint32_t WIDTH = 4;
+            static constexpr const char *NAME = "neon";
+
+            static Reg load(const float *p) { return vld1q_f32(p); }
+            static void store(float *p, Reg v) { vst1q_f32(p, v); }
+            static Reg set1(float v) { return vdupq_n_f32(v); }
+            static Reg add(Reg a, Reg b) { return vaddq_f32(a, b); }
+            static Reg sub(Reg a, Reg b) { return vsubq_f32(a, b); }
+            static Reg mul(Reg a, Reg b) { return vmulq_f32(a, b); }
+            static Reg div(Reg a, Reg b) { return vdivq_f32(a, b); }
+            static Reg fmadd(Reg a, Reg b, Reg c) { return vfmaq_f32(c, a, b); }
+            static Reg floor(Reg a) { return vrndmq_f32(a); }
+            static Reg min(Reg a, Reg b) { return vminq_f32(a, b); }
+            static Reg max(Reg a, Reg b) { return vmaxq_f32(a, b); }
+            static uint32_t lessEqual(Reg a, Reg b)
+            {
+                const uint32_t bits[4] = {1, 2, 4, 8};
+                return vaddvq_u32(vandq_u32(vcleq_f32(a, b), vld1q_u32(bits)));
+            }
+        };
+#else
+        using VectorLanes = ScalarLanes;
+#endif
+    } // namespace simd
+} // namespace vke
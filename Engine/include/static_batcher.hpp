@@ -0,0 +1,50 @@
+#pragma once
+
+#include "device.hpp"
+#include "geometry_arena.hpp"
+#include "model.hpp"
+#include "renderer.hpp"
+#include "scene.hpp"
+
+// std
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace vke
+{
+    // Merges static renderables that share a material into one pre-transformed mesh per material and
+    // STATIC_BATCH_CHUNK_SIZE cube, so they draw as one object while VkeStaticChunks still culls chunks apart.
+    // The merged meshes are added to the scene as static renderables of their own and replace the
+    // originals, which are kept aside until clear() puts them back. Only models loaded from a file are
+    // merged, their geometry is loaded again from it while building, see VkeModel::getSourcePath().
+    class VkeStaticBatcher
+    {
+    public:
+        // merged models are released through renderer, frames in flight may still draw them
+        VkeStaticBatcher(VkeDevice &device, VkeGeometryArena &geometryArena, VkeRenderer &renderer);
+
+        VkeStaticBatcher(const VkeStaticBatcher &) = delete;
+        VkeStaticBatcher &operator=(const VkeStaticBatcher &) = delete;
+
+        // Undoes the previous build, then merges the scene's static renderables again. Call between
+        // frames. Returns the batch count.
+        uint32_t build(VkeScene &scene);
+        // destroys the batch entities and gives the original entities their renderables back
+        void clear(VkeScene &scene);
+
+        uint32_t getBatchCount() const { return static_cast<uint32_t>(batches.size()); }
+
+    private:
+        struct Batch
+        {
+            VkeEntity entity;
+            std::vector<std::pair<VkeEntity, RenderableComponent>> sources;
+        };
+
+        VkeDevice &vkeDevice;
+        VkeGeometryArena &geometryArena;
+        VkeRenderer &vkeRenderer;
+        std::vector<Batch> batches;
+    };
+} // namespace vke
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "device.hpp"
+#include "scene.hpp"
+#include "render_stats.hpp"
+#include "renderer.hpp"
+#include "settings.hpp"
+
+#include <vulkan/vulkan.h>
+// std
+#include <array>
+#include <cstdint>
+#include <functional>
+
+namespace vke
+{
+    // A secondary command buffer per frame in flight holding the draws of static objects.
+    // It is recorded once and replayed every frame until the render pass, viewport, descriptor set, its
+    // dynamic offset or static object set it was recorded against changes, or until invalidate() is called.
+    class VkeStaticBundle
+    {
+    public:
+        using RecordFn = std::function<void(VkCommandBuffer commandBuffer)>;
+
+        VkeStaticBundle(VkeDevice &device);
+        ~VkeStaticBundle();
+
+        VkeStaticBundle(const VkeStaticBundle &) = delete;
+        VkeStaticBundle &operator=(const VkeStaticBundle &) = delete;
+
+        // Order independent contribution of one object to the static set hash. Covers the entity, its
+        // model, the LOD drawn, its material descriptor and TransformStore::getMatrixVersion() so changing
+        // any of them, moving or reparenting the object included, re-records the bundle.
+        static uint64_t hashStaticObject(VkeEntity entity, const VkeModel *model, uint32_t lod, VkDescriptorSet descriptorSet, uint64_t matrixVersion);
+
+        // forces every frame's copy to be re-recorded, call when a pipeline or per object descriptor is replaced
+        void invalidate();
+
+        // Returns the bundle for frameIndex, re-recording it through record when stale. Must be called
+        // inside the render pass the bundle is executed in, after the slot's last frame finished.
+        VkCommandBuffer get(VkeRenderer &renderer, int frameIndex, VkDescriptorSet descriptorSet, uint32_t dynamicOffset, uint64_t staticSetHash, const RecordFn &record);
+
+    private:
+        struct Entry
+        {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            bool valid = false;
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            VkViewport viewport{};
+            VkRect2D scissor{};
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            uint32_t dynamicOffset = 0;
+            uint64_t staticSetHash = 0;
+            // counted while recording, added again on every replay
+            VkeRenderStats::Counters recordedStats{};
+        };
+
+        bool isStale(const Entry &entry, VkeRenderer &renderer, VkDescriptorSet descriptorSet, uint32_t dynamicOffset, uint64_t staticSetHash) const;
+
+        VkeDevice &vkeDevice;
+        VkCommandPool commandPool;
+        std::array<Entry, MAX_FRAMES_IN_FLIGHT> entries;
+    };
+} // namespace vke
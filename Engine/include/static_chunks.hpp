@@ -0,0 +1,57 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "scene.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace vke
+{
+    // Groups the scene's static renderables by the STATIC_BATCH_CHUNK_SIZE cube their world bounds are
+    // centered in. A chunk is culled as a whole and replays a static bundle of its own, so the view only
+    // decides which bundles are replayed and never what they hold.
+    class VkeStaticChunks
+    {
+    public:
+        using Cell = std::tuple<int64_t, int64_t, int64_t>;
+
+        struct Chunk
+        {
+            // of every object in the chunk, which may reach beyond its cell
+            VkeAabb bounds;
+            // renderable indices in storage order
+            std::vector<uint32_t> objects;
+        };
+
+        // the cube point falls in, VkeStaticBatcher merges per cube too so batches don't span chunks
+        static Cell getCell(const glm::vec3 &point);
+
+        // Call once per frame after updateMatrices(). Regroups when renderables were added or removed, or
+        // a static renderable's transform was recomputed.
+        void update(const VkeScene &scene);
+        // groups arbitrary boxes, items[i] ends up in the chunk of itemBounds[i]
+        void build(const std::vector<uint32_t> &items, const std::vector<VkeAabb> &itemBounds);
+
+        // Appends to results[f] every chunk whose bounds are not outside frustums[f], in chunk order.
+        void queryFrustums(const VkeFrustum *frustums, uint32_t frustumCount, std::vector<uint32_t> *results) const;
+
+        uint32_t getChunkCount() const { return static_cast<uint32_t>(chunks.size()); }
+        const Chunk &getChunk(uint32_t chunk) const { return chunks[chunk]; }
+
+    private:
+        void rebuild(const VkeScene &scene);
+
+        std::vector<Chunk> chunks;
+
+        // what update() last grouped against
+        uint64_t renderableLayout = ~0ull;
+        uint64_t transformLayout = ~0ull;
+        uint64_t transformUpdates = 0;
+    };
+} // namespace vke
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "device.hpp"
+#include "timeline.hpp"
 
 // vulkan headers
 #include <vulkan/vulkan.h>
@@ -43,8 +44,11 @@ namespace vke
     }
     VkFormat findDepthFormat();
 
+    // Frames are waited for on the device's graphics timeline, the caller waits for the frame that last
+    // used this frame's semaphores, MAX_FRAMES_IN_FLIGHT frames ago, before acquiring.
     VkResult acquireNextImage(uint32_t *imageIndex);
-    VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+    // semaphores holds extra waits and signals of the frame, the image acquisition and presentation are added to it
+    VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex, VkeSubmitSemaphores &semaphores);
 
     bool compareSwapFormats(const VkeSwapChain &other) const
     {
@@ -97,8 +101,6 @@ namespace vke
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> imagesInFlight;
     size_t currentFrame = 0;
   };
 
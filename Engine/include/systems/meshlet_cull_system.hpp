@@ -0,0 +1,113 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "buffer.hpp"
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "frame_info.hpp"
+#include "frame_ring_buffer.hpp"
+#include "model.hpp"
+#include "settings.hpp"
+#include "timeline.hpp"
+
+// std
+#include <array>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vke
+{
+    struct MeshletCullPushConstants
+    {
+        glm::mat4 modelMatrix{1.f};
+        uint32_t outputBase{0};
+        uint32_t commandIndex{0};
+    };
+
+    struct MeshletCullUbo
+    {
+        glm::vec4 frustumPlanes[6];
+        glm::vec4 cameraPosition{0.f};
+    };
+
+    // Culls the meshlets of dense meshes against the camera frustum and their normal cones in a compute
+    // pass. The survivors' indices are compacted into a per frame index buffer, with one indexed
+    // indirect draw per object, so the regular vertex pipeline draws them without mesh shaders.
+    // With an async compute queue the dispatches are submitted there right away, overlapping the shadow
+    // passes submitted ahead of them with VkeRenderer::submitEarlyCommands(), and only the frame's own
+    // graphics submission waits for them before its indirect draws.
+    class MeshletCullSystem
+    {
+    public:
+        // the cull UBO is sub-allocated from frameRing every frame
+        MeshletCullSystem(VkeDevice &device, VkeFrameRingBuffer &frameRing);
+        ~MeshletCullSystem();
+
+        MeshletCullSystem(const MeshletCullSystem &) = delete;
+        MeshletCullSystem &operator=(const MeshletCullSystem &) = delete;
+
+        // Records the cull dispatches for the objects drawing their full detail level into the frame's
+        // command buffer, or submits them to the async compute queue. Call outside a render pass, before
+        // any pass that draws through drawCulled(). objects are the renderable indices the main pass draws,
+        // the objects of every static chunk it replays included, their bundles record culled draws.
+        void cull(FrameInfo &frameInfo, const std::vector<uint32_t> &objects);
+
+        // whether this frame's draw of the renderable has to go through drawCulled()
+        bool isCulled(uint32_t renderable) const { return renderable < culled.size() && culled[renderable]; }
+        // Draws the renderable's surviving meshlets, its model's vertex buffers must already be bound.
+        // Leaves the compacted index buffer bound.
+        void drawCulled(VkCommandBuffer commandBuffer, int frameIndex, uint32_t renderable) const;
+        // changes whenever the buffers or per object slots drawCulled() records against change
+        uint64_t getVersion() const { return version; }
+
+    private:
+        static constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+        struct FrameResources
+        {
+            // one VkDrawIndexedIndirectCommand per renderable, host written, counts bumped by the shader
+            std::unique_ptr<VkeBuffer> commandBuffer;
+            std::unique_ptr<VkeBuffer> indexBuffer;
+            // only with an async compute queue
+            VkCommandBuffer computeCommands = VK_NULL_HANDLE;
+        };
+
+        void createDescriptorSetLayouts();
+        void createPipelineLayout();
+        void createPipeline();
+        // Reassigns output regions after the renderable layout changed, growing buffers as needed. The
+        // replaced buffers are destroyed once the frames in flight finished with them.
+        void prepare(VkeScene &scene, VkeRenderer &renderer);
+        void createFrameBuffers(uint32_t commandCapacity, uint32_t indexCapacity);
+        VkDescriptorSet getModelDescriptorSet(VkeModel *model, VkeDescriptorAllocator &transientDescriptors);
+        void createComputeCommandBuffers();
+        void submitCompute(FrameInfo &frameInfo, FrameResources &frame);
+
+        VkeDevice &vkeDevice;
+        VkeFrameRingBuffer &frameRing;
+        std::unique_ptr<VkeComputePipeline> computePipeline;
+        VkPipelineLayout pipelineLayout;
+        std::unique_ptr<VkeDescriptorSetLayout> frameSetLayout;
+        std::unique_ptr<VkeDescriptorSetLayout> modelSetLayout;
+        // this frame's set of every model dispatched so far
+        std::unordered_map<const VkeModel *, VkDescriptorSet> modelDescriptorSets;
+
+        std::array<FrameResources, MAX_FRAMES_IN_FLIGHT> frames;
+        // signaled by each compute submission, null without an async compute queue
+        std::unique_ptr<VkeTimeline> computeTimeline;
+        uint32_t commandCapacity = 0;
+        uint32_t indexCapacity = 0;
+
+        // output region start and model of each renderable at the last prepare, NO_SLOT without meshlets
+        std::vector<uint32_t> outputBases;
+        std::vector<const VkeModel *> slotModels;
+        uint64_t preparedLayoutVersion = std::numeric_limits<uint64_t>::max();
+        uint64_t version = 0;
+
+        // per frame scratch, indexed by renderable
+        std::vector<uint8_t> culled;
+        std::vector<uint32_t> dispatches;
+    };
+} // namespace vke
@@ -2,7 +2,7 @@
 
 #include "camera.hpp"
 #include "pipeline.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
 #include "device.hpp"
 #include "frame_info.hpp"
 // std
@@ -30,5 +30,7 @@ namespace vke
         VkeDevice &vkeDevice;
         std::unique_ptr<VkePipeline> vkePipeline;
         VkPipelineLayout pipelineLayout;
+        // reused every frame
+        std::vector<uint32_t> sortedLights;
     };
 } // namespace vke
\ No newline at end of file
@@ -2,9 +2,12 @@
 
 #include "camera.hpp"
 #include "pipeline.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
 #include "device.hpp"
 #include "frame_info.hpp"
+#include "static_bundle.hpp"
+#include "static_chunks.hpp"
+#include "systems/meshlet_cull_system.hpp"
 // std
 #include <memory>
 #include <vector>
@@ -25,14 +28,31 @@ namespace vke
 
         RenderSystem(const RenderSystem &) = delete;
         RenderSystem &operator=(const RenderSystem &) = delete;
-        void renderGameObjects(FrameInfo &frameInfo);
+        // Objects are the dynamic renderable indices already culled against the camera frustum, static
+        // objects are drawn by replaying the bundles of the visibleChunks of staticChunks. Objects the
+        // meshlet cull pass handled this frame are drawn from its compacted output.
+        void renderGameObjects(
+            FrameInfo &frameInfo,
+            const std::vector<uint32_t> &objects,
+            const VkeStaticChunks &staticChunks,
+            const std::vector<uint32_t> &visibleChunks,
+            const MeshletCullSystem *meshletCull = nullptr);
 
     private:
         void createPipelineLayout(std::vector<VkDescriptorSetLayout> &setLayouts);
         void createPipeline(VkRenderPass renderPass);
+        void recordGameObjects(FrameInfo &frameInfo, VkCommandBuffer commandBuffer, const std::vector<uint32_t> &objects, uint32_t begin, uint32_t end, const MeshletCullSystem *meshletCull);
 
         VkeDevice &vkeDevice;
         std::unique_ptr<VkePipeline> vkePipeline;
         VkPipelineLayout pipelineLayout;
+        // one per static chunk, kept when there are fewer chunks since a frame in flight may replay them
+        std::vector<std::unique_ptr<VkeStaticBundle>> chunkBundles;
+
+        // LOD picked this frame, indexed by renderable
+        std::vector<uint8_t> selectedLods;
+        std::vector<VkCommandBuffer> secondaryCommandBuffers;
+        // per recording thread
+        std::vector<VkResult> recordResults;
     };
 } // namespace vke
\ No newline at end of file
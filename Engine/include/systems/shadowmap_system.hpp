@@ -2,9 +2,13 @@
 
 #include "camera.hpp"
 #include "pipeline.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
 #include "device.hpp"
+#include "descriptors.hpp"
 #include "frame_info.hpp"
+#include "settings.hpp"
+#include "static_bundle.hpp"
+#include "static_chunks.hpp"
 
 // std
 #include <memory>
@@ -12,11 +16,24 @@
 
 namespace vke
 {
+    typedef enum ShadowFilterMode
+    {
+        VKE_SHADOW_FILTER_PCF_4 = 0,      // 4 hardware bilinear PCF taps
+        VKE_SHADOW_FILTER_POISSON_16 = 1, // 16 rotated Poisson disk taps
+        VKE_SHADOW_FILTER_EVSM = 2        // prefiltered exponential variance shadow map
+    } ShadowFilterMode;
+
     struct ShadowMapPushConstants
     {
         glm::mat4 modelMatrix{1.f};
     };
 
+    struct ShadowMomentsPushConstants
+    {
+        glm::vec2 exponents{5.f};
+        int downsample{1};
+    };
+
     class ShadowMapSystem
     {
     public:
@@ -24,26 +41,70 @@ namespace vke
             VkeDevice &device,
             VkRenderPass shadowRenderPass,
             VkDescriptorSetLayout globalSetLayout,
-            VkExtent2D shadowMapExtent);
+            VkExtent2D shadowMapExtent,
+            VkImageView shadowDepthImageView,
+            VkeDescriptorAllocator &descriptorAllocator);
         ~ShadowMapSystem();
 
         ShadowMapSystem(const ShadowMapSystem &) = delete;
         ShadowMapSystem &operator=(const ShadowMapSystem &) = delete;
 
-        void renderShadowMaps(FrameInfo &frameInfo, glm::mat4 &lightViewProj);
+        // casters are the dynamic renderable indices already culled against the light's view volume, static
+        // casters are drawn by replaying the bundles of the visibleChunks of staticChunks
+        void renderShadowMaps(
+            FrameInfo &frameInfo,
+            glm::mat4 &lightViewProj,
+            const std::vector<uint32_t> &casters,
+            const VkeStaticChunks &staticChunks,
+            const std::vector<uint32_t> &visibleChunks);
+        // converts the depth map into blurred EVSM moments, call after the shadow render pass ended
+        void renderMoments(FrameInfo &frameInfo);
         static glm::mat4 getLightViewProjection(const glm::vec3 &dirLightPos, const glm::vec3 &cameraPosition, float sceneRadius, VkeCamera &camera);
 
+        VkDescriptorImageInfo getMomentsDescriptor() const;
+        glm::vec2 getEvsmExponents() const { return evsmExponents; }
+
     private:
         void createPipelineLayout(VkDescriptorSetLayout &setLayout);
         void createPipeline(VkRenderPass renderPass);
+        void recordShadowCasters(FrameInfo &frameInfo, VkCommandBuffer commandBuffer, const std::vector<uint32_t> &casters, uint32_t begin, uint32_t end);
+        void createMomentsResources();
+        void createMomentsRenderPass();
+        void createMomentsPipeline(VkImageView shadowDepthImageView, VkeDescriptorAllocator &descriptorAllocator);
         VkImageView createShadowMapImageView(VkeDevice &device, int shadowMapExtent);
         void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageAspectFlags aspectMask);
         VkeDevice &vkeDevice;
         std::unique_ptr<VkePipeline> vkePipeline;
         VkPipelineLayout pipelineLayout;
+        // one per static chunk, kept when there are fewer chunks since a frame in flight may replay them
+        std::vector<std::unique_ptr<VkeStaticBundle>> chunkBundles;
+        // casters are drawn from the models' position streams when the device supports them
+        bool usePositionStreams = false;
 
         // Shadow map specific resources
         VkRenderPass shadowRenderPass; // Render pass for shadow map rendering
         VkExtent2D shadowMapExtent;    // Resolution of the shadow map
+
+        // EVSM moments target
+        VkExtent2D momentsExtent{SHADOWMAP_MOMENTS_DIM, SHADOWMAP_MOMENTS_DIM};
+        VkFormat momentsFormat;
+        glm::vec2 evsmExponents{5.f};
+        VkImage momentsImage;
+        VkDeviceMemory momentsImageMemory;
+        VkImageView momentsImageView;
+        VkSampler momentsSampler;
+        VkSampler depthSampler;
+        VkRenderPass momentsRenderPass;
+        VkFramebuffer momentsFramebuffer;
+        std::unique_ptr<VkeDescriptorSetLayout> momentsSetLayout;
+        VkDescriptorSet momentsDescriptorSet;
+        VkPipelineLayout momentsPipelineLayout;
+        std::unique_ptr<VkePipeline> momentsPipeline;
+
+        // LOD picked this frame, indexed by renderable
+        std::vector<uint8_t> selectedLods;
+        std::vector<VkCommandBuffer> secondaryCommandBuffers;
+        // per recording thread
+        std::vector<VkResult> recordResults;
     };
 } // namespace vke
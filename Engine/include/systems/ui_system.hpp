@@ -4,6 +4,7 @@
 #include "device.hpp"
 #include "descriptors.hpp"
 #include "renderer.hpp"
+#include "render_stats.hpp"
 
 namespace vke
 {
@@ -11,7 +12,7 @@ namespace vke
     class UISystem
     {
     public:
-        UISystem(VkeWindow &vkeWindow, VkeDevice &vkeDevice, VkeDescriptorPool &globalPool, VkeRenderer &vkeRenderer);
+        UISystem(VkeWindow &vkeWindow, VkeDevice &vkeDevice, VkeDescriptorPool &descriptorPool, VkeRenderer &vkeRenderer);
         ~UISystem();
 
         UISystem(const UISystem &) = delete;
@@ -19,5 +20,9 @@ namespace vke
 
         void CustomizeImGuiColors();
         void CustomizeImGuiStyle();
+
+        // Frame time summary and the last frame's render counters, each with a rolling graph. Call
+        // between ImGui::NewFrame and ImGui::Render.
+        static void renderStatsOverlay(const VkeStatsHistory &stats);
     };
 } // namespace vke
\ No newline at end of file
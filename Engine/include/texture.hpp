@@ -31,9 +31,7 @@ namespace vke
     private:
         void loadTexture(const std::string &filename);
         void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
-        void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
         void createTextureImage(const std::string &filename);
-        void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
         void createImageInfo();
         VkImageView createImageView(VkImage image, VkFormat format, VkeDevice &device);
 
@@ -9,6 +9,8 @@ namespace vke
     {
     public:
         TextureSampler(VkeDevice &device, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+        // comparison sampler for sampler2DShadow lookups, every tap gets hardware bilinear PCF
+        TextureSampler(VkeDevice &device, VkSamplerAddressMode addressMode, VkCompareOp compareOp);
 
         // Not copyable or movable
         TextureSampler(TextureSampler &&) = delete;
@@ -19,7 +21,7 @@ namespace vke
         VkSampler getSampler() { return textureSampler; }
 
     private:
-        void createTextureSampler(VkSamplerAddressMode addressMode);
+        void createTextureSampler(VkSamplerAddressMode addressMode, VkBool32 compareEnable = VK_FALSE, VkCompareOp compareOp = VK_COMPARE_OP_NEVER);
         VkeDevice &vkeDevice;
         VkSampler textureSampler;
     };
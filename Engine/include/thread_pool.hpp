@@ -0,0 +1,49 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vke
+{
+    class VkeThreadPool
+    {
+    public:
+        // called once per worker with the half open range [begin, end) it owns
+        using RangeJob = std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)>;
+
+        explicit VkeThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+        ~VkeThreadPool();
+
+        // Not copyable or movable
+        VkeThreadPool(const VkeThreadPool &) = delete;
+        VkeThreadPool &operator=(const VkeThreadPool &) = delete;
+        VkeThreadPool(VkeThreadPool &&) = delete;
+        VkeThreadPool &operator=(VkeThreadPool &&) = delete;
+
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+        // Splits [0, count) into at most one contiguous range per worker and blocks until every range
+        // is done. Ranges are never smaller than minRangeSize. Not reentrant: jobs must not call parallelFor.
+        void parallelFor(uint32_t count, const RangeJob &job, uint32_t minRangeSize = 1);
+
+    private:
+        void workerLoop(uint32_t threadIndex);
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeWorkers;
+        std::condition_variable jobDone;
+
+        const RangeJob *currentJob = nullptr;
+        uint32_t jobCount = 0;
+        uint32_t rangeSize = 0;
+        uint32_t pendingWorkers = 0;
+        uint64_t generation = 0;
+        bool stopping = false;
+    };
+} // namespace vke
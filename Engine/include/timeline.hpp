@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vke
+{
+    class VkeDevice;
+
+    // A timeline semaphore counting the submissions that signal it. Each submission signals the next
+    // value, so work on any queue is waited for, and retired, by comparing values. The submissions
+    // signaling one timeline must all go to the same queue, or values could be reached out of order.
+    class VkeTimeline
+    {
+    public:
+        VkeTimeline(VkeDevice &device);
+        ~VkeTimeline();
+
+        VkeTimeline(const VkeTimeline &) = delete;
+        VkeTimeline &operator=(const VkeTimeline &) = delete;
+
+        VkSemaphore getSemaphore() const { return semaphore; }
+        // reserves the value the next submission signals
+        uint64_t next() { return ++submittedValue; }
+        // reached once everything submitted so far finished
+        uint64_t getSubmittedValue() const { return submittedValue; }
+        uint64_t getCompletedValue();
+        bool isCompleted(uint64_t value) { return value <= completedValue || value <= getCompletedValue(); }
+        void wait(uint64_t value);
+
+    private:
+        VkeDevice &vkeDevice;
+        VkSemaphore semaphore;
+        uint64_t submittedValue = 0;
+        // cached, the counter only moves forward
+        uint64_t completedValue = 0;
+    };
+
+    // The semaphores of one vkQueueSubmit, binary and timeline alike. Binary semaphores take the value
+    // 0, which the implementation ignores.
+    class VkeSubmitSemaphores
+    {
+    public:
+        void wait(VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value = 0);
+        void signal(VkSemaphore semaphore, uint64_t value = 0);
+        // Points submitInfo at the semaphores, chaining the timeline values when there are any. Neither
+        // may change before the submission.
+        void apply(VkSubmitInfo &submitInfo);
+        void clear();
+
+    private:
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues;
+        std::vector<VkSemaphore> signalSemaphores;
+        std::vector<uint64_t> signalValues;
+        bool hasTimelineValues = false;
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    };
+} // namespace vke
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "settings.hpp"
+
+// std
+#include <cstdint>
+#include <string>
+
+namespace vke
+{
+    // CPU trace of named scopes. Every thread records the scopes it finishes into a ring buffer of its
+    // own without taking locks, so each ring always holds that thread's last TRACE_RING_CAPACITY scopes.
+    class VkeTrace
+    {
+    public:
+        // nanoseconds on a monotonic clock
+        static uint64_t now();
+        // name must stay valid for the whole run, a string literal
+        static void record(const char *name, uint64_t beginNs, uint64_t endNs);
+        // shown for the calling thread in exported traces
+        static void setThreadName(const std::string &name);
+
+        // Writes the scopes of every thread that ended in the last seconds as Chrome trace event JSON,
+        // for chrome://tracing or Perfetto. Other threads keep recording meanwhile, scopes they overwrite
+        // during the copy are left out. Returns false if the file can't be written.
+        static bool writeChromeTrace(const std::string &path, double seconds);
+    };
+
+    class VkeTraceScope
+    {
+    public:
+        explicit VkeTraceScope(const char *name) : name{name}, beginNs{VkeTrace::now()} {}
+        ~VkeTraceScope() { VkeTrace::record(name, beginNs, VkeTrace::now()); }
+
+        VkeTraceScope(const VkeTraceScope &) = delete;
+        VkeTraceScope &operator=(const VkeTraceScope &) = delete;
+
+    private:
+        const char *name;
+        uint64_t beginNs;
+    };
+
+    // Records a "Frame" scope per frame and writes the trace of the last few seconds whenever a frame
+    // goes over budget, to catch hitches that can't be reproduced on demand.
+    class VkeFlightRecorder
+    {
+    public:
+        VkeFlightRecorder(double budgetMilliseconds = TRACE_HITCH_BUDGET_MS, double seconds = TRACE_FLIGHT_RECORDER_SECONDS);
+
+        VkeFlightRecorder(const VkeFlightRecorder &) = delete;
+        VkeFlightRecorder &operator=(const VkeFlightRecorder &) = delete;
+
+        // Call once at the end of every frame. Returns true when the frame went over budget and a trace
+        // was written. Dumps are at least the recorded seconds apart so they never overlap, and the
+        // time spent writing one doesn't count against the next frame.
+        bool endFrame();
+
+        void setEnabled(bool enable) { enabled = enable; }
+        bool isEnabled() const { return enabled; }
+        void setBudget(double milliseconds) { budgetMilliseconds = milliseconds; }
+        double getBudget() const { return budgetMilliseconds; }
+        uint32_t getDumpCount() const { return dumpCount; }
+        const std::string &getLastDumpPath() const { return lastDumpPath; }
+
+    private:
+        double budgetMilliseconds;
+        double seconds;
+        bool enabled = true;
+        uint64_t frameBeginNs = 0;
+        uint64_t lastDumpNs = 0;
+        uint64_t frameCount = 0;
+        uint32_t dumpCount = 0;
+        std::string lastDumpPath;
+    };
+} // namespace vke
+
+#if TRACE_ENABLED
+#define VKE_TRACE_CONCAT_INNER(a, b) a##b
+#define VKE_TRACE_CONCAT(a, b) VKE_TRACE_CONCAT_INNER(a, b)
+// times the rest of the enclosing block
+#define VKE_TRACE_SCOPE(name) ::vke::VkeTraceScope VKE_TRACE_CONCAT(vkeTraceScope, __LINE__) { name }
+#else
+#define VKE_TRACE_SCOPE(name) ((void)0)
+#endif
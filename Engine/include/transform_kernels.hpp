@@ -0,0 +1,37 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+
+namespace vke
+{
+    // Batch version of TransformComponent::mat4() and normalMatrix() over the per field arrays of a
+    // TransformStore. For every i < count it reads slot indices[i] of the inputs and writes the same
+    // slot of the outputs, so disjoint index ranges can run on different threads.
+    // Uses AVX2 when the compiler targets it (-mavx2 -mfma), otherwise SSE2 on x86 and NEON on
+    // AArch64, with a scalar path for anything else and for the tail of each batch.
+    void computeTransformMatrices(
+        const glm::vec3 *translations,
+        const glm::vec3 *rotations,
+        const glm::vec3 *scales,
+        const uint32_t *indices,
+        uint32_t count,
+        glm::mat4 *worldMatrices,
+        glm::mat4 *normalMatrices);
+
+    // same math one transform at a time, kept callable to compare against the vector path
+    void computeTransformMatricesScalar(
+        const glm::vec3 *translations,
+        const glm::vec3 *rotations,
+        const glm::vec3 *scales,
+        const uint32_t *indices,
+        uint32_t count,
+        glm::mat4 *worldMatrices,
+        glm::mat4 *normalMatrices);
+
+    // "avx2", "sse2", "neon" or "scalar"
+    const char *getTransformKernelName();
+} // namespace vke
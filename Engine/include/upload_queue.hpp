@@ -0,0 +1,106 @@
+#pragma once
+
+#include "timeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace vke
+{
+    class VkeBuffer;
+    class VkeDevice;
+
+    // Streams data into device local buffers and images without waiting for the copies. Every upload is
+    // copied right away into large, persistently mapped staging blocks the pending batch packs its uploads
+    // into, and recorded into the batch, flush() submits the batch to the transfer queue. On devices with a dedicated transfer family the transfer queue
+    // releases each resource and a small graphics submission, waiting on the transfer, acquires it, so
+    // whatever the graphics queue runs after flush() sees the data. Otherwise the batch runs on the
+    // graphics queue itself. Every transfer submission signals the next value of the upload timeline,
+    // and a batch's staging blocks are reused by later batches once a flush finds its values reached. Concurrent buffers
+    // need no ownership transfer, which lets other queues read them too, see waitForFlushed().
+    // Loader threads may upload too, flush() and waitIdle() submit to the graphics queue and belong to
+    // the thread rendering.
+    class VkeUploadQueue
+    {
+    public:
+        VkeUploadQueue(VkeDevice &device);
+        ~VkeUploadQueue();
+
+        VkeUploadQueue(const VkeUploadQueue &) = delete;
+        VkeUploadQueue &operator=(const VkeUploadQueue &) = delete;
+
+        // the destination must stay alive until the batch finished, and not be read before the next flush
+        void uploadBuffer(VkeBuffer &buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+        // Fills the first mip level of a single layer color image in VK_IMAGE_LAYOUT_UNDEFINED with tightly
+        // packed texels, leaving it in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+        void uploadImage(VkImage image, uint32_t width, uint32_t height, const void *texels, VkDeviceSize size);
+
+        // submits the pending uploads, the renderer calls it before submitting every frame
+        void flush();
+        // flushes and blocks until every upload finished
+        void waitIdle();
+        // Makes a submission to a queue other than the graphics queue wait for the uploads flushed so far,
+        // the graphics queue is ordered after them already.
+        void waitForFlushed(VkeSubmitSemaphores &semaphores, VkPipelineStageFlags stage);
+
+        uint32_t getBatchesInFlight();
+
+    private:
+        // persistently mapped, uploads are packed into it until the next one does not fit
+        struct StagingBlock
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mapped = nullptr;
+            VkDeviceSize size = 0;
+            VkDeviceSize used = 0;
+        };
+
+        struct Batch
+        {
+            VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+            // only with a dedicated transfer family
+            VkCommandBuffer acquireCommands = VK_NULL_HANDLE;
+            // on the upload timeline
+            uint64_t transferValue = 0;
+            // on the device's graphics timeline, 0 without acquires
+            uint64_t acquireValue = 0;
+            // the last one is being filled
+            std::vector<StagingBlock> stagingBlocks;
+        };
+
+        // the pending batch's transfer command buffer, begun on first use
+        VkCommandBuffer getPendingCommands();
+        // copies the data into the pending batch's staging memory, returning the buffer and the offset holding it
+        VkBuffer stage(const void *data, VkDeviceSize size, VkDeviceSize &offset);
+        StagingBlock createStagingBlock(VkDeviceSize size);
+        void destroyStagingBlock(StagingBlock &block);
+        void flushLocked();
+        // frees the finished batches, waiting for all of them when wait is set
+        void retire(bool wait);
+        bool isFinished(Batch &batch);
+
+        VkeDevice &vkeDevice;
+        bool dedicatedTransfer;
+        uint32_t transferFamily;
+        uint32_t graphicsFamily;
+        // acquire command buffers are recorded for the graphics family
+        VkCommandPool acquireCommandPool;
+        // signaled by the transfer queue
+        VkeTimeline timeline;
+
+        std::mutex mutex;
+        Batch pending{};
+        bool pendingBufferWrites = false;
+        std::vector<VkBufferMemoryBarrier> bufferAcquires;
+        std::vector<VkImageMemoryBarrier> imageAcquires;
+        // oldest first
+        std::deque<Batch> submitted;
+        // blocks of retired batches, reused before allocating new ones, at most a few are kept
+        std::vector<StagingBlock> freeStagingBlocks;
+    };
+} // namespace vke
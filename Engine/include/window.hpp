@@ -10,7 +10,8 @@ namespace vke
     {
 
     public:
-        VkeWindow(int w, int h, std::string name);
+        // hidden windows still get a surface and swap chain, for benchmark runs without a display to look at
+        VkeWindow(int w, int h, std::string name, bool visible = true);
         ~VkeWindow();
 
         VkeWindow(const VkeWindow &) = delete;
@@ -31,6 +32,7 @@ namespace vke
 
         int width;
         int height;
+        bool visible;
         bool frameBufferResized = false;
 
         std::string windowName;
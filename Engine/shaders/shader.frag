@@ -6,7 +6,8 @@ layout(location = 2) in vec3 fragNormalWorld;
 layout(location = 3) in vec2 fragUv;
 layout(location = 4) in vec4 lightSpacePos;
 
-layout(set = 0, binding = 1) uniform sampler2D shadowMap; 
+layout(set = 0, binding = 1) uniform sampler2DShadow shadowMap;
+layout(set = 0, binding = 2) uniform sampler2D shadowMoments;
 
 layout(set = 1, binding = 1) uniform sampler2D albedoTexture;
 layout(set = 1, binding = 2) uniform sampler2D normalTexture;
@@ -37,6 +38,8 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     PointLight pointLights[10];
     DirectionalLight dirLight;
     int numLights;
+    int shadowFilter; // 0 - PCF 4 tap, 1 - Poisson 16 tap, 2 - EVSM
+    vec2 evsmExponents;
 } ubo;
 
 layout(push_constant) uniform Push {
@@ -88,37 +91,98 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0) {
     return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
-// pseudo random number generator
-float rand(vec2 co) {
-    return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+const vec2 POISSON_DISK[16] = vec2[](
+    vec2(-0.94201624, -0.39906216),
+    vec2(0.94558609, -0.76890725),
+    vec2(-0.09418410, -0.92938870),
+    vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432),
+    vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543, 0.27676845),
+    vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554),
+    vec2(0.53742981, -0.47373420),
+    vec2(-0.26496911, -0.41893023),
+    vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507),
+    vec2(-0.81409955, 0.91437590),
+    vec2(0.19984126, 0.78641367),
+    vec2(0.14383161, -0.14100790)
+);
+
+// interleaved gradient noise, stable per pixel and much cheaper than a sin hash
+float interleavedGradientNoise(vec2 pixel) {
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+// every tap is a hardware compare + bilinear PCF of 2x2 texels, so 4 taps cover a 3x3 footprint
+float shadowPCF4(vec2 uv, float depth, vec2 texelSize) {
+    float lit = 0.0;
+    lit += texture(shadowMap, vec3(uv + vec2(-0.5, -0.5) * texelSize, depth));
+    lit += texture(shadowMap, vec3(uv + vec2(0.5, -0.5) * texelSize, depth));
+    lit += texture(shadowMap, vec3(uv + vec2(-0.5, 0.5) * texelSize, depth));
+    lit += texture(shadowMap, vec3(uv + vec2(0.5, 0.5) * texelSize, depth));
+    return lit * 0.25;
+}
+
+float shadowPoisson16(vec2 uv, float depth, vec2 texelSize) {
+    float angle = 2.0 * PI * interleavedGradientNoise(gl_FragCoord.xy);
+    float s = sin(angle);
+    float c = cos(angle);
+    mat2 rotation = mat2(c, s, -s, c);
+    vec2 radius = 2.0 * texelSize;
+
+    float lit = 0.0;
+    for (int i = 0; i < 16; ++i)
+    {
+        lit += texture(shadowMap, vec3(uv + rotation * POISSON_DISK[i] * radius, depth));
+    }
+    return lit / 16.0;
+}
+
+float chebyshevUpperBound(vec2 moments, float mean, float minVariance) {
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    return mean <= moments.x ? 1.0 : pMax;
+}
+
+float shadowEVSM(vec2 uv, float depth) {
+    vec4 moments = texture(shadowMoments, uv);
+    float warped = depth * 2.0 - 1.0;
+    float pos = exp(ubo.evsmExponents.x * warped);
+    float neg = -exp(-ubo.evsmExponents.y * warped);
+
+    vec2 depthScale = 0.0001 * ubo.evsmExponents * vec2(pos, -neg);
+    vec2 minVariance = depthScale * depthScale;
+    float lit = min(
+        chebyshevUpperBound(moments.xy, pos, minVariance.x),
+        chebyshevUpperBound(moments.zw, neg, minVariance.y));
+
+    // light bleeding reduction
+    return clamp((lit - 0.2) / 0.8, 0.0, 1.0);
 }
 
-// PCF
 float shadowCalculation(vec3 normal, vec3 lightDir) {
     vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w;
     vec2 uv = projCoords.xy * 0.5 + 0.5;
-    float currentDepth = projCoords.z ;
-    float depth = texture(shadowMap, uv).x; 
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || projCoords.z > 1.0) {
+        return 1.0;
+    }
 
     float bias = max(0.0002 * (1.0 - dot(normal, lightDir)), 0.00001);
-
-    float shadow = 0.0;
-
-    int kernelSize = 2;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    for(int x = -kernelSize; x <= kernelSize; ++x)
-    {
-        for(int y = -kernelSize; y <= kernelSize; ++y)
-        {
-            vec2 randomOffset = vec2(rand(uv + vec2(x, y)), rand(uv - vec2(x, y))) * texelSize;
-
-            float pcfDepth = texture(shadowMap, uv + vec2(x, y) * texelSize + randomOffset).r; 
-            shadow += (currentDepth - bias) < pcfDepth ? 1.0 : 0.1;        
-        }    
+    float currentDepth = projCoords.z - bias;
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+
+    float lit;
+    if (ubo.shadowFilter == 2) {
+        lit = shadowEVSM(uv, currentDepth);
+    } else if (ubo.shadowFilter == 1) {
+        lit = shadowPoisson16(uv, currentDepth, texelSize);
+    } else {
+        lit = shadowPCF4(uv, currentDepth, texelSize);
     }
-    shadow /= (kernelSize * 2 + 1) * (kernelSize * 2 + 1);
-    
-    return shadow;
+    return mix(0.1, 1.0, lit);
 }
 
 void main() {
@@ -2,7 +2,7 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
+layout(location = 2) in vec2 normal; // octahedral
 layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor; 
@@ -32,17 +32,24 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 } ubo;
 
 layout(push_constant) uniform Push {
-    mat4 modelMatrix;
+    mat4 modelMatrix; // includes the model's position decode, positions may be quantized to its bounds
     mat4 normalMatrix;
     int hasNormalMap;
 } push;
 
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // unfold the lower hemisphere
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
 
 void main() {
     vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
     gl_Position = ubo.projection * ubo.view * positionWorld; 
 
-    fragNormalWorld = normalize(mat3(push.modelMatrix) * normal);
+    fragNormalWorld = normalize(mat3(push.normalMatrix) * octahedralDecode(normal));
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
     fragUv = uv;
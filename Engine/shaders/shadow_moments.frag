@@ -0,0 +1,31 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outMoments;
+
+layout(set = 0, binding = 0) uniform sampler2D shadowDepth;
+
+layout(push_constant) uniform Push {
+    vec2 exponents; // positive / negative warp
+    int downsample; // depth texels per moments texel along each axis
+} push;
+
+// Exponential variance shadow map: every output texel is the box filtered average of the
+// warped moments of the downsample x downsample depth texels it covers, so the main pass
+// only needs a single bilinear fetch.
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * push.downsample;
+    vec4 moments = vec4(0.0);
+    for (int y = 0; y < push.downsample; ++y)
+    {
+        for (int x = 0; x < push.downsample; ++x)
+        {
+            float depth = texelFetch(shadowDepth, base + ivec2(x, y), 0).r * 2.0 - 1.0;
+            float pos = exp(push.exponents.x * depth);
+            float neg = -exp(-push.exponents.y * depth);
+            moments += vec4(pos, pos * pos, neg, neg * neg);
+        }
+    }
+    outMoments = moments / float(push.downsample * push.downsample);
+}
@@ -3,13 +3,16 @@
 #include "keyboard_movement_controller.hpp"
 #include "camera.hpp"
 #include "systems/render_system.hpp"
+#include "systems/meshlet_cull_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/shadowmap_system.hpp"
 #include "systems/ui_system.hpp"
 #include "buffer.hpp"
+#include "bounds.hpp"
 #include "object_manager.hpp"
 #include "light_object.hpp"
 #include "texture_sampler.hpp"
+#include "upload_queue.hpp"
 
 // ImGui
 #include "imgui/imgui.h"
@@ -23,87 +26,195 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <random>
 #include <stdexcept>
+#include <unordered_map>
 #include <iostream>
 
 namespace vke
 {
 
-    App::App()
+    namespace
     {
-        loadGameObjects();
-        loadLights();
-        // global pool must be created first
-        globalPool = VkeDescriptorPool::Builder(vkeDevice)
-                         .setMaxSets(MAX_FRAMES_IN_FLIGHT * gameObjects.size() * 2 * 2)
-                         .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT * gameObjects.size() * 2 * 2)         // Increase if needed
-                         .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT * gameObjects.size() * 2 * 2) // Increase if needed
-                         .build();
-        createUBOBuffers();
+        double millisecondsSince(uint64_t beginNs)
+        {
+            return static_cast<double>(VkeTrace::now() - beginNs) * 1e-6;
+        }
+    } // namespace
+
+    App::App(const VkeBenchConfig &config) : benchConfig{config}
+    {
+        uint64_t loadBeginNs = VkeTrace::now();
+        uint64_t stageBeginNs = loadBeginNs;
+        if (benchConfig.instances > 0)
+        {
+            loadStressScene();
+        }
+        else
+        {
+            loadGameObjects();
+            loadLights();
+        }
+        benchReport.addLoadTime("scene", millisecondsSince(stageBeginNs));
+        stageBeginNs = VkeTrace::now();
+        uiPool = VkeDescriptorPool::Builder(vkeDevice)
+                     .setMaxSets(16)
+                     .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
+                     .build();
+        for (auto &transient : transientDescriptors)
+        {
+            transient = std::make_unique<VkeDescriptorAllocator>(
+                vkeDevice,
+                std::vector<VkDescriptorPoolSize>{{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+                                                  {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+                                                  {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4}});
+        }
         createDescriptors();
+        benchReport.addLoadTime("descriptors", millisecondsSince(stageBeginNs));
+        stageBeginNs = VkeTrace::now();
+        // after the descriptors, batches reuse the material descriptor sets of the objects they replace
+        staticBatcher.build(scene);
+        benchReport.addLoadTime("static_batching", millisecondsSince(stageBeginNs));
+        benchReport.addLoadTime("total", millisecondsSince(loadBeginNs));
     }
     App::~App()
     {
     }
     void App::run()
     {
+        VkeTrace::setThreadName("Main");
         glfwSetInputMode(vkeWindow.getGLWFWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
         std::vector<VkDescriptorSetLayout> setLayouts = {
             globalSetLayout->getDescriptorSetLayout(),
             materialSetLayout->getDescriptorSetLayout()};
 
-        UISystem uiSystem{vkeWindow, vkeDevice, *globalPool, vkeRenderer};
+        UISystem uiSystem{vkeWindow, vkeDevice, *uiPool, vkeRenderer};
         RenderSystem renderSystem{vkeDevice, vkeRenderer.getSwapChainRenderPass(), setLayouts};
+        MeshletCullSystem meshletCullSystem{vkeDevice, frameRing};
         PointLightSystem pointLightSystem{vkeDevice, vkeRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
-        ShadowMapSystem shadowMapSystem{vkeDevice, vkeRenderer.getShadowMapRenderPass(), shadowSetLayout->getDescriptorSetLayout(), {SHADOWMAP_DIM, SHADOWMAP_DIM}};
+        ShadowMapSystem shadowMapSystem{vkeDevice, vkeRenderer.getShadowMapRenderPass(), shadowSetLayout->getDescriptorSetLayout(), {SHADOWMAP_DIM, SHADOWMAP_DIM}, vkeRenderer.getShadowMapDepthImageView(), descriptorAllocator};
+
+        // EVSM moments are owned by the shadow map system, so they can only be bound once it exists
+        auto momentsInfo = shadowMapSystem.getMomentsDescriptor();
+        VkeDescriptorWriter(*globalSetLayout, descriptorAllocator)
+            .writeImage(2, &momentsInfo)
+            .overwrite(globalDescriptorSet);
 
         VkeCamera camera{};
-        auto viewerObject = VkeGameObject::createGameObject();
-        viewerObject.transform.translation.z = -2.5f;
+        TransformComponent viewerTransform{};
+        viewerTransform.translation.z = -2.5f;
         KeyboardMovementController cameraController{};
 
         auto currentTime = std::chrono::high_resolution_clock::now();
 
         // setup before render
 
-        auto sun = VkeGameObject::makePointLight(0.3f);
-        sun.color = glm::vec3(1, 1, 0.5);
-        sun.transform.translation = glm::vec3(1.f, 2.f, 2.f);
-        gameObjects.emplace(sun.getId(), std::move(sun));
+        auto sunPosition = glm::vec3(1.f, 2.f, 2.f);
+        auto sunColor = glm::vec3(1, 1, 0.5);
+        // the sun also adds a point light, which the point light system keeps at the camera
+        scene.createPointLight(0.3f, 0.1f, sunColor);
         auto cameraOffset = glm::vec3(-10.f, 10.f, -2.f);
+        int shadowFilter = VKE_SHADOW_FILTER_POISSON_16;
+        bool batchStatic = true;
+        bool rebatch = false;
+        // dynamic renderable indices drawn by the camera and the light pass, and the static chunks they
+        // replay, both surviving culling
+        std::vector<uint32_t> visibleObjects[2];
+        std::vector<uint32_t> visibleChunks[2];
+        // the main pass's dynamic objects plus those of its static chunks, what the meshlet cull sees
+        std::vector<uint32_t> cullObjects;
+
+        // benchmark runs replay a camera path at a fixed simulation step instead of reading input
+        VkeCameraPath benchCameraPath{};
+        uint32_t benchFrame = 0;
+        if (benchConfig.enabled)
+        {
+            if (!benchConfig.cameraPath.empty())
+            {
+                benchCameraPath.load(benchConfig.cameraPath);
+            }
+            else
+            {
+                float duration = static_cast<float>(benchConfig.warmupFrames + benchConfig.frames) * BENCH_TIMESTEP;
+                benchCameraPath = VkeCameraPath::orbit({0.f, 0.f, 0.f}, sceneRadius, -4.f, duration);
+            }
+            benchGpuFramesRead = vkeRenderer.getGpuProfiler().getCollectedFrameCount();
+        }
 
         while (!vkeWindow.shouldClose())
         {
-            glfwPollEvents();
+            uint64_t frameBeginNs = VkeTrace::now();
+            bool frameRendered = false;
+            {
+                VKE_TRACE_SCOPE("Poll events");
+                glfwPollEvents();
+            }
+
+            // between frames, the batcher defers freeing the models frames in flight still draw
+            if (rebatch)
+            {
+                if (batchStatic)
+                {
+                    staticBatcher.build(scene);
+                }
+                else
+                {
+                    staticBatcher.clear(scene);
+                }
+                rebatch = false;
+            }
 
             auto newTime = std::chrono::high_resolution_clock::now();
             auto frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
 
-            frameTime = glm::min(frameTime, MAX_FRAME_TIME);
-
-            cameraController.moveInPlainXZ(vkeWindow.getGLWFWindow(), frameTime, viewerObject);
-            cameraController.updateShortcuts(vkeWindow.getGLWFWindow());
-            camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+            if (benchConfig.enabled)
+            {
+                // every run simulates the same frames however long they take, nothing is clamped
+                frameTime = BENCH_TIMESTEP;
+                benchCameraPath.sample(static_cast<float>(benchFrame) * BENCH_TIMESTEP, viewerTransform);
+            }
+            else
+            {
+                frameTime = glm::min(frameTime, MAX_FRAME_TIME);
+
+                cameraController.moveInPlainXZ(vkeWindow.getGLWFWindow(), frameTime, viewerTransform);
+                cameraController.updateShortcuts(vkeWindow.getGLWFWindow());
+                if (recordingCameraPath)
+                {
+                    cameraPathTime += frameTime;
+                    recordedCameraPath.addKey({cameraPathTime, viewerTransform.translation, viewerTransform.rotation});
+                }
+            }
+            camera.setViewYXZ(viewerTransform.translation, viewerTransform.rotation);
 
             float aspect = vkeRenderer.getAspectRatio();
             camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 50.f);
 
             if (auto commandBuffer = vkeRenderer.beginFrame())
             {
+                frameRendered = true;
                 int frameIndex = vkeRenderer.getFrameIndex();
+                frameRing.beginFrame(frameIndex);
+                transientDescriptors[frameIndex]->reset();
                 float currentTimeInSeconds = std::chrono::duration<float, std::chrono::seconds::period>(currentTime.time_since_epoch()).count();
                 FrameInfo frameInfo{frameIndex,
                                     frameTime,
                                     currentTimeInSeconds,
                                     commandBuffer,
                                     camera,
-                                    globalDescriptorSets[frameIndex],
-                                    shadowDescriptorSets[frameIndex],
-                                    gameObjects};
+                                    globalDescriptorSet,
+                                    shadowDescriptorSet,
+                                    scene,
+                                    vkeRenderer,
+                                    threadPool,
+                                    frameRing,
+                                    *transientDescriptors[frameIndex]};
 
                 // update
                 GlobalUbo ubo{};
@@ -112,60 +223,206 @@ namespace vke
                 ubo.view = camera.getView();
                 ubo.inverseView = camera.getInverseView();
 
-                glm::mat4 lightViewProj = ShadowMapSystem::getLightViewProjection(sun.transform.translation, frameInfo.camera.getPosition() + cameraOffset, 10.f, camera);
+                glm::mat4 lightViewProj = ShadowMapSystem::getLightViewProjection(sunPosition, frameInfo.camera.getPosition() + cameraOffset, 10.f, camera);
                 ubo.dirLight.lightViewProj = lightViewProj;
-                ubo.dirLight.color = sun.color;
-                ubo.dirLight.direction = sun.transform.translation;
+                ubo.dirLight.color = sunColor;
+                ubo.dirLight.direction = sunPosition;
+                ubo.shadowFilter = shadowFilter;
+                ubo.evsmExponents = shadowMapSystem.getEvsmExponents();
                 shadowUbo.lightViewProj = lightViewProj;
 
                 pointLightSystem.update(frameInfo, ubo);
-
-                shadowUboBuffers[frameIndex]->writeToBuffer(&shadowUbo);
-                shadowUboBuffers[frameIndex]->flush();
-
-                uboBuffers[frameIndex]->writeToBuffer(&ubo);
-                uboBuffers[frameIndex]->flush();
-
-                vkeRenderer.beginShadowSwapChainRenderPass(commandBuffer);
-                shadowMapSystem.renderShadowMaps(frameInfo, lightViewProj);
+                {
+                    VKE_TRACE_SCOPE("Update transforms");
+                    // after every transform write of the frame, both passes read the cached matrices
+                    scene.transforms.updateMatrices(&threadPool);
+                }
+                {
+                    VKE_TRACE_SCOPE("Update BVH");
+                    sceneBvh.update(scene);
+                    staticChunks.update(scene);
+                }
+
+                {
+                    VKE_TRACE_SCOPE("Frustum cull");
+                    // both passes are culled in one traversal
+                    VkeFrustum frustums[] = {
+                        VkeFrustum::fromViewProjection(camera.getProjection() * camera.getView()),
+                        VkeFrustum::fromViewProjection(lightViewProj)};
+                    for (uint32_t pass = 0; pass < 2; pass++)
+                    {
+                        visibleObjects[pass].clear();
+                        visibleChunks[pass].clear();
+                    }
+                    sceneBvh.queryFrustums(frustums, 2, visibleObjects);
+                    // static objects are culled by chunk, so what a chunk's bundle holds doesn't depend on the view
+                    const auto &isStatic = scene.renderables.isStatic;
+                    for (auto &objects : visibleObjects)
+                    {
+                        objects.erase(
+                            std::remove_if(objects.begin(), objects.end(), [&](uint32_t i)
+                                           { return isStatic[i]; }),
+                            objects.end());
+                        // back in storage order for the systems' column reads
+                        std::sort(objects.begin(), objects.end());
+                    }
+                    staticChunks.queryFrustums(frustums, 2, visibleChunks);
+                    VKE_STAT_ADD(VKE_STAT_STATIC_CHUNKS_CULLED, staticChunks.getChunkCount() - visibleChunks[0].size());
+
+                    cullObjects = visibleObjects[0];
+                    for (uint32_t chunk : visibleChunks[0])
+                    {
+                        const auto &chunkObjects = staticChunks.getChunk(chunk).objects;
+                        cullObjects.insert(cullObjects.end(), chunkObjects.begin(), chunkObjects.end());
+                    }
+                    // everything the main pass doesn't draw, static objects outside the visible chunks included
+                    VKE_STAT_ADD(VKE_STAT_OBJECTS_CULLED, scene.renderables.size() - cullObjects.size());
+                }
+
+                // first allocations of the frame, so the offsets the static bundles were recorded with stay put
+                frameInfo.shadowUboOffset = frameRing.push(shadowUbo);
+                frameInfo.globalUboOffset = frameRing.push(ubo);
+
+                auto &gpuProfiler = vkeRenderer.getGpuProfiler();
+                vkeRenderer.beginShadowSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                shadowMapSystem.renderShadowMaps(frameInfo, lightViewProj, visibleObjects[1], staticChunks, visibleChunks[1]);
                 vkeRenderer.endSwapChainRenderPass(commandBuffer);
-
-                vkeRenderer.beginSwapChainRenderPass(commandBuffer);
-                renderSystem.renderGameObjects(frameInfo);
-                pointLightSystem.render(frameInfo);
-                renderImGuiFrame(commandBuffer, sun, cameraOffset);
+                if (shadowFilter == VKE_SHADOW_FILTER_EVSM)
+                {
+                    uint32_t momentsScope = gpuProfiler.beginScope(commandBuffer, "EVSM moments", true);
+                    shadowMapSystem.renderMoments(frameInfo);
+                    gpuProfiler.endScope(commandBuffer, momentsScope);
+                }
+                // the shadow passes don't read the cull's results, submitted without its wait they run
+                // while the cull does
+                commandBuffer = vkeRenderer.submitEarlyCommands();
+                frameInfo.commandBuffer = commandBuffer;
+
+                // compute work has to be recorded outside the render passes, on an async compute queue it
+                // overlaps the shadow passes and is missing from the graphics queue's profile
+                if (vkeDevice.hasAsyncComputeQueue())
+                {
+                    meshletCullSystem.cull(frameInfo, cullObjects);
+                }
+                else
+                {
+                    uint32_t cullScope = gpuProfiler.beginScope(commandBuffer, "Meshlet cull");
+                    meshletCullSystem.cull(frameInfo, cullObjects);
+                    gpuProfiler.endScope(commandBuffer, cullScope);
+                }
+
+                vkeRenderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                renderSystem.renderGameObjects(frameInfo, visibleObjects[0], staticChunks, visibleChunks[0], &meshletCullSystem);
+
+                // the pass only accepts secondaries, so the main thread records lights and UI into its own
+                FrameInfo overlayFrameInfo = frameInfo;
+                overlayFrameInfo.commandBuffer = vkeRenderer.beginSecondaryCommandBuffer(threadPool.getThreadCount());
+                uint32_t lightScope = gpuProfiler.beginScope(overlayFrameInfo.commandBuffer, "Point lights");
+                pointLightSystem.render(overlayFrameInfo);
+                gpuProfiler.endScope(overlayFrameInfo.commandBuffer, lightScope);
+                uint32_t uiScope = gpuProfiler.beginScope(overlayFrameInfo.commandBuffer, "ImGui");
+                {
+                    VKE_TRACE_SCOPE("Render ImGui");
+                    renderImGuiFrame(overlayFrameInfo.commandBuffer, sunPosition, sunColor, cameraOffset, shadowFilter, batchStatic, rebatch);
+                }
+                gpuProfiler.endScope(overlayFrameInfo.commandBuffer, uiScope);
+                if (vkEndCommandBuffer(overlayFrameInfo.commandBuffer) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to record overlay command buffer");
+                }
+                vkeRenderer.executeSecondaryCommandBuffers(commandBuffer, {overlayFrameInfo.commandBuffer});
                 vkeRenderer.endSwapChainRenderPass(commandBuffer);
                 vkeRenderer.endFrame();
             }
-            vkDeviceWaitIdle(vkeDevice.device());
+            renderStats.endFrame();
+            flightRecorder.endFrame();
+            // frames dropped for a swap chain recreation don't count
+            if (benchConfig.enabled && frameRendered && recordBenchFrame(benchFrame++, frameBeginNs))
+            {
+                break;
+            }
+        }
+        // nothing may still copy into resources the scene is about to free
+        vkeDevice.getUploadQueue().waitIdle();
+        // the systems going out of scope and the scene free what the last frames in flight still use
+        vkDeviceWaitIdle(vkeDevice.device());
+    }
+
+    bool App::recordBenchFrame(uint32_t frame, uint64_t frameBeginNs)
+    {
+        auto &gpuProfiler = vkeRenderer.getGpuProfiler();
+        if (frame >= benchConfig.warmupFrames)
+        {
+            // the CPU never runs more than MAX_FRAMES_IN_FLIGHT frames ahead, so a GPU bound run is paced by the GPU
+            benchReport.addCpuFrame(millisecondsSince(frameBeginNs));
+            // GPU times are read back MAX_FRAMES_IN_FLIGHT frames late, skip those still from the warm up
+            if (gpuProfiler.getCollectedFrameCount() != benchGpuFramesRead && frame >= benchConfig.warmupFrames + MAX_FRAMES_IN_FLIGHT)
+            {
+                benchReport.addGpuFrame(gpuProfiler.getFrameMilliseconds());
+            }
+        }
+        benchGpuFramesRead = gpuProfiler.getCollectedFrameCount();
+        if (frame + 1 < benchConfig.warmupFrames + benchConfig.frames)
+        {
+            return false;
         }
+        writeBenchReport();
+        return true;
+    }
+
+    void App::writeBenchReport()
+    {
+        benchReport.addInfo("device", vkeDevice.properties.deviceName);
+        benchReport.addInfo("camera_path", benchConfig.cameraPath.empty() ? "orbit" : benchConfig.cameraPath);
+        // GPU frame times exclude the meshlet cull when it runs on its own queue
+        benchReport.addInfo("async_compute", vkeDevice.hasAsyncComputeQueue() ? "yes" : "no");
+        benchReport.addCount("frames", benchConfig.frames);
+        benchReport.addCount("warmup_frames", benchConfig.warmupFrames);
+        benchReport.addCount("instances", benchConfig.instances);
+        benchReport.addCount("lights", benchConfig.lights);
+        benchReport.addCount("renderables", scene.renderables.size());
+        benchReport.addCount("static_batches", staticBatcher.getBatchCount());
+        benchReport.addMemory("peak_resident", VkeBenchReport::getPeakResidentBytes());
+        uint64_t vertexBytes = static_cast<uint64_t>(geometryArena.getUsedVertexCount()) * sizeof(VkeModel::PackedVertex);
+        if (geometryArena.hasPositionStream())
+        {
+            vertexBytes += static_cast<uint64_t>(geometryArena.getUsedVertexCount()) * sizeof(VkeModel::PositionVertex);
+        }
+        benchReport.addMemory("geometry_vertices", vertexBytes);
+        benchReport.addMemory("geometry_indices", static_cast<uint64_t>(geometryArena.getUsedIndexCount(VK_INDEX_TYPE_UINT16)) * sizeof(uint16_t) +
+                                                      static_cast<uint64_t>(geometryArena.getUsedIndexCount(VK_INDEX_TYPE_UINT32)) * sizeof(uint32_t));
+        if (!benchReport.write(benchConfig.output))
+        {
+            throw std::runtime_error("failed to write benchmark report: " + benchConfig.output);
+        }
+        std::cout << "Benchmark report written to: " << benchConfig.output << std::endl;
     }
 
     void App::loadGameObjects()
     {
 
-        auto skullObject = objectManager
-                               .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/skull.obj")
-                               .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/skull.jpg")
-                               .build({-10.f, 0.5f, -10.f}, {.04f, .04f, .04f});
-        gameObjects.emplace(skullObject.getId(), std::move(skullObject));
-
-        auto eyeObject = objectManager
-                             .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/eye.obj")
-                             .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/eye.jpg")
-                             .build({-1.f, -1.f, 0.f}, {.04f, .04f, .04f});
-        gameObjects.emplace(eyeObject.getId(), std::move(eyeObject));
-
-        auto gunObject = objectManager
-                             .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/Gun.obj")
-                             .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/Gun.jpg")
-                             .build({2.f, 0.5f, 0.f}, {1.5f, 1.5f, 1.5f});
-        gameObjects.emplace(gunObject.getId(), std::move(gunObject));
-
-        auto quad = objectManager
-                        .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/quad.obj")
-                        .build({1.f, 1.f, 1.f}, {1000.f, 1000.f, 1000.f});
-        gameObjects.emplace(quad.getId(), std::move(quad));
+        objectManager
+            .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/skull.obj")
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/skull.jpg")
+            .setStatic()
+            .build(scene, {-10.f, 0.5f, -10.f}, {.04f, .04f, .04f});
+
+        objectManager
+            .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/eye.obj")
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/eye.jpg")
+            .setStatic()
+            .build(scene, {-1.f, -1.f, 0.f}, {.04f, .04f, .04f});
+
+        objectManager
+            .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/Gun.obj")
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/Gun.jpg")
+            .setStatic()
+            .build(scene, {2.f, 0.5f, 0.f}, {1.5f, 1.5f, 1.5f});
+
+        objectManager
+            .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/quad.obj")
+            .setStatic()
+            .build(scene, {1.f, 1.f, 1.f}, {1000.f, 1000.f, 1000.f});
 
         auto sword = objectManager
                          .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/sword.obj")
@@ -174,22 +431,97 @@ namespace vke
                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/sword_roughness.jpg", TextureType::VKE_TEXTURE_TYPE_ROUGHNESS)
                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/sword_metallic.jpg", TextureType::VKE_TEXTURE_TYPE_METALLIC)
                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/sword_ao.jpg", TextureType::VKE_TEXTURE_TYPE_AO)
-                         .build({0.f, -0.1f, 0.f}, {1.f, 1.f, 1.f});
+                         .setStatic()
+                         .build(scene, {0.f, -0.1f, 0.f}, {1.f, 1.f, 1.f});
         for (int i = 0; i < 10; i++)
         {
-            auto swordCopy = sword;
-            swordCopy.transform.translation = {4 * i, 0, 0.f};
-            gameObjects.emplace(swordCopy.getId(), std::move(swordCopy));
+            auto swordCopy = scene.clone(sword);
+            scene.transforms.setTranslation(scene.transforms.indexOf(swordCopy), {4 * i, 0, 0.f});
         }
-        auto phone4 = objectManager
-                          .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/phone.obj")
-                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Color.tga.png")
-                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Normal.tga.png", TextureType::VKE_TEXTURE_TYPE_NORMAL)
-                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_AO.tga.png", TextureType::VKE_TEXTURE_TYPE_AO)
-                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Metallic.tga.png", TextureType::VKE_TEXTURE_TYPE_METALLIC)
-                          .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Rough.tga.png", TextureType::VKE_TEXTURE_TYPE_ROUGHNESS)
-                          .build({0.f, 1.f, -6}, {10.f, 10.f, 10.f});
-        gameObjects.emplace(phone4.getId(), std::move(phone4));
+        scene.destroyEntity(sword);
+        objectManager
+            .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/phone.obj")
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Color.tga.png")
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Normal.tga.png", TextureType::VKE_TEXTURE_TYPE_NORMAL)
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_AO.tga.png", TextureType::VKE_TEXTURE_TYPE_AO)
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Metallic.tga.png", TextureType::VKE_TEXTURE_TYPE_METALLIC)
+            .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + "textures/T_Telephone_Rough.tga.png", TextureType::VKE_TEXTURE_TYPE_ROUGHNESS)
+            .setStatic()
+            .build(scene, {0.f, 1.f, -6}, {10.f, 10.f, 10.f});
+    }
+
+    void App::loadStressScene()
+    {
+        struct StressAsset
+        {
+            const char *model;
+            const char *texture;
+            float scale;
+        };
+        const StressAsset assets[] = {
+            {"models/skull.obj", "textures/skull.jpg", .04f},
+            {"models/eye.obj", "textures/eye.jpg", .04f},
+            {"models/Gun.obj", "textures/Gun.jpg", 1.5f},
+            {"models/sword.obj", "textures/sword_albedo.jpg", 1.f},
+            {"models/phone.obj", "textures/T_Telephone_Color.tga.png", 10.f},
+        };
+
+        objectManager
+            .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + "models/quad.obj")
+            .setStatic()
+            .build(scene, {1.f, 1.f, 1.f}, {1000.f, 1000.f, 1000.f});
+
+        // one prototype per asset, every instance shares its model and material
+        std::vector<VkeEntity> prototypes;
+        for (const auto &asset : assets)
+        {
+            prototypes.push_back(objectManager
+                                     .addModel(std::string(VKENGINE_ABSOLUTE_PATH) + asset.model)
+                                     .addTexture(std::string(VKENGINE_ABSOLUTE_PATH) + asset.texture)
+                                     .setStatic()
+                                     .build(scene, {0.f, 0.f, 0.f}, glm::vec3{asset.scale}));
+        }
+
+        std::mt19937 random{BENCH_SEED};
+        std::uniform_real_distribution<float> jitter{-0.5f, 0.5f};
+        std::uniform_real_distribution<float> yaw{0.f, glm::two_pi<float>()};
+        constexpr float spacing = 3.f;
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(benchConfig.instances))));
+        float halfExtent = 0.5f * static_cast<float>(side) * spacing;
+        for (uint32_t i = 0; i < benchConfig.instances; i++)
+        {
+            VkeEntity instance = scene.clone(prototypes[i % prototypes.size()]);
+            uint32_t transformIndex = scene.transforms.indexOf(instance);
+            glm::vec3 translation{static_cast<float>(i % side) * spacing - halfExtent + jitter(random),
+                                  0.5f,
+                                  static_cast<float>(i / side) * spacing - halfExtent + jitter(random)};
+            scene.transforms.setTranslation(transformIndex, translation);
+            scene.transforms.setRotation(transformIndex, {0.f, yaw(random), 0.f});
+            // a quarter stays dynamic, so both the static bundles and the per frame recording are measured
+            if (i % 4 == 3)
+            {
+                scene.renderables.isStatic[scene.renderables.indexOf(instance)] = 0;
+            }
+        }
+        for (VkeEntity prototype : prototypes)
+        {
+            scene.destroyEntity(prototype);
+        }
+        sceneRadius = std::max(sceneRadius, halfExtent);
+
+        // the sun takes one of the global UBO's light slots
+        uint32_t lightCount = std::min(benchConfig.lights, static_cast<uint32_t>(MAX_LIGHTS - 1));
+        if (lightCount < benchConfig.lights)
+        {
+            std::cout << "Stress scene lights capped at " << lightCount << ", raise MAX_LIGHTS for more" << std::endl;
+        }
+        std::uniform_real_distribution<float> channel{0.1f, 1.f};
+        for (uint32_t i = 0; i < lightCount; i++)
+        {
+            auto pointLight = scene.createPointLight(0.3f, 0.1f, {channel(random), channel(random), channel(random)});
+            scene.transforms.setTranslation(scene.transforms.indexOf(pointLight), {jitter(random) * 2.f * halfExtent, -1.f, jitter(random) * 2.f * halfExtent});
+        }
+        std::cout << "Stress scene: " << benchConfig.instances << " instances, " << lightCount << " lights" << std::endl;
     }
     void App::loadLights()
     {
@@ -204,21 +536,20 @@ namespace vke
 
         for (int i = 0; i < lightColors.size(); i++)
         {
-            auto pointLight = VkeGameObject::makePointLight(0.3f);
-            pointLight.color = lightColors[i];
+            auto pointLight = scene.createPointLight(0.3f, 0.1f, lightColors[i]);
             auto rotate = glm::rotate(glm::mat4(1.f), (i * glm::two_pi<float>()) / lightColors.size(), {0.f, -1.f, 0.f});
-            pointLight.transform.translation = glm::vec3{rotate * glm::vec4(-1.f, -1.f, -1.f, 1.f)};
-            gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+            scene.transforms.setTranslation(scene.transforms.indexOf(pointLight), glm::vec3{rotate * glm::vec4(-1.f, -1.f, -1.f, 1.f)});
         }
     }
     void App::createDescriptors()
     {
         globalSetLayout = VkeDescriptorSetLayout::Builder(vkeDevice)
-                              .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)         // Existing UBO
+                              .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS) // Existing UBO
                               .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // Shadow map
+                              .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // EVSM moments
                               .build();
         shadowSetLayout = VkeDescriptorSetLayout::Builder(vkeDevice)
-                              .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // shadowmap UBO
+                              .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT) // shadowmap UBO
                               .build();
         materialSetLayout = VkeDescriptorSetLayout::Builder(vkeDevice)
                                 .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // albedo
@@ -228,89 +559,150 @@ namespace vke
                                 .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // ao
                                 .build();
 
-        globalDescriptorSets = std::vector<VkDescriptorSet>(MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < globalDescriptorSets.size(); i++)
-        {
-            VkDescriptorImageInfo shadowMapInfo{};
-            shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-            shadowMapInfo.imageView = vkeRenderer.getShadowMapDepthImageView();
-            auto sampler = TextureSampler(vkeDevice, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER).getSampler();
-            shadowMapInfo.sampler = sampler;
-
-            auto bufferInfo = uboBuffers[i]->descriptorInfo();
-            VkeDescriptorWriter(*globalSetLayout, *globalPool)
-                .writeBuffer(0, &bufferInfo)
-                .writeImage(1, &shadowMapInfo)
-                .build(globalDescriptorSets[i]);
-        }
-
-        shadowDescriptorSets = std::vector<VkDescriptorSet>(MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < shadowDescriptorSets.size(); i++)
-        {
-            auto bufferInfo = shadowUboBuffers[i]->descriptorInfo(); // shadow UBO
-            VkeDescriptorWriter(*shadowSetLayout, *globalPool)
-                .writeBuffer(0, &bufferInfo)
-                .build(shadowDescriptorSets[i]);
-        }
-
-        for (auto &gameObject : gameObjects)
+        VkDescriptorImageInfo shadowMapInfo{};
+        shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        shadowMapInfo.imageView = vkeRenderer.getShadowMapDepthImageView();
+        auto sampler = TextureSampler(vkeDevice, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, VK_COMPARE_OP_LESS_OR_EQUAL).getSampler();
+        shadowMapInfo.sampler = sampler;
+
+        auto bufferInfo = frameRing.descriptorInfo(sizeof(GlobalUbo));
+        VkeDescriptorWriter(*globalSetLayout, descriptorAllocator)
+            .writeBuffer(0, &bufferInfo)
+            .writeImage(1, &shadowMapInfo)
+            .build(globalDescriptorSet);
+
+        auto shadowBufferInfo = frameRing.descriptorInfo(sizeof(ShadowUbo)); // shadow UBO
+        VkeDescriptorWriter(*shadowSetLayout, descriptorAllocator)
+            .writeBuffer(0, &shadowBufferInfo)
+            .build(shadowDescriptorSet);
+
+        auto &renderables = scene.renderables;
+        // one set per material, objects sharing a material share it
+        std::unordered_map<const VkeMaterial *, VkDescriptorSet> materialSets;
+        for (uint32_t i = 0; i < renderables.size(); i++)
         {
-            if (gameObject.second.material == nullptr)
+            if (renderables.materials[i] == nullptr)
             {
                 continue;
             }
-            auto material = gameObject.second.material;
-            VkeDescriptorWriter(*materialSetLayout, *globalPool)
+            auto material = renderables.materials[i];
+            auto materialSet = materialSets.find(material.get());
+            if (materialSet != materialSets.end())
+            {
+                renderables.descriptorSets[i] = materialSet->second;
+                continue;
+            }
+            VkeDescriptorWriter(*materialSetLayout, descriptorAllocator)
                 .writeImage(1, &material->albedo->getDescriptor())
                 .writeImage(2, &material->normal->getDescriptor())
                 .writeImage(3, &material->roughness->getDescriptor())
                 .writeImage(4, &material->metallic->getDescriptor())
                 .writeImage(5, &material->ao->getDescriptor())
-                .build(gameObject.second.descriptorSet);
+                .build(renderables.descriptorSets[i]);
+            materialSets[material.get()] = renderables.descriptorSets[i];
         }
     }
-    void App::createUBOBuffers()
-    {
-        uboBuffers = std::vector<std::unique_ptr<VkeBuffer>>(MAX_FRAMES_IN_FLIGHT);
-        shadowUboBuffers = std::vector<std::unique_ptr<VkeBuffer>>(MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < uboBuffers.size(); i++)
-        {
-            uboBuffers[i] = std::make_unique<VkeBuffer>(
-                vkeDevice,
-                sizeof(GlobalUbo),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-            shadowUboBuffers[i] = std::make_unique<VkeBuffer>(
-                vkeDevice,
-                sizeof(ShadowUbo),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-            shadowUboBuffers[i]->map();
-            uboBuffers[i]->map();
-        }
-    }
-    void App::renderImGuiFrame(VkCommandBuffer commandBuffer, VkeGameObject &sun, glm::vec3 &cameraOffset)
+    void App::renderImGuiFrame(VkCommandBuffer commandBuffer, glm::vec3 &sunPosition, glm::vec3 &sunColor, glm::vec3 &cameraOffset, int &shadowFilter, bool &batchStatic, bool &rebatch)
     {
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         ImGui::Begin("Sun Control");
-        ImGui::SliderFloat("Sun X", &sun.transform.translation.x, -10.0f, 10.0f);
-        ImGui::SliderFloat("Sun Y", &sun.transform.translation.y, -10.0f, 10.0f);
-        ImGui::SliderFloat("Sun Z", &sun.transform.translation.z, -10.0f, 10.0f);
+        ImGui::SliderFloat("Sun X", &sunPosition.x, -10.0f, 10.0f);
+        ImGui::SliderFloat("Sun Y", &sunPosition.y, -10.0f, 10.0f);
+        ImGui::SliderFloat("Sun Z", &sunPosition.z, -10.0f, 10.0f);
 
         ImGui::SliderFloat("Camera Offset X", &cameraOffset.x, -100.0f, 100.0f);
         ImGui::SliderFloat("Camera Offset Y", &cameraOffset.y, -100.0f, 100.0f);
         ImGui::SliderFloat("Camera Offset Z", &cameraOffset.z, -100.0f, 100.0f);
 
-        ImGui::SliderFloat("Sun Color R", &sun.color.r, 0.0f, 1.0f);
-        ImGui::SliderFloat("Sun Color G", &sun.color.g, 0.0f, 1.0f);
-        ImGui::SliderFloat("Sun Color B", &sun.color.b, 0.0f, 1.0f);
+        ImGui::SliderFloat("Sun Color R", &sunColor.r, 0.0f, 1.0f);
+        ImGui::SliderFloat("Sun Color G", &sunColor.g, 0.0f, 1.0f);
+        ImGui::SliderFloat("Sun Color B", &sunColor.b, 0.0f, 1.0f);
 
+        const char *shadowFilters[] = {"PCF 4 tap", "Poisson 16 tap", "EVSM"};
+        ImGui::Combo("Shadow Filter", &shadowFilter, shadowFilters, IM_ARRAYSIZE(shadowFilters));
+
+        // applied at the start of the next frame
+        if (ImGui::Checkbox("Batch Static Objects", &batchStatic))
+        {
+            rebatch = true;
+        }
+        if (batchStatic && ImGui::Button("Rebuild Static Batches"))
+        {
+            rebatch = true;
+        }
+        ImGui::Text("Static batches: %u", staticBatcher.getBatchCount());
+        ImGui::Text("Frame ring: %.1f / %.0f KB", frameRing.getUsedBytes() / 1024.f, frameRing.getFrameCapacity() / 1024.f);
+        ImGui::Text("Descriptor sets: %u in %zu pools", descriptorAllocator.getAllocatedSets(), descriptorAllocator.getPoolCount());
+
+        // saved for --bench --camera-path once recording stops
+        if (ImGui::Checkbox("Record Camera Path", &recordingCameraPath))
+        {
+            if (recordingCameraPath)
+            {
+                recordedCameraPath.clear();
+                cameraPathTime = 0.f;
+            }
+            else if (recordedCameraPath.save("camera_path.txt"))
+            {
+                std::cout << "Camera path written to: camera_path.txt" << std::endl;
+            }
+        }
+
+        // frames over budget dump the last seconds of CPU trace to hitch_<frame>.json
+        bool recordHitches = flightRecorder.isEnabled();
+        if (ImGui::Checkbox("Flight Recorder", &recordHitches))
+        {
+            flightRecorder.setEnabled(recordHitches);
+        }
+        float hitchBudget = static_cast<float>(flightRecorder.getBudget());
+        if (ImGui::SliderFloat("Hitch Budget (ms)", &hitchBudget, 5.0f, 200.0f))
+        {
+            flightRecorder.setBudget(hitchBudget);
+        }
+        ImGui::Text("Hitches recorded: %u %s", flightRecorder.getDumpCount(), flightRecorder.getLastDumpPath().c_str());
+        if (ImGui::Button("Write CPU Trace"))
+        {
+            VkeTrace::writeChromeTrace("trace.json", TRACE_FLIGHT_RECORDER_SECONDS);
+        }
+
+        ImGui::End();
+
+        UISystem::renderStatsOverlay(renderStats);
+
+        // results are from the last time this frame index was drawn
+        auto &gpuProfiler = vkeRenderer.getGpuProfiler();
+        ImGui::Begin("GPU Profiler");
+        if (!gpuProfiler.isSupported())
+        {
+            ImGui::Text("Timestamps are not supported by the graphics queue");
+        }
+        for (const auto &result : gpuProfiler.getResults())
+        {
+            int indent = static_cast<int>(result.depth) * 2;
+            ImGui::Text("%*s%-14s %7.3f ms", indent, "", result.name.c_str(), result.milliseconds);
+            if (result.hasStatistics)
+            {
+                ImGui::Text("%*s  vertices %llu, clipped primitives %llu, fragments %llu", indent, "",
+                            static_cast<unsigned long long>(result.vertexInvocations),
+                            static_cast<unsigned long long>(result.clippingPrimitives),
+                            static_cast<unsigned long long>(result.fragmentInvocations));
+            }
+        }
+        bool captureCsv = gpuProfiler.isCapturingCsv();
+        if (ImGui::Checkbox("Capture to gpu_profile.csv", &captureCsv))
+        {
+            if (captureCsv)
+            {
+                gpuProfiler.startCsvCapture("gpu_profile.csv");
+            }
+            else
+            {
+                gpuProfiler.stopCsvCapture();
+            }
+        }
         ImGui::End();
 
         ImGui::Render();
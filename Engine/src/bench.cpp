@@ -0,0 +1,297 @@
+#include "bench.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace vke
+{
+    namespace
+    {
+        uint32_t parseCount(const char *option, const char *value)
+        {
+            // strtoul skips white space and negates a leading '-', so only digits may start the value
+            if (value[0] < '0' || value[0] > '9')
+            {
+                throw std::invalid_argument(std::string("expected a number after ") + option + ", got " + value);
+            }
+            char *end = nullptr;
+            errno = 0;
+            unsigned long long parsed = std::strtoull(value, &end, 10);
+            if (*end != '\0' || errno == ERANGE || parsed > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::invalid_argument(std::string("expected a number after ") + option + ", got " + value);
+            }
+            return static_cast<uint32_t>(parsed);
+        }
+
+        std::string jsonString(const std::string &text)
+        {
+            std::string quoted = "\"";
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    quoted += '\\';
+                    quoted += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    quoted += escaped;
+                }
+                else
+                {
+                    quoted += c;
+                }
+            }
+            return quoted + '"';
+        }
+
+        // nearest rank percentiles, the same definition the stats HUD uses
+        void writeDistribution(std::ofstream &file, const char *name, std::vector<double> values)
+        {
+            file << "  " << jsonString(name) << ": {\"samples\": " << values.size();
+            if (!values.empty())
+            {
+                std::sort(values.begin(), values.end());
+                auto percentile = [&values](uint32_t p)
+                {
+                    size_t rank = (values.size() * p + 99) / 100;
+                    return values[std::max<size_t>(rank, 1) - 1];
+                };
+                double sum = 0.0;
+                for (double value : values)
+                {
+                    sum += value;
+                }
+                char numbers[256];
+                std::snprintf(numbers, sizeof(numbers),
+                              ", \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f",
+                              values.front(), sum / values.size(), percentile(50), percentile(95), percentile(99), values.back());
+                file << numbers;
+            }
+            file << "}";
+        }
+    } // namespace
+
+    VkeBenchConfig VkeBenchConfig::parse(int argc, char **argv)
+    {
+        VkeBenchConfig config{};
+        for (int i = 1; i < argc; i++)
+        {
+            std::string option = argv[i];
+            if (option == "--bench")
+            {
+                config.enabled = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("missing value after " + option);
+            }
+            const char *value = argv[++i];
+            if (option == "--frames")
+            {
+                config.frames = parseCount(argv[i - 1], value);
+            }
+            else if (option == "--warmup")
+            {
+                config.warmupFrames = parseCount(argv[i - 1], value);
+            }
+            else if (option == "--instances")
+            {
+                config.instances = parseCount(argv[i - 1], value);
+            }
+            else if (option == "--lights")
+            {
+                config.lights = parseCount(argv[i - 1], value);
+            }
+            else if (option == "--camera-path")
+            {
+                config.cameraPath = value;
+            }
+            else if (option == "--output")
+            {
+                config.output = value;
+            }
+            else
+            {
+                throw std::invalid_argument("unknown option " + option);
+            }
+        }
+        return config;
+    }
+
+    const char *VkeBenchConfig::usage()
+    {
+        return "usage: app [--bench] [--frames N] [--warmup N] [--instances N] [--lights N] [--camera-path FILE] [--output FILE]\n"
+               "  --bench        render a fixed number of frames in a hidden window, write a JSON report and exit\n"
+               "  --instances N  replace the scene with N instances of the bundled models\n"
+               "  --lights N     add N point lights to the stress scene\n"
+               "  --camera-path  play back a path recorded from the UI instead of orbiting the scene\n";
+    }
+
+    VkeCameraPath VkeCameraPath::orbit(glm::vec3 center, float radius, float height, float duration)
+    {
+        VkeCameraPath path{};
+        constexpr uint32_t KEY_COUNT = 64;
+        for (uint32_t i = 0; i <= KEY_COUNT; i++)
+        {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / KEY_COUNT;
+            glm::vec3 translation = center + glm::vec3{std::sin(angle) * radius, height, -std::cos(angle) * radius};
+            glm::vec3 toCenter = center - translation;
+            // -y is up, a positive pitch looks up
+            float pitch = std::atan2(-toCenter.y, std::sqrt(toCenter.x * toCenter.x + toCenter.z * toCenter.z));
+            // unwrapped, so interpolating between keys never turns the long way around
+            float yaw = -angle;
+            path.addKey({duration * static_cast<float>(i) / KEY_COUNT, translation, {pitch, yaw, 0.f}});
+        }
+        return path;
+    }
+
+    void VkeCameraPath::load(const std::string &path)
+    {
+        std::ifstream file{path};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open camera path: " + path);
+        }
+        keys.clear();
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream values{line};
+            Key key{};
+            if (!(values >> key.time >> key.translation.x >> key.translation.y >> key.translation.z >> key.rotation.x >> key.rotation.y >> key.rotation.z))
+            {
+                throw std::runtime_error("malformed camera path key in " + path + ": " + line);
+            }
+            if (!keys.empty() && key.time < keys.back().time)
+            {
+                throw std::runtime_error("camera path keys are not in time order: " + path);
+            }
+            keys.push_back(key);
+        }
+        if (keys.empty())
+        {
+            throw std::runtime_error("camera path has no keys: " + path);
+        }
+    }
+
+    bool VkeCameraPath::save(const std::string &path) const
+    {
+        std::ofstream file{path, std::ios::out | std::ios::trunc};
+        if (!file.is_open())
+        {
+            return false;
+        }
+        file << "# time tx ty tz rx ry rz\n";
+        char line[256];
+        for (const auto &key : keys)
+        {
+            std::snprintf(line, sizeof(line), "%.4f %.5f %.5f %.5f %.5f %.5f %.5f\n", key.time,
+                          key.translation.x, key.translation.y, key.translation.z,
+                          key.rotation.x, key.rotation.y, key.rotation.z);
+            file << line;
+        }
+        return file.good();
+    }
+
+    void VkeCameraPath::sample(float time, TransformComponent &transform) const
+    {
+        if (keys.empty())
+        {
+            return;
+        }
+        auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key &key)
+                                     { return t < key.time; });
+        if (next == keys.begin() || next == keys.end())
+        {
+            const Key &key = next == keys.begin() ? keys.front() : keys.back();
+            transform.translation = key.translation;
+            transform.rotation = key.rotation;
+            return;
+        }
+        const Key &previous = *(next - 1);
+        float span = next->time - previous.time;
+        float t = span > 0.f ? (time - previous.time) / span : 1.f;
+        transform.translation = glm::mix(previous.translation, next->translation, t);
+        transform.rotation = glm::mix(previous.rotation, next->rotation, t);
+    }
+
+    bool VkeBenchReport::write(const std::string &path) const
+    {
+        std::ofstream file{path, std::ios::out | std::ios::trunc};
+        if (!file.is_open())
+        {
+            return false;
+        }
+        file << "{\n";
+        for (const auto &[key, value] : info)
+        {
+            file << "  " << jsonString(key) << ": " << jsonString(value) << ",\n";
+        }
+        for (const auto &[key, value] : counts)
+        {
+            file << "  " << jsonString(key) << ": " << value << ",\n";
+        }
+        writeDistribution(file, "cpu_frame_ms", cpuFrameTimes);
+        file << ",\n";
+        writeDistribution(file, "gpu_frame_ms", gpuFrameTimes);
+        file << ",\n  \"load_ms\": {";
+        char number[32];
+        for (size_t i = 0; i < loadTimes.size(); i++)
+        {
+            std::snprintf(number, sizeof(number), "%.3f", loadTimes[i].second);
+            file << (i == 0 ? "" : ", ") << jsonString(loadTimes[i].first) << ": " << number;
+        }
+        file << "},\n  \"memory_bytes\": {";
+        for (size_t i = 0; i < memory.size(); i++)
+        {
+            file << (i == 0 ? "" : ", ") << jsonString(memory[i].first) << ": " << memory[i].second;
+        }
+        file << "}\n}\n";
+        return file.good();
+    }
+
+    uint64_t VkeBenchReport::getPeakResidentBytes()
+    {
+#if defined(_WIN32)
+        return 0;
+#else
+        struct rusage usage
+        {
+        };
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+#if defined(__APPLE__)
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        // kilobytes everywhere but macOS
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+} // namespace vke
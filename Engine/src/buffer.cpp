@@ -7,6 +7,8 @@
 
 #include "buffer.hpp"
 
+#include "render_stats.hpp"
+
 // std
 #include <cassert>
 #include <cstring>
@@ -38,16 +40,18 @@ namespace vke
         uint32_t instanceCount,
         VkBufferUsageFlags usageFlags,
         VkMemoryPropertyFlags memoryPropertyFlags,
-        VkDeviceSize minOffsetAlignment)
+        VkDeviceSize minOffsetAlignment,
+        bool concurrent)
         : vkeDevice{device},
           instanceSize{instanceSize},
           instanceCount{instanceCount},
           usageFlags{usageFlags},
-          memoryPropertyFlags{memoryPropertyFlags}
+          memoryPropertyFlags{memoryPropertyFlags},
+          concurrent{concurrent}
     {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory, concurrent);
     }
 
     VkeBuffer::~VkeBuffer()
@@ -102,12 +106,14 @@ namespace vke
         if (size == VK_WHOLE_SIZE)
         {
             memcpy(mapped, data, bufferSize);
+            VKE_STAT_ADD(VKE_STAT_BUFFER_WRITE_BYTES, bufferSize);
         }
         else
         {
             char *memOffset = (char *)mapped;
             memOffset += offset;
             memcpy(memOffset, data, size);
+            VKE_STAT_ADD(VKE_STAT_BUFFER_WRITE_BYTES, size);
         }
     }
 
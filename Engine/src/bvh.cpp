@@ -0,0 +1,565 @@
+#include "bvh.hpp"
+#include "settings.hpp"
+#include "simd.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace vke
+{
+    const VkeAabb VkeBvh::emptyBounds{};
+
+    void VkeBvh::update(const VkeScene &scene)
+    {
+        const auto &renderables = scene.renderables;
+        const auto &transforms = scene.transforms;
+        if (renderables.getLayoutVersion() != renderableLayout || transforms.getLayoutVersion() != transformLayout)
+        {
+            // dense indices moved, rebuild the mapping and the tree
+            renderableLayout = renderables.getLayoutVersion();
+            transformLayout = transforms.getLayoutVersion();
+            transformUpdates = transforms.getUpdateCount();
+            itemOfTransform.assign(transforms.size(), NO_HIT);
+            std::vector<VkeAabb> bounds(renderables.size());
+            for (uint32_t i = 0; i < renderables.size(); i++)
+            {
+                uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+                assert(transformIndex != VkeSparseSet::NOT_FOUND && "renderable without a transform");
+                itemOfTransform[transformIndex] = i;
+                bounds[i] = renderables.models[i]->getBounds().transformed(transforms.getWorldMatrix(transformIndex));
+            }
+            build(std::move(bounds));
+            return;
+        }
+
+        uint64_t updateCount = transforms.getUpdateCount();
+        if (updateCount == transformUpdates)
+        {
+            return;
+        }
+        if (updateCount == transformUpdates + 1)
+        {
+            // only the transforms recomputed since the last sync can have moved
+            for (uint32_t transformIndex : transforms.getUpdatedIndices())
+            {
+                uint32_t item = itemOfTransform[transformIndex];
+                if (item != NO_HIT)
+                {
+                    syncItemBounds(scene, item, transformIndex);
+                }
+            }
+        }
+        else
+        {
+            // missed an update, so the updated list no longer covers everything that moved
+            for (uint32_t transformIndex = 0; transformIndex < transforms.size(); transformIndex++)
+            {
+                uint32_t item = itemOfTransform[transformIndex];
+                if (item != NO_HIT)
+                {
+                    syncItemBounds(scene, item, transformIndex);
+                }
+            }
+        }
+        transformUpdates = updateCount;
+        refit();
+    }
+    void VkeBvh::syncItemBounds(const VkeScene &scene, uint32_t item, uint32_t transformIndex)
+    {
+        setItemBounds(item, scene.renderables.models[item]->getBounds().transformed(scene.transforms.getWorldMatrix(transformIndex)));
+    }
+
+    void VkeBvh::build(std::vector<VkeAabb> bounds)
+    {
+        itemBounds = std::move(bounds);
+        uint32_t itemCount = static_cast<uint32_t>(itemBounds.size());
+        nodes.clear();
+        parents.clear();
+        itemOrder.resize(itemCount);
+        std::iota(itemOrder.begin(), itemOrder.end(), 0);
+        leafOfItem.assign(itemCount, 0);
+        movedItems.clear();
+        itemMoved.assign(itemCount, 0);
+        internalAreaSum = 0.f;
+        builtCost = 0.f;
+        if (itemCount == 0)
+        {
+            nodeQueued.clear();
+            return;
+        }
+
+        std::vector<glm::vec3> centroids(itemCount);
+        for (uint32_t i = 0; i < itemCount; i++)
+        {
+            centroids[i] = itemBounds[i].center();
+        }
+
+        // at most 2n - 1 nodes, reserving keeps the node references below stable
+        nodes.reserve(2 * itemCount - 1);
+        parents.reserve(2 * itemCount - 1);
+        Node root{};
+        root.count = itemCount;
+        nodes.push_back(root);
+        parents.push_back(NO_PARENT);
+
+        std::vector<uint32_t> stack{0};
+        while (!stack.empty())
+        {
+            uint32_t nodeIndex = stack.back();
+            stack.pop_back();
+            if (subdivide(nodeIndex, centroids))
+            {
+                stack.push_back(nodes[nodeIndex].firstIndex + 1);
+                stack.push_back(nodes[nodeIndex].firstIndex);
+            }
+        }
+
+        for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++)
+        {
+            const Node &node = nodes[nodeIndex];
+            if (node.isLeaf())
+            {
+                for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+                {
+                    leafOfItem[itemOrder[i]] = nodeIndex;
+                }
+            }
+            else
+            {
+                internalAreaSum += node.bounds.surfaceArea();
+            }
+        }
+        nodeQueued.assign(nodes.size(), 0);
+        builtCost = getCost();
+    }
+
+    bool VkeBvh::subdivide(uint32_t nodeIndex, const std::vector<glm::vec3> &centroids)
+    {
+        Node &node = nodes[nodeIndex];
+        uint32_t begin = node.firstIndex;
+        uint32_t end = begin + node.count;
+        VkeAabb centroidBounds{};
+        for (uint32_t i = begin; i < end; i++)
+        {
+            node.bounds.grow(itemBounds[itemOrder[i]]);
+            centroidBounds.grow(centroids[itemOrder[i]]);
+        }
+        if (node.count == 1)
+        {
+            return false;
+        }
+
+        // binned SAH: bucket the centroids along each axis and evaluate the split between every pair of buckets
+        struct Bin
+        {
+            VkeAabb bounds;
+            uint32_t count = 0;
+        };
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float axisMin = centroidBounds.min[axis];
+            float axisExtent = centroidBounds.max[axis] - axisMin;
+            if (axisExtent <= 0.f)
+            {
+                continue;
+            }
+            float scale = BVH_SAH_BINS / axisExtent;
+            Bin bins[BVH_SAH_BINS];
+            for (uint32_t i = begin; i < end; i++)
+            {
+                uint32_t bin = std::min<uint32_t>(BVH_SAH_BINS - 1, static_cast<uint32_t>((centroids[itemOrder[i]][axis] - axisMin) * scale));
+                bins[bin].bounds.grow(itemBounds[itemOrder[i]]);
+                bins[bin].count++;
+            }
+
+            float rightCost[BVH_SAH_BINS - 1];
+            VkeAabb accumulated{};
+            uint32_t accumulatedCount = 0;
+            for (uint32_t split = BVH_SAH_BINS - 1; split > 0; split--)
+            {
+                accumulated.grow(bins[split].bounds);
+                accumulatedCount += bins[split].count;
+                rightCost[split - 1] = accumulatedCount * accumulated.surfaceArea();
+            }
+            accumulated = VkeAabb{};
+            accumulatedCount = 0;
+            for (uint32_t split = 0; split < BVH_SAH_BINS - 1; split++)
+            {
+                accumulated.grow(bins[split].bounds);
+                accumulatedCount += bins[split].count;
+                float cost = accumulatedCount * accumulated.surfaceArea() + rightCost[split];
+                if (accumulatedCount > 0 && accumulatedCount < node.count && cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // costs are relative to the node area, one traversal step is worth about one item test
+        float leafCost = node.count * node.bounds.surfaceArea();
+        float splitCost = node.bounds.surfaceArea() + bestCost;
+        if (node.count <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= leafCost))
+        {
+            return false;
+        }
+
+        uint32_t middle;
+        if (bestAxis >= 0)
+        {
+            float axisMin = centroidBounds.min[bestAxis];
+            float scale = BVH_SAH_BINS / (centroidBounds.max[bestAxis] - axisMin);
+            middle = static_cast<uint32_t>(std::partition(
+                                               itemOrder.begin() + begin,
+                                               itemOrder.begin() + end,
+                                               [&](uint32_t item)
+                                               {
+                                                   uint32_t bin = std::min<uint32_t>(BVH_SAH_BINS - 1, static_cast<uint32_t>((centroids[item][bestAxis] - axisMin) * scale));
+                                                   return bin <= bestSplit;
+                                               }) -
+                                           itemOrder.begin());
+        }
+        else
+        {
+            // every centroid is in the same spot, split by count only to keep leaves small
+            middle = begin + node.count / 2;
+        }
+
+        uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+        Node left{};
+        left.firstIndex = begin;
+        left.count = middle - begin;
+        Node right{};
+        right.firstIndex = middle;
+        right.count = end - middle;
+        node.firstIndex = leftIndex;
+        node.count = 0;
+        node.splitAxis = bestAxis >= 0 ? static_cast<uint32_t>(bestAxis) : 0;
+        nodes.push_back(left);
+        nodes.push_back(right);
+        parents.push_back(nodeIndex);
+        parents.push_back(nodeIndex);
+        return true;
+    }
+
+    void VkeBvh::setItemBounds(uint32_t item, const VkeAabb &bounds)
+    {
+        itemBounds[item] = bounds;
+        if (!itemMoved[item])
+        {
+            itemMoved[item] = 1;
+            movedItems.push_back(item);
+        }
+    }
+
+    bool VkeBvh::refit()
+    {
+        if (movedItems.empty())
+        {
+            return false;
+        }
+        // past a few moved items walking their ancestors costs more than sweeping every node once
+        if (movedItems.size() * 8 > itemBounds.size())
+        {
+            refitAll();
+        }
+        else
+        {
+            refitNodes.clear();
+            for (uint32_t item : movedItems)
+            {
+                for (uint32_t nodeIndex = leafOfItem[item]; nodeIndex != NO_PARENT && !nodeQueued[nodeIndex]; nodeIndex = parents[nodeIndex])
+                {
+                    nodeQueued[nodeIndex] = 1;
+                    refitNodes.push_back(nodeIndex);
+                }
+            }
+            // children always come after their parent, so descending order refits bottom up
+            std::sort(refitNodes.begin(), refitNodes.end(), std::greater<uint32_t>());
+            for (uint32_t nodeIndex : refitNodes)
+            {
+                refitNode(nodeIndex);
+                nodeQueued[nodeIndex] = 0;
+            }
+        }
+        for (uint32_t item : movedItems)
+        {
+            itemMoved[item] = 0;
+        }
+        movedItems.clear();
+
+        if (getCost() > builtCost * BVH_REBUILD_RATIO)
+        {
+            build(std::move(itemBounds));
+            return true;
+        }
+        return false;
+    }
+    void VkeBvh::refitNode(uint32_t nodeIndex)
+    {
+        Node &node = nodes[nodeIndex];
+        if (node.isLeaf())
+        {
+            node.bounds = VkeAabb{};
+            for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+            {
+                node.bounds.grow(itemBounds[itemOrder[i]]);
+            }
+            return;
+        }
+        internalAreaSum -= node.bounds.surfaceArea();
+        node.bounds = nodes[node.firstIndex].bounds;
+        node.bounds.grow(nodes[node.firstIndex + 1].bounds);
+        internalAreaSum += node.bounds.surfaceArea();
+    }
+    void VkeBvh::refitAll()
+    {
+        for (uint32_t nodeIndex = static_cast<uint32_t>(nodes.size()); nodeIndex-- > 0;)
+        {
+            refitNode(nodeIndex);
+        }
+        // resum from scratch so incremental float error does not build up
+        internalAreaSum = 0.f;
+        for (const Node &node : nodes)
+        {
+            if (!node.isLeaf())
+            {
+                internalAreaSum += node.bounds.surfaceArea();
+            }
+        }
+    }
+    float VkeBvh::getCost() const
+    {
+        if (nodes.empty())
+        {
+            return 0.f;
+        }
+        float rootArea = nodes[0].bounds.surfaceArea();
+        return rootArea > 0.f ? internalAreaSum / rootArea : 0.f;
+    }
+
+    void VkeBvh::queryFrustums(const VkeFrustum *frustums, uint32_t frustumCount, std::vector<uint32_t> *results) const
+    {
+        assert(frustumCount <= MAX_BATCHED_FRUSTUMS && "too many frustums for one query");
+        if (nodes.empty() || frustumCount == 0)
+        {
+            return;
+        }
+
+        // testMask: frustums the node straddles, acceptMask: frustums the node is already known to be inside
+        struct Entry
+        {
+            uint32_t nodeIndex;
+            uint32_t testMask;
+            uint32_t acceptMask;
+        };
+        std::vector<Entry> stack;
+        stack.reserve(64);
+        stack.push_back({0, frustumCount == 32 ? ~0u : (1u << frustumCount) - 1, 0});
+        while (!stack.empty())
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            const Node &node = nodes[entry.nodeIndex];
+            for (uint32_t f = 0; f < frustumCount; f++)
+            {
+                uint32_t bit = 1u << f;
+                if (!(entry.testMask & bit))
+                {
+                    continue;
+                }
+                VkeFrustum::Containment containment = frustums[f].classify(node.bounds);
+                if (containment != VkeFrustum::INTERSECTING)
+                {
+                    entry.testMask &= ~bit;
+                }
+                if (containment == VkeFrustum::INSIDE)
+                {
+                    entry.acceptMask |= bit;
+                }
+            }
+            if ((entry.testMask | entry.acceptMask) == 0)
+            {
+                continue;
+            }
+
+            if (!node.isLeaf())
+            {
+                stack.push_back({node.firstIndex + 1, entry.testMask, entry.acceptMask});
+                stack.push_back({node.firstIndex, entry.testMask, entry.acceptMask});
+                continue;
+            }
+            for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+            {
+                uint32_t item = itemOrder[i];
+                for (uint32_t f = 0; f < frustumCount; f++)
+                {
+                    uint32_t bit = 1u << f;
+                    if ((entry.acceptMask & bit) ||
+                        ((entry.testMask & bit) && frustums[f].classify(itemBounds[item]) != VkeFrustum::OUTSIDE))
+                    {
+                        results[f].push_back(item);
+                    }
+                }
+            }
+        }
+    }
+
+    void VkeBvh::querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &results) const
+    {
+        if (nodes.empty())
+        {
+            return;
+        }
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (!node.bounds.overlapsSphere(center, radius))
+            {
+                continue;
+            }
+            if (!node.isLeaf())
+            {
+                stack.push_back(node.firstIndex + 1);
+                stack.push_back(node.firstIndex);
+                continue;
+            }
+            for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+            {
+                if (itemBounds[itemOrder[i]].overlapsSphere(center, radius))
+                {
+                    results.push_back(itemOrder[i]);
+                }
+            }
+        }
+    }
+
+    template <typename Lanes>
+    void VkeBvh::raycastPacket(const VkeRay *rays, VkeRayHit *hits) const
+    {
+        using Reg = typename Lanes::Reg;
+        constexpr uint32_t W = Lanes::WIDTH;
+
+        alignas(32) float originX[W], originY[W], originZ[W];
+        alignas(32) float inverseX[W], inverseY[W], inverseZ[W];
+        alignas(32) float nearest[W], entry[W];
+        for (uint32_t lane = 0; lane < W; lane++)
+        {
+            originX[lane] = rays[lane].origin.x;
+            originY[lane] = rays[lane].origin.y;
+            originZ[lane] = rays[lane].origin.z;
+            // axis parallel rays get an infinite slab distance, which the min / max below handle
+            inverseX[lane] = 1.f / rays[lane].direction.x;
+            inverseY[lane] = 1.f / rays[lane].direction.y;
+            inverseZ[lane] = 1.f / rays[lane].direction.z;
+            nearest[lane] = rays[lane].maxDistance;
+            hits[lane] = {NO_HIT, rays[lane].maxDistance};
+        }
+        const Reg ox = Lanes::load(originX), oy = Lanes::load(originY), oz = Lanes::load(originZ);
+        const Reg ix = Lanes::load(inverseX), iy = Lanes::load(inverseY), iz = Lanes::load(inverseZ);
+        const Reg zero = Lanes::set1(0.f);
+        Reg tMax = Lanes::load(nearest);
+
+        // slab test of every lane against one box, bit i set when ray i enters it before its nearest hit
+        auto slab = [&](const VkeAabb &box, float *entryOut) -> uint32_t
+        {
+            Reg t1x = Lanes::mul(Lanes::sub(Lanes::set1(box.min.x), ox), ix);
+            Reg t2x = Lanes::mul(Lanes::sub(Lanes::set1(box.max.x), ox), ix);
+            Reg t1y = Lanes::mul(Lanes::sub(Lanes::set1(box.min.y), oy), iy);
+            Reg t2y = Lanes::mul(Lanes::sub(Lanes::set1(box.max.y), oy), iy);
+            Reg t1z = Lanes::mul(Lanes::sub(Lanes::set1(box.min.z), oz), iz);
+            Reg t2z = Lanes::mul(Lanes::sub(Lanes::set1(box.max.z), oz), iz);
+            Reg tEnter = Lanes::max(
+                Lanes::max(Lanes::min(t1x, t2x), Lanes::min(t1y, t2y)),
+                Lanes::max(Lanes::min(t1z, t2z), zero));
+            Reg tExit = Lanes::min(
+                Lanes::min(Lanes::max(t1x, t2x), Lanes::max(t1y, t2y)),
+                Lanes::min(Lanes::max(t1z, t2z), tMax));
+            if (entryOut != nullptr)
+            {
+                Lanes::store(entryOut, tEnter);
+            }
+            return Lanes::lessEqual(tEnter, tExit);
+        };
+
+        // the first ray's direction picks the near child, packets of coherent rays mostly agree
+        const glm::vec3 &leadDirection = rays[0].direction;
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (slab(node.bounds, nullptr) == 0)
+            {
+                continue;
+            }
+
+            if (!node.isLeaf())
+            {
+                // popped last, so the near child is visited first and can shorten the rays early
+                bool leftFirst = leadDirection[node.splitAxis] >= 0.f;
+                stack.push_back(leftFirst ? node.firstIndex + 1 : node.firstIndex);
+                stack.push_back(leftFirst ? node.firstIndex : node.firstIndex + 1);
+                continue;
+            }
+
+            for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+            {
+                uint32_t item = itemOrder[i];
+                uint32_t mask = slab(itemBounds[item], entry);
+                if (mask == 0)
+                {
+                    continue;
+                }
+                for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1)
+                {
+                    if ((mask & 1) && entry[lane] < nearest[lane])
+                    {
+                        nearest[lane] = entry[lane];
+                        hits[lane] = {item, entry[lane]};
+                    }
+                }
+                tMax = Lanes::load(nearest);
+            }
+        }
+    }
+
+    void VkeBvh::raycast(const VkeRay *rays, uint32_t rayCount, VkeRayHit *hits) const
+    {
+        if (nodes.empty())
+        {
+            for (uint32_t i = 0; i < rayCount; i++)
+            {
+                hits[i] = {NO_HIT, rays[i].maxDistance};
+            }
+            return;
+        }
+        uint32_t packetCount = rayCount / simd::VectorLanes::WIDTH;
+        for (uint32_t packet = 0; packet < packetCount; packet++)
+        {
+            raycastPacket<simd::VectorLanes>(rays + packet * simd::VectorLanes::WIDTH, hits + packet * simd::VectorLanes::WIDTH);
+        }
+        for (uint32_t i = packetCount * simd::VectorLanes::WIDTH; i < rayCount; i++)
+        {
+            raycastPacket<simd::ScalarLanes>(rays + i, hits + i);
+        }
+    }
+    VkeRayHit VkeBvh::raycast(const VkeRay &ray) const
+    {
+        VkeRayHit hit{};
+        raycast(&ray, 1, &hit);
+        return hit;
+    }
+} // namespace vke
@@ -1,11 +1,28 @@
 #include "descriptors.hpp"
 
+#include "trace.hpp"
+
 // std
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 namespace vke
 {
+    namespace
+    {
+        // position of a binding's info in the packed template data
+        uint32_t bindingsBelow(uint64_t bindingMask, uint32_t binding)
+        {
+            uint32_t count = 0;
+            for (uint64_t below = bindingMask & ((uint64_t{1} << binding) - 1); below != 0; below &= below - 1)
+            {
+                count++;
+            }
+            return count;
+        }
+    } // namespace
 
     // *************** Descriptor Set Layout Builder *********************
 
@@ -59,9 +76,57 @@ namespace vke
 
     VkeDescriptorSetLayout::~VkeDescriptorSetLayout()
     {
+        for (auto &[bindingMask, updateTemplate] : updateTemplates)
+        {
+            vkeDevice.destroyDescriptorUpdateTemplate(vkeDevice.device(), updateTemplate, nullptr);
+        }
         vkDestroyDescriptorSetLayout(vkeDevice.device(), descriptorSetLayout, nullptr);
     }
 
+    VkDescriptorUpdateTemplateKHR VkeDescriptorSetLayout::getUpdateTemplate(uint64_t bindingMask)
+    {
+        assert(vkeDevice.createDescriptorUpdateTemplate != nullptr && "Descriptor update templates are not supported");
+        std::lock_guard<std::mutex> lock{updateTemplateMutex};
+        auto it = updateTemplates.find(bindingMask);
+        if (it != updateTemplates.end())
+        {
+            return it->second;
+        }
+
+        std::vector<VkDescriptorUpdateTemplateEntryKHR> entries;
+        for (uint32_t binding = 0; binding < 64; binding++)
+        {
+            if ((bindingMask & (uint64_t{1} << binding)) == 0)
+            {
+                continue;
+            }
+            assert(bindings.count(binding) == 1 && "Layout does not contain specified binding");
+            VkDescriptorUpdateTemplateEntryKHR entry{};
+            entry.dstBinding = binding;
+            entry.dstArrayElement = 0;
+            entry.descriptorCount = 1;
+            entry.descriptorType = bindings[binding].descriptorType;
+            entry.offset = entries.size() * DESCRIPTOR_INFO_STRIDE;
+            entry.stride = DESCRIPTOR_INFO_STRIDE;
+            entries.push_back(entry);
+        }
+
+        VkDescriptorUpdateTemplateCreateInfoKHR templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        templateInfo.descriptorSetLayout = descriptorSetLayout;
+
+        VkDescriptorUpdateTemplateKHR updateTemplate;
+        if (vkeDevice.createDescriptorUpdateTemplate(vkeDevice.device(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create descriptor update template!");
+        }
+        updateTemplates[bindingMask] = updateTemplate;
+        return updateTemplate;
+    }
+
     // *************** Descriptor Pool Builder *********************
 
     VkeDescriptorPool::Builder &VkeDescriptorPool::Builder::addPoolSize(
@@ -125,8 +190,6 @@ namespace vke
         allocInfo.pSetLayouts = &descriptorSetLayout;
         allocInfo.descriptorSetCount = 1;
 
-        // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-        // a new pool whenever an old pool fills up. But this is beyond our current scope
         if (vkAllocateDescriptorSets(vkeDevice.device(), &allocInfo, &descriptor) != VK_SUCCESS)
         {
             return false;
@@ -148,10 +211,68 @@ namespace vke
         vkResetDescriptorPool(vkeDevice.device(), descriptorPool, 0);
     }
 
+    // *************** Descriptor Allocator *********************
+
+    VkeDescriptorAllocator::VkeDescriptorAllocator(
+        VkeDevice &vkeDevice,
+        std::vector<VkDescriptorPoolSize> poolSizes,
+        uint32_t initialSets,
+        VkDescriptorPoolCreateFlags poolFlags)
+        : vkeDevice{vkeDevice}, poolSizes{std::move(poolSizes)}, poolFlags{poolFlags}, nextPoolSets{std::max(initialSets, 1u)}
+    {
+        addPool();
+    }
+
+    VkeDescriptorPool &VkeDescriptorAllocator::addPool()
+    {
+        std::vector<VkDescriptorPoolSize> scaledSizes = poolSizes;
+        for (auto &poolSize : scaledSizes)
+        {
+            poolSize.descriptorCount *= nextPoolSets;
+        }
+        pools.push_back(std::make_unique<VkeDescriptorPool>(vkeDevice, nextPoolSets, poolFlags, scaledSizes));
+        nextPoolSets = std::min(nextPoolSets * 2, std::max(nextPoolSets, DESCRIPTOR_POOL_MAX_SETS));
+        return *pools.back();
+    }
+
+    VkDescriptorSet VkeDescriptorAllocator::allocate(VkDescriptorSetLayout descriptorSetLayout)
+    {
+        VkDescriptorSet set;
+        // a full pool reports VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL, both move on to the next one
+        for (; currentPool < pools.size(); currentPool++)
+        {
+            if (pools[currentPool]->allocateDescriptor(descriptorSetLayout, set))
+            {
+                allocatedSets++;
+                return set;
+            }
+        }
+        VKE_TRACE_SCOPE("Descriptor pool growth");
+        if (!addPool().allocateDescriptor(descriptorSetLayout, set))
+        {
+            throw std::runtime_error("failed to allocate descriptor set from a new pool!");
+        }
+        allocatedSets++;
+        return set;
+    }
+
+    void VkeDescriptorAllocator::reset()
+    {
+        for (size_t i = 0; i < pools.size() && i <= currentPool; i++)
+        {
+            pools[i]->resetPool();
+        }
+        currentPool = 0;
+        allocatedSets = 0;
+    }
+
     // *************** Descriptor Writer *********************
 
     VkeDescriptorWriter::VkeDescriptorWriter(VkeDescriptorSetLayout &setLayout, VkeDescriptorPool &pool)
-        : setLayout{setLayout}, pool{pool} {}
+        : setLayout{setLayout}, pool{&pool} {}
+
+    VkeDescriptorWriter::VkeDescriptorWriter(VkeDescriptorSetLayout &setLayout, VkeDescriptorAllocator &allocator)
+        : setLayout{setLayout}, allocator{&allocator} {}
 
     VkeDescriptorWriter &VkeDescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo *bufferInfo)
@@ -199,8 +320,11 @@ namespace vke
 
     bool VkeDescriptorWriter::build(VkDescriptorSet &set)
     {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
-        if (!success)
+        if (allocator != nullptr)
+        {
+            set = allocator->allocate(setLayout.getDescriptorSetLayout());
+        }
+        else if (!pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set))
         {
             return false;
         }
@@ -210,11 +334,42 @@ namespace vke
 
     void VkeDescriptorWriter::overwrite(VkDescriptorSet &set)
     {
-        for (auto &write : writes)
+        if (writes.empty())
+        {
+            return;
+        }
+        VkeDevice &vkeDevice = setLayout.vkeDevice;
+        if (vkeDevice.updateDescriptorSetWithTemplate == nullptr)
+        {
+            for (auto &write : writes)
+            {
+                write.dstSet = set;
+            }
+            vkUpdateDescriptorSets(vkeDevice.device(), writes.size(), writes.data(), 0, nullptr);
+            return;
+        }
+
+        uint64_t bindingMask = 0;
+        for (const auto &write : writes)
+        {
+            assert(write.dstBinding < 64 && "Update templates cover bindings 0 to 63");
+            assert((bindingMask & (uint64_t{1} << write.dstBinding)) == 0 && "Binding written twice");
+            bindingMask |= uint64_t{1} << write.dstBinding;
+        }
+        alignas(VkDescriptorBufferInfo) unsigned char data[64 * VkeDescriptorSetLayout::DESCRIPTOR_INFO_STRIDE];
+        for (const auto &write : writes)
         {
-            write.dstSet = set;
+            unsigned char *info = data + bindingsBelow(bindingMask, write.dstBinding) * VkeDescriptorSetLayout::DESCRIPTOR_INFO_STRIDE;
+            if (write.pBufferInfo != nullptr)
+            {
+                std::memcpy(info, write.pBufferInfo, sizeof(VkDescriptorBufferInfo));
+            }
+            else
+            {
+                std::memcpy(info, write.pImageInfo, sizeof(VkDescriptorImageInfo));
+            }
         }
-        vkUpdateDescriptorSets(pool.vkeDevice.device(), writes.size(), writes.data(), 0, nullptr);
+        vkeDevice.updateDescriptorSetWithTemplate(vkeDevice.device(), set, setLayout.getUpdateTemplate(bindingMask), data);
     }
 
 } // namespace lve
\ No newline at end of file
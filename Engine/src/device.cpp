@@ -1,6 +1,12 @@
 #include "device.hpp"
 
+#include "render_stats.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
+#include "upload_queue.hpp"
+
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -63,10 +69,17 @@ namespace vke
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    graphicsTimeline = std::make_unique<VkeTimeline>(*this);
+    uploadQueue = std::make_unique<VkeUploadQueue>(*this);
   }
 
   VkeDevice::~VkeDevice()
   {
+    // waits for the uploads still in flight
+    uploadQueue.reset();
+    graphicsTimeline.reset();
+    vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+    vkDestroyCommandPool(device_, computeCommandPool, nullptr);
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -102,7 +115,6 @@ namespace vke
 #elif defined(__APPLE__) || defined(__MACH__)
     // macOS requires portability extensions
     extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
-    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 #endif
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -173,8 +185,48 @@ namespace vke
   {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // per pass vertex, fragment and clipping counts in the GPU profiler
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    // and for passes recorded into secondary command buffers, which run inside the query
+    deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+    enabledFeatures = deviceFeatures;
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    enabledExtensions = deviceExtensions;
+    for (const char *extension : optionalDeviceExtensions)
+    {
+      bool supported = std::any_of(availableExtensions.begin(), availableExtensions.end(), [extension](const VkExtensionProperties &available)
+                                   { return std::strcmp(available.extensionName, extension) == 0; });
+      if (supported)
+      {
+        enabledExtensions.push_back(extension);
+      }
+    }
+
+    // the extension alone doesn't make timeline semaphores usable, its feature has to be enabled too
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
+    // a single family device such as lavapipe has no other queue to overlap with, compute runs on the graphics queue
+    asyncCompute = indices.computeFamily != indices.graphicsFamily;
+    if (!asyncCompute)
+    {
+      indices.computeFamily = indices.graphicsFamily;
+    }
+    queueFamilyIndices = indices;
+
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily, indices.computeFamily};
+    std::set<uint32_t> uniqueSharedFamilies = {indices.graphicsFamily, indices.transferFamily, indices.computeFamily};
+    sharedQueueFamilies.assign(uniqueSharedFamilies.begin(), uniqueSharedFamilies.end());
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -187,18 +239,16 @@ namespace vke
       queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures = {};
-    deviceFeatures.samplerAnisotropy = VK_TRUE;
-
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &timelineFeatures;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // might not really be necessary anymore because device specific validation layers
     // have been deprecated
@@ -219,6 +269,31 @@ namespace vke
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+    vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
+    dedicatedTransfer = indices.transferFamily != indices.graphicsFamily;
+    std::cout << "dedicated transfer queue: " << (dedicatedTransfer ? "yes" : "no") << std::endl;
+    std::cout << "async compute queue: " << (asyncCompute ? "yes" : "no") << std::endl;
+
+    if (isExtensionEnabled(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME))
+    {
+      createDescriptorUpdateTemplate = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(
+          vkGetDeviceProcAddr(device_, "vkCreateDescriptorUpdateTemplateKHR"));
+      destroyDescriptorUpdateTemplate = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(
+          vkGetDeviceProcAddr(device_, "vkDestroyDescriptorUpdateTemplateKHR"));
+      updateDescriptorSetWithTemplate = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(
+          vkGetDeviceProcAddr(device_, "vkUpdateDescriptorSetWithTemplateKHR"));
+    }
+    waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+        vkGetDeviceProcAddr(device_, "vkWaitSemaphoresKHR"));
+    getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+        vkGetDeviceProcAddr(device_, "vkGetSemaphoreCounterValueKHR"));
+  }
+
+  bool VkeDevice::isExtensionEnabled(const char *extension) const
+  {
+    return std::any_of(enabledExtensions.begin(), enabledExtensions.end(), [extension](const char *enabled)
+                       { return std::strcmp(enabled, extension) == 0; });
   }
 
   void VkeDevice::createCommandPool()
@@ -235,6 +310,21 @@ namespace vke
     {
       throw std::runtime_error("failed to create command pool!");
     }
+
+    poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create transfer command pool!");
+    }
+
+    if (asyncCompute)
+    {
+      poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily;
+      if (vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+      {
+        throw std::runtime_error("failed to create compute command pool!");
+      }
+    }
   }
 
   void VkeDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -256,7 +346,24 @@ namespace vke
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
     return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-           supportedFeatures.samplerAnisotropy;
+           supportedFeatures.samplerAnisotropy && supportsTimelineSemaphores(device);
+  }
+
+  bool VkeDevice::supportsTimelineSemaphores(VkPhysicalDevice device)
+  {
+    auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+    if (getFeatures2 == nullptr)
+    {
+      return false;
+    }
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2KHR features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features2.pNext = &timelineFeatures;
+    getFeatures2(device, &features2);
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
   }
 
   void VkeDevice::populateDebugMessengerCreateInfo(
@@ -327,6 +434,8 @@ namespace vke
     {
       extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
+    // lets the device report extension features, timeline semaphores among them
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
     return extensions;
   }
@@ -423,6 +532,30 @@ namespace vke
       i++;
     }
 
+    // transfer only families copy through DMA engines, next to the graphics work
+    indices.transferFamily = indices.graphicsFamily;
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+      VkQueueFlags flags = queueFamilies[family].queueFlags;
+      if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+          !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      {
+        indices.transferFamily = family;
+        break;
+      }
+    }
+    // compute families without graphics run next to the graphics queue, createLogicalDevice decides if they're used
+    indices.computeFamily = indices.graphicsFamily;
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+      VkQueueFlags flags = queueFamilies[family].queueFlags;
+      if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+      {
+        indices.computeFamily = family;
+        break;
+      }
+    }
+
     return indices;
   }
 
@@ -497,13 +630,20 @@ namespace vke
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory)
+      VkDeviceMemory &bufferMemory,
+      bool concurrent)
   {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (concurrent && sharedQueueFamilies.size() > 1)
+    {
+      bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+      bufferInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+    }
 
     if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
     {
@@ -547,28 +687,35 @@ namespace vke
 
   void VkeDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
   {
+    VKE_TRACE_SCOPE("Single time submit");
     vkEndCommandBuffer(commandBuffer);
 
+    // waits for this submission only, not for the frames in flight
+    VkeSubmitSemaphores semaphores{};
+    uint64_t value = graphicsTimeline->next();
+    semaphores.signal(graphicsTimeline->getSemaphore(), value);
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
+    semaphores.apply(submitInfo);
 
     vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue_);
+    graphicsTimeline->wait(value);
 
     vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
   }
 
-  void VkeDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+  void VkeDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset)
   {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
     VkBufferCopy copyRegion{};
     copyRegion.srcOffset = 0; // Optional
-    copyRegion.dstOffset = 0; // Optional
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    VKE_STAT_ADD(VKE_STAT_STAGING_BYTES, size);
 
     endSingleTimeCommands(commandBuffer);
   }
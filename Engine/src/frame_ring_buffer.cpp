@@ -0,0 +1,56 @@
+#include "frame_ring_buffer.hpp"
+
+#include "render_stats.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vke
+{
+    VkeFrameRingBuffer::VkeFrameRingBuffer(VkeDevice &device, VkDeviceSize capacity)
+    {
+        const VkPhysicalDeviceLimits &limits = device.properties.limits;
+        // both limits are powers of two
+        alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+        frameCapacity = (capacity + alignment - 1) & ~(alignment - 1);
+        // host coherent memory is always available for host visible buffers, writes need no flush.
+        // Concurrent, async compute dispatches read their uniforms from it too.
+        buffer = std::make_unique<VkeBuffer>(
+            device,
+            frameCapacity,
+            MAX_FRAMES_IN_FLIGHT,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            alignment,
+            true);
+        if (buffer->map() != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to map frame ring buffer");
+        }
+        mapped = static_cast<char *>(buffer->getMappedMemory());
+    }
+
+    void VkeFrameRingBuffer::beginFrame(int frameIndex)
+    {
+        assert(frameIndex >= 0 && frameIndex < MAX_FRAMES_IN_FLIGHT && "frame index out of range");
+        frameBegin = frameCapacity * static_cast<VkDeviceSize>(frameIndex);
+        head.store(0, std::memory_order_relaxed);
+    }
+
+    VkeFrameRingBuffer::Allocation VkeFrameRingBuffer::allocate(VkDeviceSize size)
+    {
+        VkDeviceSize alignedSize = (size + alignment - 1) & ~(alignment - 1);
+        VkDeviceSize offset = head.fetch_add(alignedSize, std::memory_order_relaxed);
+        if (offset + alignedSize > frameCapacity)
+        {
+            throw std::runtime_error("frame ring buffer is full, raise FRAME_RING_CAPACITY");
+        }
+        VKE_STAT_ADD(VKE_STAT_BUFFER_WRITE_BYTES, size);
+        Allocation allocation{};
+        allocation.data = mapped + frameBegin + offset;
+        allocation.offset = static_cast<uint32_t>(frameBegin + offset);
+        return allocation;
+    }
+} // namespace vke
@@ -0,0 +1,238 @@
+#include "geometry_arena.hpp"
+
+#include "model.hpp"
+#include "upload_queue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace vke
+{
+    VkeRangeAllocator::VkeRangeAllocator(uint32_t capacity) : freeCount{capacity}
+    {
+        if (capacity > 0)
+        {
+            freeRanges.emplace(0, capacity);
+        }
+    }
+
+    uint32_t VkeRangeAllocator::allocate(uint32_t count)
+    {
+        if (count == 0 || count > freeCount)
+        {
+            return count == 0 ? 0 : NONE;
+        }
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            if (it->second < count)
+            {
+                continue;
+            }
+            uint32_t first = it->first;
+            uint32_t remaining = it->second - count;
+            freeRanges.erase(it);
+            if (remaining > 0)
+            {
+                freeRanges.emplace(first + count, remaining);
+            }
+            freeCount -= count;
+            return first;
+        }
+        return NONE;
+    }
+
+    void VkeRangeAllocator::free(uint32_t first, uint32_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        freeCount += count;
+        auto next = freeRanges.lower_bound(first);
+        assert((next == freeRanges.end() || first + count <= next->first) && "freed range overlaps a free range");
+        if (next != freeRanges.end() && first + count == next->first)
+        {
+            count += next->second;
+            next = freeRanges.erase(next);
+        }
+        if (next != freeRanges.begin())
+        {
+            auto previous = std::prev(next);
+            assert(previous->first + previous->second <= first && "freed range overlaps a free range");
+            if (previous->first + previous->second == first)
+            {
+                previous->second += count;
+                return;
+            }
+        }
+        freeRanges.emplace(first, count);
+    }
+
+    VkeGeometryArena::VkeGeometryArena(VkeDevice &device, uint32_t vertexCapacity, uint32_t indexCapacity)
+        : vkeDevice{device},
+          vertexCapacity{vertexCapacity},
+          indexCapacity{indexCapacity},
+          vertexAllocator{vertexCapacity},
+          indexAllocators{VkeRangeAllocator{indexCapacity}, VkeRangeAllocator{indexCapacity}}
+    {
+        vertexBuffer = std::make_unique<VkeBuffer>(
+            vkeDevice,
+            sizeof(VkeModel::PackedVertex),
+            vertexCapacity,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (VkeModel::hasPositionStreams(vkeDevice))
+        {
+            positionBuffer = std::make_unique<VkeBuffer>(
+                vkeDevice,
+                sizeof(VkeModel::PositionVertex),
+                vertexCapacity,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+#if !VERTEX_FORMAT_COLOR
+        uint32_t white = 0xffffffffu;
+        defaultColorBuffer = std::make_unique<VkeBuffer>(
+            vkeDevice,
+            sizeof(white),
+            1,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        defaultColorBuffer->map();
+        defaultColorBuffer->writeToBuffer(&white);
+        defaultColorBuffer->unmap();
+#endif
+
+        indexBuffers[indexSlot(VK_INDEX_TYPE_UINT16)] = std::make_unique<VkeBuffer>(
+            vkeDevice,
+            sizeof(uint16_t),
+            indexCapacity,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        // the meshlet cull pass reads its source indices straight out of the 32 bit buffer, possibly on
+        // the async compute queue
+        indexBuffers[indexSlot(VK_INDEX_TYPE_UINT32)] = std::make_unique<VkeBuffer>(
+            vkeDevice,
+            sizeof(uint32_t),
+            indexCapacity,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            1,
+            true);
+    }
+    VkeGeometryArena::~VkeGeometryArena()
+    {
+    }
+
+    void VkeGeometryArena::upload(VkeBuffer &buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+    {
+        vkeDevice.getUploadQueue().uploadBuffer(buffer, offset, data, size);
+    }
+
+    VkeGeometryArena &VkeGeometryArena::allocate(uint32_t vertexCount, VkIndexType indexType, uint32_t indexCount, VkeGeometryRange &vertexRange, VkeGeometryRange &indexRange)
+    {
+        uint32_t slot = indexSlot(indexType);
+        uint32_t firstVertex = vertexAllocator.allocate(vertexCount);
+        if (firstVertex != VkeRangeAllocator::NONE)
+        {
+            uint32_t firstIndex = indexAllocators[slot].allocate(indexCount);
+            if (firstIndex != VkeRangeAllocator::NONE)
+            {
+                vertexRange = {firstVertex, vertexCount};
+                indexRange = {firstIndex, indexCount};
+                return *this;
+            }
+            // both ranges have to come from the same arena, the model binds one set of buffers
+            vertexAllocator.free(firstVertex, vertexCount);
+        }
+        if (!next)
+        {
+            next = std::make_unique<VkeGeometryArena>(
+                vkeDevice,
+                std::max(vertexCapacity, vertexCount),
+                std::max(indexCapacity, indexCount));
+        }
+        return next->allocate(vertexCount, indexType, indexCount, vertexRange, indexRange);
+    }
+
+    void VkeGeometryArena::writeVertices(const VkeGeometryRange &range, const void *vertices, const void *positions)
+    {
+        assert((positions != nullptr) == hasPositionStream() && "positions must be given exactly when the arena keeps a position stream");
+        if (range.count == 0)
+        {
+            return;
+        }
+        upload(*vertexBuffer, vertexBuffer->getInstanceSize() * range.first, vertices, vertexBuffer->getInstanceSize() * range.count);
+        if (positionBuffer)
+        {
+            upload(*positionBuffer, positionBuffer->getInstanceSize() * range.first, positions, positionBuffer->getInstanceSize() * range.count);
+        }
+    }
+
+    void VkeGeometryArena::writeIndices(VkIndexType indexType, const VkeGeometryRange &range, const void *indices)
+    {
+        if (range.count == 0)
+        {
+            return;
+        }
+        VkeBuffer &buffer = *indexBuffers[indexSlot(indexType)];
+        upload(buffer, buffer.getInstanceSize() * range.first, indices, buffer.getInstanceSize() * range.count);
+    }
+
+    uint64_t VkeGeometryArena::getUsedVertexCount() const
+    {
+        uint64_t used = vertexCapacity - vertexAllocator.getFreeCount();
+        return next ? used + next->getUsedVertexCount() : used;
+    }
+
+    uint64_t VkeGeometryArena::getUsedIndexCount(VkIndexType indexType) const
+    {
+        uint64_t used = indexCapacity - indexAllocators[indexSlot(indexType)].getFreeCount();
+        return next ? used + next->getUsedIndexCount(indexType) : used;
+    }
+
+    void VkeGeometryArena::freeVertices(const VkeGeometryRange &range)
+    {
+        vertexAllocator.free(range.first, range.count);
+    }
+
+    void VkeGeometryArena::freeIndices(VkIndexType indexType, const VkeGeometryRange &range)
+    {
+        indexAllocators[indexSlot(indexType)].free(range.first, range.count);
+    }
+
+    void VkeGeometryArena::bind(VkCommandBuffer commandBuffer, VkIndexType indexType)
+    {
+#if VERTEX_FORMAT_COLOR
+        VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0};
+#else
+        VkBuffer buffers[] = {vertexBuffer->getBuffer(), defaultColorBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0, 0};
+#endif
+        vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(std::size(buffers)), buffers, offsets);
+        if (indexType != VK_INDEX_TYPE_MAX_ENUM)
+        {
+            bindIndices(commandBuffer, indexType);
+        }
+    }
+
+    void VkeGeometryArena::bindPositions(VkCommandBuffer commandBuffer, VkIndexType indexType)
+    {
+        assert(positionBuffer != nullptr && "arena has no position stream");
+        VkBuffer buffers[] = {positionBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        if (indexType != VK_INDEX_TYPE_MAX_ENUM)
+        {
+            bindIndices(commandBuffer, indexType);
+        }
+    }
+
+    void VkeGeometryArena::bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType)
+    {
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffers[indexSlot(indexType)]->getBuffer(), 0, indexType);
+    }
+} // namespace vke
@@ -0,0 +1,218 @@
+#include "gpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vke
+{
+    namespace
+    {
+        // results come back in flag bit order
+        constexpr uint32_t STATISTIC_COUNT = 3;
+    } // namespace
+
+    VkeGpuProfiler::VkeGpuProfiler(VkeDevice &device) : vkeDevice{device}
+    {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(vkeDevice.getPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(vkeDevice.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+        uint32_t validBits = queueFamilies[vkeDevice.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+        if (validBits == 0)
+        {
+            return;
+        }
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        timestampPeriod = vkeDevice.properties.limits.timestampPeriod;
+
+        if (vkeDevice.getEnabledFeatures().pipelineStatisticsQuery)
+        {
+            statisticFlags = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                             VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                             VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        }
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = GPU_PROFILER_MAX_SCOPES * 2;
+            if (vkCreateQueryPool(vkeDevice.device(), &poolInfo, nullptr, &timestampPool[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create timestamp query pool");
+            }
+            if (statisticFlags != 0)
+            {
+                poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                poolInfo.queryCount = GPU_PROFILER_MAX_SCOPES;
+                poolInfo.pipelineStatistics = statisticFlags;
+                if (vkCreateQueryPool(vkeDevice.device(), &poolInfo, nullptr, &statisticsPool[i]) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create pipeline statistics query pool");
+                }
+            }
+        }
+    }
+    VkeGpuProfiler::~VkeGpuProfiler()
+    {
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vkDestroyQueryPool(vkeDevice.device(), timestampPool[i], nullptr);
+            vkDestroyQueryPool(vkeDevice.device(), statisticsPool[i], nullptr);
+        }
+    }
+
+    void VkeGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+    {
+        currentFrame = frameIndex;
+        openDepth = 0;
+        statisticsOpen = false;
+        if (!isSupported())
+        {
+            return;
+        }
+        collect(frameIndex);
+        frameScopes[frameIndex].clear();
+        statisticsQueryCounts[frameIndex] = 0;
+        vkCmdResetQueryPool(commandBuffer, timestampPool[frameIndex], 0, GPU_PROFILER_MAX_SCOPES * 2);
+        if (statisticsPool[frameIndex] != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(commandBuffer, statisticsPool[frameIndex], 0, GPU_PROFILER_MAX_SCOPES);
+        }
+    }
+
+    uint32_t VkeGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char *name, bool pipelineStatistics)
+    {
+        auto &scopes = frameScopes[currentFrame];
+        if (!isSupported() || scopes.size() == GPU_PROFILER_MAX_SCOPES)
+        {
+            return NO_SCOPE;
+        }
+        uint32_t scope = static_cast<uint32_t>(scopes.size());
+        uint32_t statisticsQuery = NO_SCOPE;
+        if (pipelineStatistics && statisticFlags != 0)
+        {
+            assert(!statisticsOpen && "pipeline statistics scopes can't be nested");
+            statisticsQuery = statisticsQueryCounts[currentFrame]++;
+            statisticsOpen = true;
+        }
+        scopes.push_back({name, openDepth++, statisticsQuery});
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool[currentFrame], scope * 2);
+        if (statisticsQuery != NO_SCOPE)
+        {
+            vkCmdBeginQuery(commandBuffer, statisticsPool[currentFrame], statisticsQuery, 0);
+        }
+        return scope;
+    }
+
+    void VkeGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+    {
+        if (scope == NO_SCOPE)
+        {
+            return;
+        }
+        const Scope &entry = frameScopes[currentFrame][scope];
+        if (entry.statisticsQuery != NO_SCOPE)
+        {
+            vkCmdEndQuery(commandBuffer, statisticsPool[currentFrame], entry.statisticsQuery);
+            statisticsOpen = false;
+        }
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool[currentFrame], scope * 2 + 1);
+        openDepth--;
+    }
+
+    void VkeGpuProfiler::collect(int frameIndex)
+    {
+        const auto &scopes = frameScopes[frameIndex];
+        if (scopes.empty())
+        {
+            return;
+        }
+        // the slot's last frame was waited for, results that are still missing belong to a scope never ended
+        uint32_t timestampCount = static_cast<uint32_t>(scopes.size()) * 2;
+        timestampScratch.resize(timestampCount);
+        if (vkGetQueryPoolResults(vkeDevice.device(), timestampPool[frameIndex], 0, timestampCount,
+                                  timestampScratch.size() * sizeof(uint64_t), timestampScratch.data(), sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        {
+            return;
+        }
+        uint32_t statisticsCount = statisticsQueryCounts[frameIndex];
+        statisticsScratch.resize(statisticsCount * STATISTIC_COUNT);
+        if (statisticsCount > 0 &&
+            vkGetQueryPoolResults(vkeDevice.device(), statisticsPool[frameIndex], 0, statisticsCount,
+                                  statisticsScratch.size() * sizeof(uint64_t), statisticsScratch.data(), STATISTIC_COUNT * sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        {
+            return;
+        }
+
+        results.resize(scopes.size());
+        uint64_t frameBegin = timestampScratch[0];
+        uint64_t frameTicks = 0;
+        for (size_t i = 0; i < scopes.size(); i++)
+        {
+            ScopeResult &result = results[i];
+            result.name = scopes[i].name;
+            result.depth = scopes[i].depth;
+            uint64_t ticks = (timestampScratch[i * 2 + 1] - timestampScratch[i * 2]) & timestampMask;
+            result.milliseconds = static_cast<double>(ticks) * timestampPeriod * 1e-6;
+            // scopes are begun in submission order, so the first one starts the frame
+            frameTicks = std::max(frameTicks, (timestampScratch[i * 2 + 1] - frameBegin) & timestampMask);
+            result.hasStatistics = scopes[i].statisticsQuery != NO_SCOPE;
+            if (result.hasStatistics)
+            {
+                const uint64_t *statistics = &statisticsScratch[scopes[i].statisticsQuery * STATISTIC_COUNT];
+                result.vertexInvocations = statistics[0];
+                result.clippingPrimitives = statistics[1];
+                result.fragmentInvocations = statistics[2];
+            }
+            else
+            {
+                result.vertexInvocations = result.clippingPrimitives = result.fragmentInvocations = 0;
+            }
+        }
+        frameMilliseconds = static_cast<double>(frameTicks) * timestampPeriod * 1e-6;
+        collectedFrames++;
+
+        if (csvFile.is_open())
+        {
+            for (const auto &result : results)
+            {
+                csvFile << collectedFrames << ',' << result.name << ',' << result.depth << ',' << result.milliseconds << ',';
+                if (result.hasStatistics)
+                {
+                    csvFile << result.vertexInvocations << ',' << result.clippingPrimitives << ',' << result.fragmentInvocations;
+                }
+                else
+                {
+                    csvFile << ",,";
+                }
+                csvFile << '\n';
+            }
+        }
+    }
+
+    bool VkeGpuProfiler::startCsvCapture(const std::string &path)
+    {
+        stopCsvCapture();
+        csvFile.open(path, std::ios::out | std::ios::trunc);
+        if (!csvFile.is_open())
+        {
+            return false;
+        }
+        csvFile << "frame,scope,depth,gpu_ms,vertex_invocations,clipping_primitives,fragment_invocations\n";
+        return true;
+    }
+
+    void VkeGpuProfiler::stopCsvCapture()
+    {
+        if (csvFile.is_open())
+        {
+            csvFile.close();
+        }
+    }
+} // namespace vke
@@ -28,7 +28,7 @@ namespace vke
             keyPressed = false;
         }
     }
-    void KeyboardMovementController::moveInPlainXZ(GLFWwindow *window, float dt, VkeGameObject &gameObject)
+    void KeyboardMovementController::moveInPlainXZ(GLFWwindow *window, float dt, TransformComponent &transform)
     {
         if (!cursorEnabled)
         {
@@ -53,14 +53,14 @@ namespace vke
             xoffset *= sensitivity;
             yoffset *= sensitivity;
 
-            gameObject.transform.rotation.y += static_cast<float>(xoffset) * lookSpeed * dt;
-            gameObject.transform.rotation.x += static_cast<float>(yoffset) * lookSpeed * dt;
+            transform.rotation.y += static_cast<float>(xoffset) * lookSpeed * dt;
+            transform.rotation.x += static_cast<float>(yoffset) * lookSpeed * dt;
 
-            gameObject.transform.rotation.x = glm::clamp(gameObject.transform.rotation.x, -1.5f, 1.5f);
-            gameObject.transform.rotation.y = glm::mod(gameObject.transform.rotation.y, glm::two_pi<float>());
+            transform.rotation.x = glm::clamp(transform.rotation.x, -1.5f, 1.5f);
+            transform.rotation.y = glm::mod(transform.rotation.y, glm::two_pi<float>());
         }
 
-        float yaw = gameObject.transform.rotation.y;
+        float yaw = transform.rotation.y;
         const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
         const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
         const glm::vec3 upDir{0.f, 1.f, 0.f};
@@ -81,7 +81,7 @@ namespace vke
 
         if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon())
         {
-            gameObject.transform.translation += glm::normalize(moveDir) * moveSpeed * dt;
+            transform.translation += glm::normalize(moveDir) * moveSpeed * dt;
         }
     }
 
@@ -1,13 +1,24 @@
-#include "settings.hpp"
 #include "app.hpp"
 
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 
-int main()
+int main(int argc, char **argv)
 {
-    vke::App app{};
+    vke::VkeBenchConfig config{};
+    try
+    {
+        config = vke::VkeBenchConfig::parse(argc, argv);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << '\n'
+                  << vke::VkeBenchConfig::usage();
+        return EXIT_FAILURE;
+    }
+
+    vke::App app{config};
 
     try
     {
@@ -0,0 +1,307 @@
+#include "mesh_optimizer.hpp"
+
+#include "settings.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vke
+{
+    namespace
+    {
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+        // LRU size Forsyth's scoring models, larger than the FIFO it is measured against on purpose
+        constexpr int FORSYTH_CACHE_SIZE = 32;
+
+        float vertexScore(int cachePosition, uint32_t remainingTriangles)
+        {
+            if (remainingTriangles == 0)
+            {
+                return -1.f;
+            }
+            float score = 0.f;
+            if (cachePosition >= 0)
+            {
+                // the last triangle's vertices score lower so strips do not run off in one direction
+                score = cachePosition < 3
+                            ? 0.75f
+                            : std::pow(1.f - static_cast<float>(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+            // finish off vertices with few triangles left before they leave the cache
+            return score + 2.f / std::sqrt(static_cast<float>(remainingTriangles));
+        }
+
+        // vertex -> triangles adjacency of an index list
+        void buildAdjacency(const uint32_t *indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t> &offsets, std::vector<uint32_t> &triangles)
+        {
+            offsets.assign(vertexCount + 1, 0);
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                offsets[indices[i] + 1]++;
+            }
+            for (size_t v = 0; v < vertexCount; v++)
+            {
+                offsets[v + 1] += offsets[v];
+            }
+            triangles.resize(indexCount);
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+    } // namespace
+
+    void optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount)
+    {
+        const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+        if (triangleCount < 2)
+        {
+            return;
+        }
+
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> vertexTriangles;
+        buildAdjacency(indices, triangleCount * 3, vertexCount, offsets, vertexTriangles);
+        // the first remaining[v] entries of a vertex's adjacency are its triangles still to emit
+        std::vector<uint32_t> remaining(vertexCount);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            remaining[v] = offsets[v + 1] - offsets[v];
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        uint32_t best = 0;
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+            if (triangleScores[t] > triangleScores[best])
+            {
+                best = t;
+            }
+        }
+
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> result(triangleCount * 3);
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> nextCache;
+        cache.reserve(FORSYTH_CACHE_SIZE + 3);
+        nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+        uint32_t cursor = 0;
+
+        for (uint32_t written = 0; written < triangleCount; written++)
+        {
+            if (best == NONE)
+            {
+                // nothing connected to the cache is left, restart from the next triangle in input order
+                while (emitted[cursor])
+                {
+                    cursor++;
+                }
+                best = cursor;
+            }
+            const uint32_t *triangle = &indices[best * 3];
+            std::copy(triangle, triangle + 3, &result[written * 3]);
+            emitted[best] = 1;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t v = triangle[corner];
+                uint32_t *list = &vertexTriangles[offsets[v]];
+                uint32_t *last = list + remaining[v];
+                uint32_t *found = std::find(list, last, best);
+                if (found != last)
+                {
+                    *found = *(last - 1);
+                    remaining[v]--;
+                }
+            }
+
+            // LRU: the triangle's vertices move to the front, whatever falls past the end is evicted
+            nextCache.clear();
+            for (int corner = 0; corner < 3; corner++)
+            {
+                if (std::find(nextCache.begin(), nextCache.end(), triangle[corner]) == nextCache.end())
+                {
+                    nextCache.push_back(triangle[corner]);
+                }
+            }
+            for (uint32_t v : cache)
+            {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                {
+                    nextCache.push_back(v);
+                }
+            }
+            std::swap(cache, nextCache);
+
+            // rescore every vertex whose cache position changed, evicted ones included
+            for (size_t position = 0; position < cache.size(); position++)
+            {
+                uint32_t v = cache[position];
+                int cachePosition = position < FORSYTH_CACHE_SIZE ? static_cast<int>(position) : -1;
+                float score = vertexScore(cachePosition, remaining[v]);
+                float delta = score - vertexScores[v];
+                vertexScores[v] = score;
+                for (uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; i++)
+                {
+                    triangleScores[vertexTriangles[i]] += delta;
+                }
+            }
+            if (cache.size() > FORSYTH_CACHE_SIZE)
+            {
+                cache.resize(FORSYTH_CACHE_SIZE);
+            }
+
+            // the next triangle is the best one touching the cache
+            best = NONE;
+            float bestScore = -std::numeric_limits<float>::max();
+            for (uint32_t v : cache)
+            {
+                for (uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; i++)
+                {
+                    uint32_t t = vertexTriangles[i];
+                    if (triangleScores[t] > bestScore)
+                    {
+                        best = t;
+                        bestScore = triangleScores[t];
+                    }
+                }
+            }
+        }
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void optimizeOverdraw(uint32_t *indices, size_t indexCount, const std::vector<glm::vec3> &positions)
+    {
+        const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+        if (triangleCount < 2)
+        {
+            return;
+        }
+
+        // a triangle missing the cache on every vertex is where the cache order jumped elsewhere
+        std::vector<uint32_t> clusterStarts{0};
+        std::vector<uint32_t> timestamps(positions.size(), 0);
+        uint32_t time = VERTEX_CACHE_SIZE + 1;
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t v = indices[t * 3 + corner];
+                if (time - timestamps[v] > VERTEX_CACHE_SIZE)
+                {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            if (misses == 3 && t > clusterStarts.back())
+            {
+                clusterStarts.push_back(t);
+            }
+        }
+        clusterStarts.push_back(triangleCount);
+        const size_t clusterCount = clusterStarts.size() - 1;
+        if (clusterCount < 2)
+        {
+            return;
+        }
+
+        // area weighted centroid and facing of every cluster, and the centroid of the whole mesh
+        std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3{0.f});
+        std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3{0.f});
+        glm::vec3 meshCentroid{0.f};
+        float meshArea = 0.f;
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float clusterArea = 0.f;
+            for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+            {
+                const glm::vec3 &a = positions[indices[t * 3]];
+                const glm::vec3 &b = positions[indices[t * 3 + 1]];
+                const glm::vec3 &d = positions[indices[t * 3 + 2]];
+                glm::vec3 normal = glm::cross(b - a, d - a);
+                float area = glm::length(normal);
+                clusterCentroids[c] += (a + b + d) * (area / 3.f);
+                clusterNormals[c] += normal;
+                clusterArea += area;
+            }
+            meshCentroid += clusterCentroids[c];
+            meshArea += clusterArea;
+            if (clusterArea > 0.f)
+            {
+                clusterCentroids[c] = clusterCentroids[c] * (1.f / clusterArea);
+            }
+        }
+        if (meshArea > 0.f)
+        {
+            meshCentroid = meshCentroid * (1.f / meshArea);
+        }
+
+        std::vector<float> sortKeys(clusterCount);
+        std::vector<uint32_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float normalLength = glm::length(clusterNormals[c]);
+            sortKeys[c] = normalLength > 0.f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]) / normalLength : 0.f;
+            order[c] = static_cast<uint32_t>(c);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                         { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(triangleCount * 3);
+        for (uint32_t c : order)
+        {
+            result.insert(result.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+        }
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    std::vector<uint32_t> optimizeVertexFetchRemap(const uint32_t *indices, size_t indexCount, size_t vertexCount)
+    {
+        std::vector<uint32_t> remap(vertexCount, NONE);
+        uint32_t next = 0;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            if (remap[indices[i]] == NONE)
+            {
+                remap[indices[i]] = next++;
+            }
+        }
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            if (remap[v] == NONE)
+            {
+                remap[v] = next++;
+            }
+        }
+        return remap;
+    }
+
+    float computeAcmr(const uint32_t *indices, size_t indexCount, size_t vertexCount)
+    {
+        if (indexCount < 3)
+        {
+            return 0.f;
+        }
+        // a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since it was loaded
+        std::vector<uint32_t> timestamps(vertexCount, 0);
+        uint32_t time = VERTEX_CACHE_SIZE + 1;
+        size_t misses = 0;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t v = indices[i];
+            if (time - timestamps[v] > VERTEX_CACHE_SIZE)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    }
+} // namespace vke
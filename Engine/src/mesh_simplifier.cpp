@@ -0,0 +1,265 @@
+#include "mesh_simplifier.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace vke
+{
+    namespace
+    {
+        // Symmetric 4x4 error matrix of a set of planes, plus the total weight so the error can be
+        // returned as a mean squared distance instead of growing with the number of planes
+        struct Quadric
+        {
+            double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+            double a11 = 0, a12 = 0, a13 = 0;
+            double a22 = 0, a23 = 0;
+            double a33 = 0;
+            double weight = 0;
+
+            static Quadric fromPlane(const glm::dvec3 &normal, double distance, double weight)
+            {
+                Quadric q{};
+                q.a00 = weight * normal.x * normal.x;
+                q.a01 = weight * normal.x * normal.y;
+                q.a02 = weight * normal.x * normal.z;
+                q.a03 = weight * normal.x * distance;
+                q.a11 = weight * normal.y * normal.y;
+                q.a12 = weight * normal.y * normal.z;
+                q.a13 = weight * normal.y * distance;
+                q.a22 = weight * normal.z * normal.z;
+                q.a23 = weight * normal.z * distance;
+                q.a33 = weight * distance * distance;
+                q.weight = weight;
+                return q;
+            }
+            void add(const Quadric &other)
+            {
+                a00 += other.a00, a01 += other.a01, a02 += other.a02, a03 += other.a03;
+                a11 += other.a11, a12 += other.a12, a13 += other.a13;
+                a22 += other.a22, a23 += other.a23;
+                a33 += other.a33;
+                weight += other.weight;
+            }
+            // weighted sum of squared distances from p to the planes
+            double evaluate(const glm::vec3 &p) const
+            {
+                double x = p.x, y = p.y, z = p.z;
+                return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x +
+                       a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+                       a22 * z * z + 2 * a23 * z +
+                       a33;
+            }
+        };
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            // mean squared distance the merged vertex ends up from the planes of both
+            float cost;
+        };
+
+        glm::vec3 triangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+        {
+            return glm::cross(b - a, c - a);
+        }
+    } // namespace
+
+    std::vector<uint32_t> simplifyMesh(
+        const std::vector<glm::vec3> &positions,
+        const std::vector<uint32_t> &indices,
+        size_t targetIndexCount,
+        float maxError,
+        float *resultError)
+    {
+        const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+        std::vector<uint32_t> result = indices;
+        float largestError = 0.f;
+
+        // every edge of a closed surface is used by exactly two triangles, anything else is a border
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(indices.size());
+        auto edgeKey = [](uint32_t a, uint32_t b)
+        { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); };
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                edgeUses[edgeKey(indices[i + e], indices[i + (e + 1) % 3])]++;
+            }
+        }
+        std::vector<uint8_t> locked(vertexCount, 0);
+        for (const auto &[key, uses] : edgeUses)
+        {
+            if (uses != 2)
+            {
+                locked[key >> 32] = 1;
+                locked[key & 0xffffffffu] = 1;
+            }
+        }
+
+        // area weighted plane quadrics of the triangles around each vertex
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            const glm::vec3 &a = positions[indices[i]];
+            glm::dvec3 normal = triangleNormal(a, positions[indices[i + 1]], positions[indices[i + 2]]);
+            double doubleArea = glm::length(normal);
+            if (doubleArea <= 0.0)
+            {
+                continue;
+            }
+            normal /= doubleArea;
+            Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, glm::dvec3(a)), doubleArea * 0.5);
+            for (int corner = 0; corner < 3; corner++)
+            {
+                quadrics[indices[i + corner]].add(plane);
+            }
+        }
+
+        const float maxCost = maxError * maxError;
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+        std::vector<uint32_t> vertexTriangles;
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+
+        // Each pass collapses the cheapest edges it can without two collapses touching the same
+        // triangles, then rewrites the index list. Repeats until the target or error limit is hit.
+        while (result.size() > targetIndexCount)
+        {
+            // vertex -> triangles adjacency of the current index list
+            std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+            for (uint32_t index : result)
+            {
+                triangleOffsets[index + 1]++;
+            }
+            for (uint32_t v = 0; v < vertexCount; v++)
+            {
+                triangleOffsets[v + 1] += triangleOffsets[v];
+            }
+            vertexTriangles.resize(result.size());
+            {
+                std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+                for (uint32_t i = 0; i < result.size(); i++)
+                {
+                    vertexTriangles[cursor[result[i]]++] = i / 3;
+                }
+            }
+
+            // both directions of an interior edge come from its two triangles
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                for (int e = 0; e < 3; e++)
+                {
+                    uint32_t from = result[i + e];
+                    uint32_t to = result[i + (e + 1) % 3];
+                    if (locked[from])
+                    {
+                        continue;
+                    }
+                    Quadric merged = quadrics[from];
+                    merged.add(quadrics[to]);
+                    float cost = merged.weight > 0.0 ? static_cast<float>(std::max(0.0, merged.evaluate(positions[to]) / merged.weight)) : 0.f;
+                    collapses.push_back({from, to, cost});
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b)
+                      { return a.cost < b.cost; });
+
+            for (uint32_t v = 0; v < vertexCount; v++)
+            {
+                remap[v] = v;
+            }
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+            size_t trianglesRemoved = 0;
+            bool collapsedAny = false;
+            for (const Collapse &collapse : collapses)
+            {
+                if (collapse.cost > maxCost || trianglesRemoved >= trianglesToRemove)
+                {
+                    break;
+                }
+                if (touched[collapse.from] || touched[collapse.to])
+                {
+                    continue;
+                }
+
+                // reject collapses that would fold a remaining triangle over
+                bool flips = false;
+                size_t removedHere = 0;
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; t++)
+                {
+                    const uint32_t *triangle = &result[vertexTriangles[t] * 3];
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    {
+                        removedHere++;
+                        continue;
+                    }
+                    glm::vec3 corners[3];
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        corners[corner] = positions[triangle[corner]];
+                    }
+                    glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        if (triangle[corner] == collapse.from)
+                        {
+                            corners[corner] = positions[collapse.to];
+                        }
+                    }
+                    glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+                    flips = glm::dot(before, after) <= 0.f;
+                }
+                if (flips)
+                {
+                    continue;
+                }
+
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+                // the whole one ring is off limits for the rest of the pass, its triangles just changed
+                for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++)
+                {
+                    const uint32_t *triangle = &result[vertexTriangles[t] * 3];
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                }
+                trianglesRemoved += removedHere;
+                largestError = std::max(largestError, collapse.cost);
+                collapsedAny = true;
+            }
+            if (!collapsedAny)
+            {
+                break;
+            }
+
+            // apply the pass and drop the triangles that lost an edge
+            size_t writeIndex = 0;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                uint32_t a = remap[result[i]];
+                uint32_t b = remap[result[i + 1]];
+                uint32_t c = remap[result[i + 2]];
+                if (a != b && b != c && c != a)
+                {
+                    result[writeIndex++] = a;
+                    result[writeIndex++] = b;
+                    result[writeIndex++] = c;
+                }
+            }
+            result.resize(writeIndex);
+        }
+
+        if (resultError != nullptr)
+        {
+            *resultError = std::sqrt(largestError);
+        }
+        return result;
+    }
+} // namespace vke
@@ -0,0 +1,244 @@
+#include "meshlet.hpp"
+
+#include "bounds.hpp"
+#include "settings.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vke
+{
+    namespace
+    {
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+        // bounding sphere around the box of the used vertices, and the normal cone of meshoptimizer's
+        // meshopt_computeMeshletBounds: axis is the mean facing, apex sits behind every triangle plane
+        void computeMeshletBounds(const std::vector<glm::vec3> &positions, const uint32_t *indices, VkeMeshlet &meshlet)
+        {
+            VkeAabb box{};
+            for (uint32_t i = 0; i < meshlet.indexCount; i++)
+            {
+                box.grow(positions[indices[i]]);
+            }
+            glm::vec3 center = box.center();
+            float radius = 0.f;
+            for (uint32_t i = 0; i < meshlet.indexCount; i++)
+            {
+                radius = std::max(radius, glm::length(positions[indices[i]] - center));
+            }
+            meshlet.boundingSphere = glm::vec4(center, radius);
+            meshlet.coneApex = glm::vec4(center, 0.f);
+            meshlet.cone = glm::vec4(0.f, 0.f, 0.f, 2.f);
+
+            auto unitNormal = [&](uint32_t triangle, glm::vec3 &normal)
+            {
+                const glm::vec3 &a = positions[indices[triangle * 3]];
+                normal = glm::cross(positions[indices[triangle * 3 + 1]] - a, positions[indices[triangle * 3 + 2]] - a);
+                float length = glm::length(normal);
+                if (length <= 0.f)
+                {
+                    return false;
+                }
+                normal /= length;
+                return true;
+            };
+
+            const uint32_t triangleCount = meshlet.indexCount / 3;
+            glm::vec3 axis{0.f};
+            glm::vec3 normal;
+            for (uint32_t t = 0; t < triangleCount; t++)
+            {
+                if (unitNormal(t, normal))
+                {
+                    axis += normal;
+                }
+            }
+            float axisLength = glm::length(axis);
+            if (axisLength <= 0.f)
+            {
+                return;
+            }
+            axis /= axisLength;
+
+            float minDot = 1.f;
+            for (uint32_t t = 0; t < triangleCount; t++)
+            {
+                if (unitNormal(t, normal))
+                {
+                    minDot = std::min(minDot, glm::dot(normal, axis));
+                }
+            }
+            // a cone this wide, or wider than a hemisphere, is almost never entirely backfacing
+            if (minDot <= 0.1f)
+            {
+                meshlet.cone = glm::vec4(axis, 2.f);
+                return;
+            }
+
+            // pull the apex back along the axis until every triangle plane is in front of it
+            float maxT = 0.f;
+            for (uint32_t t = 0; t < triangleCount; t++)
+            {
+                if (unitNormal(t, normal))
+                {
+                    float offset = glm::dot(center - positions[indices[t * 3]], normal) / glm::dot(axis, normal);
+                    maxT = std::max(maxT, offset);
+                }
+            }
+            meshlet.coneApex = glm::vec4(center - axis * maxT, 0.f);
+            meshlet.cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+        }
+    } // namespace
+
+    std::vector<uint32_t> buildMeshlets(
+        const std::vector<glm::vec3> &positions,
+        const std::vector<uint32_t> &indices,
+        std::vector<VkeMeshlet> &meshlets)
+    {
+        const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        meshlets.clear();
+        std::vector<uint32_t> result;
+        result.reserve(triangleCount * 3);
+
+        // vertex -> triangles adjacency
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+        for (uint32_t i = 0; i < triangleCount * 3; i++)
+        {
+            triangleOffsets[indices[i] + 1]++;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        }
+        std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+        {
+            std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (uint32_t i = 0; i < triangleCount * 3; i++)
+            {
+                vertexTriangles[cursor[indices[i]]++] = i / 3;
+            }
+        }
+
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        // meshlet that last took each vertex, so membership needs no clearing between meshlets
+        std::vector<uint32_t> vertexMeshlet(vertexCount, NONE);
+        // unemitted triangles sharing a vertex with the current meshlet, may hold duplicates
+        std::vector<uint32_t> candidates;
+        VkeMeshlet current{};
+        uint32_t currentVertexCount = 0;
+        uint32_t nextSeed = NONE;
+        uint32_t seedCursor = 0;
+
+        auto newVertexCount = [&](uint32_t triangle)
+        {
+            const uint32_t *corners = &indices[triangle * 3];
+            const uint32_t id = static_cast<uint32_t>(meshlets.size());
+            uint32_t count = vertexMeshlet[corners[0]] != id;
+            count += vertexMeshlet[corners[1]] != id && corners[1] != corners[0];
+            count += vertexMeshlet[corners[2]] != id && corners[2] != corners[0] && corners[2] != corners[1];
+            return count;
+        };
+        auto emit = [&](uint32_t triangle)
+        {
+            const uint32_t id = static_cast<uint32_t>(meshlets.size());
+            emitted[triangle] = 1;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                if (vertexMeshlet[v] == id)
+                {
+                    continue;
+                }
+                vertexMeshlet[v] = id;
+                currentVertexCount++;
+                for (uint32_t t = triangleOffsets[v]; t < triangleOffsets[v + 1]; t++)
+                {
+                    if (!emitted[vertexTriangles[t]])
+                    {
+                        candidates.push_back(vertexTriangles[t]);
+                    }
+                }
+            }
+        };
+        auto finish = [&]()
+        {
+            current.indexCount = static_cast<uint32_t>(result.size()) - current.firstIndex;
+            computeMeshletBounds(positions, &result[current.firstIndex], current);
+            meshlets.push_back(current);
+            current = VkeMeshlet{};
+            current.firstIndex = static_cast<uint32_t>(result.size());
+            currentVertexCount = 0;
+            // continue from the frontier so neighbouring meshlets stay spatially close
+            nextSeed = NONE;
+            while (!candidates.empty() && nextSeed == NONE)
+            {
+                if (!emitted[candidates.back()])
+                {
+                    nextSeed = candidates.back();
+                }
+                candidates.pop_back();
+            }
+            candidates.clear();
+        };
+
+        while (result.size() < triangleCount * 3)
+        {
+            // the candidate adding the fewest vertices keeps the meshlet compact
+            uint32_t best = NONE;
+            uint32_t bestNew = 4;
+            for (size_t i = 0; i < candidates.size();)
+            {
+                uint32_t triangle = candidates[i];
+                if (emitted[triangle])
+                {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                uint32_t added = newVertexCount(triangle);
+                if (added < bestNew)
+                {
+                    best = triangle;
+                    bestNew = added;
+                }
+                i++;
+            }
+
+            if (best == NONE)
+            {
+                // start of a meshlet, or the current one ran out of connected triangles
+                if (current.firstIndex != result.size())
+                {
+                    finish();
+                }
+                if (nextSeed == NONE || emitted[nextSeed])
+                {
+                    while (emitted[seedCursor])
+                    {
+                        seedCursor++;
+                    }
+                    nextSeed = seedCursor;
+                }
+                best = nextSeed;
+                nextSeed = NONE;
+            }
+            else if (currentVertexCount + bestNew > MESHLET_MAX_VERTICES ||
+                     (result.size() - current.firstIndex) / 3 >= MESHLET_MAX_TRIANGLES)
+            {
+                finish();
+                continue;
+            }
+            emit(best);
+        }
+        if (current.firstIndex != result.size())
+        {
+            finish();
+        }
+        return result;
+    }
+} // namespace vke
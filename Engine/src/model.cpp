@@ -1,77 +1,113 @@
 #include "model.hpp"
 
-#include "utils.hpp"
+#include "mesh_optimizer.hpp"
+#include "render_stats.hpp"
+#include "settings.hpp"
+#include "trace.hpp"
+#include "upload_queue.hpp"
 
 // libs
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/packing.hpp>
 
 // std
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <cassert>
 #include <iostream>
-#include <unordered_map>
-
-namespace std
-{
-    // hash function for Vertex to check for duplicates
-    template <>
-    struct hash<vke::VkeModel::Vertex>
-    {
-        size_t operator()(vke::VkeModel::Vertex const &vertex) const
-        {
-            size_t seed = 0;
-            lve::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-            return seed;
-        }
-    };
-}
+#include <limits>
 
 namespace vke
 {
-    VkeModel::VkeModel(VkeDevice &device, const std::string &filepath) : vkeDevice{device}
+    VkeModel::VkeModel(VkeDevice &device, VkeGeometryArena &geometryArena, const std::string &filepath) : vkeDevice{device}, geometryArena{&geometryArena}, sourcePath{filepath}
     {
+        VKE_TRACE_SCOPE("Load model");
         Builder builder{};
         builder.loadModels(filepath);
         std::cout << "Model loaded from file: " << filepath << std::endl;
+        create(builder);
+    }
+    VkeModel::VkeModel(VkeDevice &device, VkeGeometryArena &geometryArena, Builder builder) : vkeDevice{device}, geometryArena{&geometryArena}
+    {
+        create(builder);
+    }
+    void VkeModel::create(Builder &builder)
+    {
+        VKE_TRACE_SCOPE("Create model");
+        float loadedAcmr = computeAcmr(builder.indices.data(), builder.indices.size(), builder.vertices.size());
+        builder.optimize();
+        builder.buildMeshlets();
+        builder.generateLods();
         std::cout << "Vertex count:" << builder.vertices.size() << std::endl;
+        std::cout << "LOD count:" << builder.lods.size() << std::endl;
+        std::cout << "Meshlet count:" << builder.meshlets.size() << std::endl;
+        if (!builder.lods.empty())
+        {
+            std::cout << "ACMR:" << loadedAcmr << " -> " << computeAcmr(builder.indices.data(), builder.lods[0].indexCount, builder.vertices.size()) << std::endl;
+        }
+        for (const auto &vertex : builder.vertices)
+        {
+            bounds.grow(vertex.position);
+        }
+        meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+        // the meshlet cull pass reads and writes 32 bit indices
+        if (builder.vertices.size() <= std::numeric_limits<uint16_t>::max() && meshletCount == 0)
+        {
+            indexType = VK_INDEX_TYPE_UINT16;
+        }
+        // the arena of the chain that had room for both
+        geometryArena = &geometryArena->allocate(
+            static_cast<uint32_t>(builder.vertices.size()),
+            indexType,
+            static_cast<uint32_t>(builder.indices.size()),
+            vertexRange,
+            indexRange);
         createVertexBuffers(builder.vertices);
+        // the meshlets depend on where the indices were placed
         createIndexBuffers(builder.indices);
+        createMeshletBuffers(builder.meshlets);
+        lods = builder.lods;
+        if (lods.empty())
+        {
+            lods.push_back({0, indexCount, 0.f});
+        }
     }
     VkeModel::~VkeModel()
     {
+        geometryArena->freeVertices(vertexRange);
+        if (hasIndexBuffer)
+        {
+            geometryArena->freeIndices(indexType, indexRange);
+        }
     }
 
     void VkeModel::createVertexBuffers(const std::vector<Vertex> &vertices)
     {
         vertexCount = static_cast<uint32_t>(vertices.size());
         assert(vertexCount >= 3 && "vertex count must be at least 3");
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-
-        uint32_t vertexSize = sizeof(vertices[0]);
-
-        // this is staging buffer that allocates memory on the CPU
-        VkeBuffer stagingBuffer{vkeDevice,
-                                vertexSize,
-                                vertexCount,
-                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-        // map the memory to the CPU
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *)vertices.data());
-
-        // actual vertex buffer on the GPU
-        vertexBuffer = std::make_unique<VkeBuffer>(
-            vkeDevice,
-            vertexSize,
-            vertexCount,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-        // copy the data from the staging buffer to the vertex buffer
-        vkeDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        std::vector<PackedVertex> packedVertices(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++)
+        {
+            packedVertices[i] = PackedVertex::pack(vertices[i], bounds);
+        }
+#if VERTEX_FORMAT_COMPACT
+        positionDecodeMatrix = glm::scale(glm::translate(glm::mat4{1.f}, bounds.min), bounds.extent());
+#endif
+        std::vector<PositionVertex> positions{};
+        if (geometryArena->hasPositionStream())
+        {
+            positions.resize(vertexCount);
+            for (uint32_t i = 0; i < vertexCount; i++)
+            {
+#if VERTEX_FORMAT_COMPACT
+                std::memcpy(positions[i].position, packedVertices[i].position, sizeof(positions[i].position));
+#else
+                positions[i].position = packedVertices[i].position;
+#endif
+            }
+        }
+        geometryArena->writeVertices(vertexRange, packedVertices.data(), positions.empty() ? nullptr : positions.data());
     }
     void VkeModel::createIndexBuffers(const std::vector<uint32_t> &indices)
     {
@@ -83,123 +119,223 @@ namespace vke
         {
             return;
         }
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-        uint32_t indexSize = sizeof(indices[0]);
-
-        VkeBuffer stagingBuffer{vkeDevice,
-                                indexSize,
-                                indexCount,
-                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *)indices.data());
+        std::vector<uint16_t> narrowIndices{};
+        if (indexType == VK_INDEX_TYPE_UINT16)
+        {
+            narrowIndices.assign(indices.begin(), indices.end());
+        }
+        const void *indexData = indexType == VK_INDEX_TYPE_UINT16 ? static_cast<const void *>(narrowIndices.data()) : indices.data();
+        geometryArena->writeIndices(indexType, indexRange, indexData);
+    }
+    void VkeModel::createMeshletBuffers(const std::vector<VkeMeshlet> &builderMeshlets)
+    {
+        if (meshletCount == 0)
+        {
+            return;
+        }
+        std::vector<VkeMeshlet> meshlets = builderMeshlets;
+        for (auto &meshlet : meshlets)
+        {
+            meshlet.firstIndex += indexRange.first;
+        }
+        uint32_t meshletSize = sizeof(meshlets[0]);
 
-        indexBuffer = std::make_unique<VkeBuffer>(
+        // read by the meshlet cull pass, which may run on the async compute queue
+        meshletBuffer = std::make_unique<VkeBuffer>(
             vkeDevice,
-            indexSize,
-            indexCount,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            meshletSize,
+            meshletCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            1,
+            true);
 
-        vkeDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+        vkeDevice.getUploadQueue().uploadBuffer(*meshletBuffer, 0, meshlets.data(), static_cast<VkDeviceSize>(meshletSize) * meshletCount);
     }
     void VkeModel::bind(VkCommandBuffer commandBuffer)
     {
-        VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        geometryArena->bind(commandBuffer, hasIndexBuffer ? indexType : VK_INDEX_TYPE_MAX_ENUM);
+    }
+    void VkeModel::bindPositions(VkCommandBuffer commandBuffer)
+    {
+        geometryArena->bindPositions(commandBuffer, hasIndexBuffer ? indexType : VK_INDEX_TYPE_MAX_ENUM);
+    }
+    void VkeModel::bindIndices(VkCommandBuffer commandBuffer)
+    {
         if (hasIndexBuffer)
         {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            geometryArena->bindIndices(commandBuffer, indexType);
         }
     }
-    void VkeModel::draw(VkCommandBuffer commandBuffer)
+    void VkeModel::draw(VkCommandBuffer commandBuffer, uint32_t lod)
     {
         if (hasIndexBuffer)
         {
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+            vkCmdDrawIndexed(commandBuffer, lods[lod].indexCount, 1, indexRange.first + lods[lod].firstIndex, getVertexOffset(), 0);
+            VKE_STAT_ADD(VKE_STAT_TRIANGLES, lods[lod].indexCount / 3);
         }
         else
         {
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+            vkCmdDraw(commandBuffer, vertexCount, 1, vertexRange.first, 0);
+            VKE_STAT_ADD(VKE_STAT_TRIANGLES, vertexCount / 3);
         }
+        VKE_STAT_ADD(VKE_STAT_DRAW_CALLS, 1);
     }
 
-    std::vector<VkVertexInputBindingDescription> VkeModel::Vertex::getBindingDescriptions()
+    namespace
     {
-        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-        bindingDescriptions[0].binding = 0;
-        bindingDescriptions[0].stride = sizeof(Vertex);
-        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescriptions;
-    }
-    std::vector<VkVertexInputAttributeDescription> VkeModel::Vertex::getAttributeDescriptions()
-    {
-        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-
-        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-        attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-        attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-        attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
+        // largest axis scale, errors are measured in object space
+        float getMaxAxisScale(const glm::mat4 &worldMatrix)
+        {
+            return std::max({glm::length(glm::vec3(worldMatrix[0])),
+                             glm::length(glm::vec3(worldMatrix[1])),
+                             glm::length(glm::vec3(worldMatrix[2]))});
+        }
+    } // namespace
 
-        return attributeDescriptions;
-    }
-    void VkeModel::Builder::loadModels(const std::string &filepath)
+    uint32_t VkeModel::selectLod(const glm::mat4 &worldMatrix, const glm::vec3 &cameraPosition, float pixelScale, float maxErrorPixels) const
     {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn;
-        std::string err;
+        if (lods.size() == 1)
+        {
+            return 0;
+        }
+        float scale = getMaxAxisScale(worldMatrix);
+        glm::vec3 center = glm::vec3(worldMatrix * glm::vec4(bounds.center(), 1.f));
+        float radius = glm::length(bounds.extent()) * 0.5f * scale;
+        // from the nearest point of the bounding sphere, and never treat the camera as inside it
+        float distance = std::max(glm::length(center - cameraPosition) - radius, 1e-3f);
+        return selectLodForPixels(scale * pixelScale / distance, maxErrorPixels);
+    }
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+    uint32_t VkeModel::selectLodOrthographic(const glm::mat4 &worldMatrix, float pixelsPerUnit, float maxErrorPixels) const
+    {
+        if (lods.size() == 1)
         {
-            throw std::runtime_error(warn + err);
+            return 0;
         }
+        return selectLodForPixels(getMaxAxisScale(worldMatrix) * pixelsPerUnit, maxErrorPixels);
+    }
 
-        vertices.clear();
-        indices.clear();
+    uint32_t VkeModel::selectLodForPixels(float pixelsPerUnit, float maxErrorPixels) const
+    {
+        uint32_t lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= maxErrorPixels)
+        {
+            lod++;
+        }
+        return lod;
+    }
 
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-        for (const auto &shape : shapes)
+    namespace
+    {
+        // octahedral projection of a unit vector onto [-1, 1]^2, the lower hemisphere folded over the diagonals
+        glm::vec2 octahedralEncode(const glm::vec3 &normal)
         {
-            for (const auto &index : shape.mesh.indices)
+            float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+            if (length <= 0.f)
+            {
+                return glm::vec2{0.f};
+            }
+            glm::vec3 n = normal / length;
+            glm::vec2 encoded{n.x, n.y};
+            if (n.z < 0.f)
             {
-                Vertex vertex{};
-                if (index.vertex_index >= 0)
-                {
-                    vertex.position = {
-                        attrib.vertices[3 * index.vertex_index + 0],
-                        attrib.vertices[3 * index.vertex_index + 1],
-                        attrib.vertices[3 * index.vertex_index + 2]};
-                    vertex.color = {
-                        attrib.colors[3 * index.vertex_index + 0],
-                        attrib.colors[3 * index.vertex_index + 1],
-                        attrib.colors[3 * index.vertex_index + 2]};
-                }
-                if (index.normal_index >= 0)
-                {
-                    vertex.normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2]};
-                }
-                if (index.texcoord_index >= 0)
-                {
-                    vertex.uv = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        attrib.texcoords[2 * index.texcoord_index + 1],
-                    };
-                }
-
-                if (uniqueVertices.count(vertex) == 0)
-                {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
-                indices.push_back(uniqueVertices[vertex]);
+                encoded = glm::vec2{(1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+                                    (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f)};
             }
+            return encoded;
         }
+    } // namespace
+
+    VkeModel::PackedVertex VkeModel::PackedVertex::pack(const Vertex &vertex, const VkeAabb &bounds)
+    {
+        PackedVertex packed{};
+        glm::vec2 normal = octahedralEncode(vertex.normal);
+#if VERTEX_FORMAT_COMPACT
+        glm::vec3 extent = bounds.extent();
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float t = extent[axis] > 0.f ? (vertex.position[axis] - bounds.min[axis]) / extent[axis] : 0.f;
+            packed.position[axis] = static_cast<uint16_t>(std::round(glm::clamp(t, 0.f, 1.f) * 65535.f));
+        }
+        packed.position[3] = 0;
+        uint32_t packedNormal = glm::packSnorm2x16(normal);
+        std::memcpy(packed.normal, &packedNormal, sizeof(packedNormal));
+        packed.uv = glm::packHalf2x16(vertex.uv);
+#if VERTEX_FORMAT_COLOR
+        packed.color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.f));
+#endif
+#else
+        packed.position = vertex.position;
+        packed.normal = normal;
+        packed.uv = vertex.uv;
+#if VERTEX_FORMAT_COLOR
+        packed.color = vertex.color;
+#endif
+#endif
+        return packed;
+    }
+
+    std::vector<VkVertexInputBindingDescription> VkeModel::PackedVertex::getBindingDescriptions()
+    {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+        bindingDescriptions.push_back({0, sizeof(PackedVertex), VK_VERTEX_INPUT_RATE_VERTEX});
+#if !VERTEX_FORMAT_COLOR
+        // zero stride, every vertex reads the model's single default color
+        bindingDescriptions.push_back({1, 0, VK_VERTEX_INPUT_RATE_VERTEX});
+#endif
+        return bindingDescriptions;
+    }
+    std::vector<VkVertexInputAttributeDescription> VkeModel::PackedVertex::getAttributeDescriptions()
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+#if VERTEX_FORMAT_COMPACT
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedVertex, position)});
+        attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)});
+        attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv)});
+#if VERTEX_FORMAT_COLOR
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color)});
+#endif
+#else
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedVertex, position)});
+        attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(PackedVertex, normal)});
+        attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(PackedVertex, uv)});
+#if VERTEX_FORMAT_COLOR
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedVertex, color)});
+#endif
+#endif
+#if !VERTEX_FORMAT_COLOR
+        attributeDescriptions.push_back({1, 1, VK_FORMAT_R8G8B8A8_UNORM, 0});
+#endif
+
+        return attributeDescriptions;
+    }
+    VkFormat VkeModel::PositionVertex::getFormat()
+    {
+#if VERTEX_FORMAT_COMPACT
+        return VK_FORMAT_R16G16B16_UNORM;
+#else
+        return VK_FORMAT_R32G32B32_SFLOAT;
+#endif
+    }
+    std::vector<VkVertexInputBindingDescription> VkeModel::PositionVertex::getBindingDescriptions()
+    {
+        return {{0, sizeof(PositionVertex), VK_VERTEX_INPUT_RATE_VERTEX}};
+    }
+    std::vector<VkVertexInputAttributeDescription> VkeModel::PositionVertex::getAttributeDescriptions()
+    {
+        return {{0, 0, getFormat(), offsetof(PositionVertex, position)}};
+    }
+
+    bool VkeModel::hasPositionStreams(VkeDevice &device)
+    {
+#if SHADOW_POSITION_STREAM
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), PositionVertex::getFormat(), &formatProperties);
+        return (formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+#else
+        return false;
+#endif
     }
 }
\ No newline at end of file
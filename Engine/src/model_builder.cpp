@@ -0,0 +1,256 @@
+#include "model.hpp"
+
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "settings.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+
+// libs
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+// VkeModel::Builder only touches the CPU side of a model, kept apart from model.cpp so the
+// microbenchmarks can link it without a device.
+
+namespace std
+{
+    size_t hash<vke::VkeModel::Vertex>::operator()(vke::VkeModel::Vertex const &vertex) const
+    {
+        size_t seed = 0;
+        lve::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+        return seed;
+    }
+}
+
+namespace vke
+{
+    void VkeModel::Builder::loadModels(const std::string &filepath)
+    {
+        VKE_TRACE_SCOPE("Parse OBJ");
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn;
+        std::string err;
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+        {
+            throw std::runtime_error(warn + err);
+        }
+
+        vertices.clear();
+        indices.clear();
+
+        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+        for (const auto &shape : shapes)
+        {
+            for (const auto &index : shape.mesh.indices)
+            {
+                Vertex vertex{};
+                if (index.vertex_index >= 0)
+                {
+                    vertex.position = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2]};
+                    vertex.color = {
+                        attrib.colors[3 * index.vertex_index + 0],
+                        attrib.colors[3 * index.vertex_index + 1],
+                        attrib.colors[3 * index.vertex_index + 2]};
+                }
+                if (index.normal_index >= 0)
+                {
+                    vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]};
+                }
+                if (index.texcoord_index >= 0)
+                {
+                    vertex.uv = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        attrib.texcoords[2 * index.texcoord_index + 1],
+                    };
+                }
+
+                if (uniqueVertices.count(vertex) == 0)
+                {
+                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                    vertices.push_back(vertex);
+                }
+                indices.push_back(uniqueVertices[vertex]);
+            }
+        }
+    }
+    void VkeModel::Builder::optimize()
+    {
+        VKE_TRACE_SCOPE("Optimize mesh");
+        if (indices.empty())
+        {
+            return;
+        }
+
+        // Weld: the loader only merges bit identical vertices. Candidates are found through a hash of
+        // epsilon sized cells, checking the neighbouring cells too since close vertices may straddle one.
+        VkeAabb meshBounds{};
+        for (const auto &vertex : vertices)
+        {
+            meshBounds.grow(vertex.position);
+        }
+        float positionEpsilon = glm::length(meshBounds.extent()) * VERTEX_WELD_EPSILON;
+        if (positionEpsilon > 0.f)
+        {
+            auto cellOf = [&](float coordinate)
+            { return static_cast<int64_t>(std::floor(coordinate / positionEpsilon)); };
+            auto cellKey = [](int64_t x, int64_t y, int64_t z)
+            { return static_cast<uint64_t>(x * 73856093) ^ static_cast<uint64_t>(y * 19349663) ^ static_cast<uint64_t>(z * 83492791); };
+            auto close = [](const float *a, const float *b, int count, float epsilon)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    if (std::abs(a[i] - b[i]) > epsilon)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            auto matches = [&](const Vertex &a, const Vertex &b)
+            {
+                return close(&a.position.x, &b.position.x, 3, positionEpsilon) &&
+                       close(&a.normal.x, &b.normal.x, 3, VERTEX_WELD_EPSILON) &&
+                       close(&a.uv.x, &b.uv.x, 2, VERTEX_WELD_EPSILON) &&
+                       close(&a.color.x, &b.color.x, 3, VERTEX_WELD_EPSILON);
+            };
+
+            std::unordered_multimap<uint64_t, uint32_t> cells;
+            cells.reserve(vertices.size());
+            std::vector<Vertex> welded;
+            std::vector<uint32_t> remap(vertices.size());
+            for (uint32_t v = 0; v < vertices.size(); v++)
+            {
+                const Vertex &vertex = vertices[v];
+                int64_t x = cellOf(vertex.position.x), y = cellOf(vertex.position.y), z = cellOf(vertex.position.z);
+                uint32_t match = std::numeric_limits<uint32_t>::max();
+                for (int64_t dx = -1; dx <= 1 && match == std::numeric_limits<uint32_t>::max(); dx++)
+                {
+                    for (int64_t dy = -1; dy <= 1 && match == std::numeric_limits<uint32_t>::max(); dy++)
+                    {
+                        for (int64_t dz = -1; dz <= 1 && match == std::numeric_limits<uint32_t>::max(); dz++)
+                        {
+                            auto range = cells.equal_range(cellKey(x + dx, y + dy, z + dz));
+                            for (auto it = range.first; it != range.second; ++it)
+                            {
+                                if (matches(welded[it->second], vertex))
+                                {
+                                    match = it->second;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+                if (match == std::numeric_limits<uint32_t>::max())
+                {
+                    match = static_cast<uint32_t>(welded.size());
+                    welded.push_back(vertex);
+                    cells.emplace(cellKey(x, y, z), match);
+                }
+                remap[v] = match;
+            }
+            for (auto &index : indices)
+            {
+                index = remap[index];
+            }
+            vertices = std::move(welded);
+        }
+
+        optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].position;
+        }
+        optimizeOverdraw(indices.data(), indices.size(), positions);
+
+        std::vector<uint32_t> remap = optimizeVertexFetchRemap(indices.data(), indices.size(), vertices.size());
+        std::vector<Vertex> reordered(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            reordered[remap[v]] = vertices[v];
+        }
+        vertices = std::move(reordered);
+        for (auto &index : indices)
+        {
+            index = remap[index];
+        }
+    }
+    void VkeModel::Builder::buildMeshlets()
+    {
+        VKE_TRACE_SCOPE("Build meshlets");
+        meshlets.clear();
+        size_t fullDetailCount = lods.empty() ? indices.size() : lods[0].indexCount;
+        if (fullDetailCount / 3 < MESHLET_MIN_TRIANGLES)
+        {
+            return;
+        }
+
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].position;
+        }
+        std::vector<uint32_t> fullDetail(indices.begin(), indices.begin() + fullDetailCount);
+        std::vector<uint32_t> reordered = vke::buildMeshlets(positions, fullDetail, meshlets);
+        std::copy(reordered.begin(), reordered.end(), indices.begin());
+    }
+    void VkeModel::Builder::generateLods()
+    {
+        VKE_TRACE_SCOPE("Generate LODs");
+        lods.clear();
+        if (indices.empty())
+        {
+            return;
+        }
+        lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.f});
+
+        std::vector<glm::vec3> positions(vertices.size());
+        VkeAabb meshBounds{};
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].position;
+            meshBounds.grow(positions[i]);
+        }
+        float maxError = glm::length(meshBounds.extent()) * LOD_MAX_ERROR_RATIO;
+
+        // each level halves the previous one, its error adds up with the error already introduced
+        std::vector<uint32_t> source(indices.begin(), indices.end());
+        while (lods.size() < MAX_LOD_COUNT)
+        {
+            float remainingError = maxError - lods.back().error;
+            float error = 0.f;
+            std::vector<uint32_t> simplified = simplifyMesh(positions, source, source.size() / 6 * 3, remainingError, &error);
+            // stop once simplification stalls on locked borders or the error budget
+            if (simplified.size() > source.size() * 9 / 10)
+            {
+                break;
+            }
+            lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), lods.back().error + error});
+            source = std::move(simplified);
+            // collapses leave holes in the cache order of the level they started from
+            std::vector<uint32_t> ordered = source;
+            optimizeVertexCache(ordered.data(), ordered.size(), vertices.size());
+            indices.insert(indices.end(), ordered.begin(), ordered.end());
+        }
+    }
+}
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 #include "texture.hpp"
 #include "model.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
 
 #include "memory"
 #include <unordered_map>
@@ -10,97 +10,86 @@
 
 namespace vke
 {
-    ObjectManager::ObjectManager(VkeDevice &vkeDevice) : vkeDevice(vkeDevice)
+    ObjectManager::ObjectManager(VkeDevice &vkeDevice, VkeGeometryArena &geometryArena) : vkeDevice(vkeDevice), geometryArena(geometryArena)
     {
     }
     ObjectManager &ObjectManager::addModel(const std::string &filepath)
     {
-        currentModel = std::make_unique<VkeModel>(vkeDevice, filepath);
+        currentModelPath = filepath;
         return *this;
     }
     ObjectManager &ObjectManager::addTexture(const std::string &filepath, TextureType type)
     {
-        if (type == TextureType::VKE_TEXTURE_TYPE_ALBEDO)
-        {
-            currentAlbedo = std::make_unique<VkeTexture>(vkeDevice, filepath);
-        }
-        else if (type == TextureType::VKE_TEXTURE_TYPE_NORMAL)
-        {
-            currentNormal = std::make_unique<VkeTexture>(vkeDevice, filepath);
-        }
-        else if (type == TextureType::VKE_TEXTURE_TYPE_ROUGHNESS)
-        {
-            currentRoughness = std::make_unique<VkeTexture>(vkeDevice, filepath);
-        }
-        else if (type == TextureType::VKE_TEXTURE_TYPE_METALLIC)
-        {
-            currentMetallic = std::make_unique<VkeTexture>(vkeDevice, filepath);
-        }
-        else if (type == TextureType::VKE_TEXTURE_TYPE_AO)
-        {
-            currentAO = std::make_unique<VkeTexture>(vkeDevice, filepath);
-        }
-        textureCount++;
+        currentTexturePaths[type] = filepath;
         return *this;
     }
-    VkeGameObject ObjectManager::build(glm::vec3 translation, glm::vec3 scale)
+    ObjectManager &ObjectManager::setStatic(bool isStatic)
     {
-
-        auto material = std::make_unique<VkeMaterial>();
-        material->flags.hasAlbedo = currentAlbedo != nullptr;
-        material->flags.hasNormal = currentNormal != nullptr;
-        material->flags.hasRoughness = currentRoughness != nullptr;
-        material->flags.hasMetallic = currentMetallic != nullptr;
-        material->flags.hasAO = currentAO != nullptr;
-
-        if (!currentModel)
-        {
-            throw std::runtime_error("Model must be set before building a game object");
-        }
-        if (!currentAlbedo)
-        {
-            currentAlbedo = std::make_unique<VkeTexture>(vkeDevice, defaultTexturePath);
-            textureCount++;
-        }
-        if (!currentNormal)
+        currentIsStatic = isStatic;
+        return *this;
+    }
+    std::shared_ptr<VkeTexture> ObjectManager::getTexture(const std::string &filepath)
+    {
+        std::shared_ptr<VkeTexture> texture = textures[filepath].lock();
+        if (!texture)
         {
-            currentNormal = std::make_unique<VkeTexture>(vkeDevice, defaultNormalPath);
+            texture = std::make_shared<VkeTexture>(vkeDevice, filepath);
+            textures[filepath] = texture;
             textureCount++;
         }
-        if (!currentRoughness)
+        return texture;
+    }
+    std::shared_ptr<VkeMaterial> ObjectManager::getMaterial()
+    {
+        std::shared_ptr<VkeMaterial> material = materials[currentTexturePaths].lock();
+        if (material)
         {
-            currentRoughness = std::make_unique<VkeTexture>(vkeDevice, defaultRoughnessPath);
-            textureCount++;
+            return material;
         }
-        if (!currentMetallic)
+        auto texturePath = [&](TextureType type, const std::string &defaultPath) -> const std::string &
         {
-            currentMetallic = std::make_unique<VkeTexture>(vkeDevice, defaultMetallicPath);
-            textureCount++;
-        }
-        if (!currentAO)
+            return currentTexturePaths[type].empty() ? defaultPath : currentTexturePaths[type];
+        };
+        material = std::make_shared<VkeMaterial>();
+        material->flags.hasAlbedo = !currentTexturePaths[VKE_TEXTURE_TYPE_ALBEDO].empty();
+        material->flags.hasNormal = !currentTexturePaths[VKE_TEXTURE_TYPE_NORMAL].empty();
+        material->flags.hasRoughness = !currentTexturePaths[VKE_TEXTURE_TYPE_ROUGHNESS].empty();
+        material->flags.hasMetallic = !currentTexturePaths[VKE_TEXTURE_TYPE_METALLIC].empty();
+        material->flags.hasAO = !currentTexturePaths[VKE_TEXTURE_TYPE_AO].empty();
+        material->albedo = getTexture(texturePath(VKE_TEXTURE_TYPE_ALBEDO, defaultTexturePath));
+        material->normal = getTexture(texturePath(VKE_TEXTURE_TYPE_NORMAL, defaultNormalPath));
+        material->roughness = getTexture(texturePath(VKE_TEXTURE_TYPE_ROUGHNESS, defaultRoughnessPath));
+        material->metallic = getTexture(texturePath(VKE_TEXTURE_TYPE_METALLIC, defaultMetallicPath));
+        material->ao = getTexture(texturePath(VKE_TEXTURE_TYPE_AO, defaultAOPath));
+        materials[currentTexturePaths] = material;
+        return material;
+    }
+    VkeEntity ObjectManager::build(VkeScene &scene, glm::vec3 translation, glm::vec3 scale)
+    {
+        if (currentModelPath.empty())
         {
-            currentAO = std::make_unique<VkeTexture>(vkeDevice, defaultAOPath);
-            textureCount++;
+            throw std::runtime_error("Model must be set before building a game object");
         }
+        // objects with the same textures share their material, so the static batcher can merge them
+        std::shared_ptr<VkeMaterial> material = getMaterial();
+
+        TransformComponent transform{};
+        transform.translation = translation;
+        transform.scale = scale;
+
+        RenderableComponent renderable{};
+        renderable.model = std::make_shared<VkeModel>(vkeDevice, geometryArena, currentModelPath);
+        renderable.material = std::move(material);
+        renderable.isStatic = currentIsStatic;
 
-        auto gameObject = VkeGameObject::createGameObject();
-        gameObject.model = std::move(currentModel);
-        material->albedo = std::move(currentAlbedo);
-        material->normal = std::move(currentNormal);
-        material->roughness = std::move(currentRoughness);
-        material->metallic = std::move(currentMetallic);
-        material->ao = std::move(currentAO);
-        gameObject.material = std::move(material);
-        gameObject.transform.translation = translation;
-        gameObject.transform.scale = scale;
+        VkeEntity entity = scene.createEntity();
+        scene.transforms.add(entity, transform);
+        scene.renderables.add(entity, renderable);
 
-        currentModel = nullptr;
-        currentAlbedo = nullptr;
-        currentNormal = nullptr;
-        currentRoughness = nullptr;
-        currentMetallic = nullptr;
-        currentAO = nullptr;
+        currentModelPath.clear();
+        currentIsStatic = false;
+        currentTexturePaths = {};
 
-        return gameObject;
+        return entity;
     }
 } // namespace vke
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "pipeline.hpp"
 
 #include "model.hpp"
+#include "render_stats.hpp"
 
 #include <fstream>
 #include <stdexcept>
@@ -132,6 +133,7 @@ namespace vke
     void VkePipeline::bind(VkCommandBuffer commandBuffer)
     {
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        VKE_STAT_ADD(VKE_STAT_PIPELINE_BINDS, 1);
     }
 
     void VkePipeline::defaultPipelineConfigInfo(PipelineConfigInfo &configInfo, float depthBiasConstantFactor, float depthBiasSlopeFactor)
@@ -205,11 +207,11 @@ namespace vke
         configInfo.dynamicStateInfo.dynamicStateCount =
             static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
         configInfo.dynamicStateInfo.flags = 0;
-        configInfo.bindingDescriptions = VkeModel::Vertex::getBindingDescriptions();
-        configInfo.attributeDescriptions = VkeModel::Vertex::getAttributeDescriptions();
+        configInfo.bindingDescriptions = VkeModel::PackedVertex::getBindingDescriptions();
+        configInfo.attributeDescriptions = VkeModel::PackedVertex::getAttributeDescriptions();
     }
 
-    void VkePipeline::defaultShadowPipelineConfigInfo(PipelineConfigInfo &configInfo)
+    void VkePipeline::defaultShadowPipelineConfigInfo(PipelineConfigInfo &configInfo, bool positionStream)
     {
         configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -231,8 +233,16 @@ namespace vke
 
         configInfo.subpass = 0;
 
-        configInfo.bindingDescriptions = VkeModel::Vertex::getBindingDescriptions();
-        configInfo.attributeDescriptions = VkeModel::Vertex::getAttributeDescriptions();
+        if (positionStream)
+        {
+            configInfo.bindingDescriptions = VkeModel::PositionVertex::getBindingDescriptions();
+            configInfo.attributeDescriptions = VkeModel::PositionVertex::getAttributeDescriptions();
+        }
+        else
+        {
+            configInfo.bindingDescriptions = VkeModel::PackedVertex::getBindingDescriptions();
+            configInfo.attributeDescriptions = VkeModel::PackedVertex::getAttributeDescriptions();
+        }
     }
 
     void VkePipeline::enableAlphaBlending(PipelineConfigInfo &configInfo)
@@ -248,4 +258,48 @@ namespace vke
         configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
         configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
     }
+
+    VkeComputePipeline::VkeComputePipeline(VkeDevice &device, const std::string &compFilepath, VkPipelineLayout pipelineLayout) : vkeDevice(device)
+    {
+        assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+        auto compCode = VkePipeline::readFile(compFilepath);
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = compCode.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t *>(compCode.data());
+        VkShaderModule compShaderModule;
+        if (vkCreateShaderModule(vkeDevice.device(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create shader module");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = compShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        VkResult result = vkCreateComputePipelines(vkeDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline);
+        // the module is only needed while the pipeline is created
+        vkDestroyShaderModule(vkeDevice.device(), compShaderModule, nullptr);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create compute pipeline");
+        }
+    }
+    VkeComputePipeline::~VkeComputePipeline()
+    {
+        vkDestroyPipeline(vkeDevice.device(), computePipeline, nullptr);
+    }
+
+    void VkeComputePipeline::bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+        VKE_STAT_ADD(VKE_STAT_PIPELINE_BINDS, 1);
+    }
 } // namespace vke
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "render_stats.hpp"
+
+#include "trace.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vke
+{
+    namespace
+    {
+        // only the owning thread stores, the atomics let another thread sum them at any time,
+        // a cache line of its own keeps one thread's stores from invalidating another's totals
+        struct alignas(64) ThreadCounters
+        {
+            std::array<std::atomic<uint64_t>, VKE_STAT_COUNT> totals{};
+        };
+
+        struct CounterRegistry
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadCounters>> threads;
+        };
+
+        // never destroyed, threads may still count while statics are torn down
+        CounterRegistry &registry()
+        {
+            static CounterRegistry *instance = new CounterRegistry{};
+            return *instance;
+        }
+
+        ThreadCounters &threadCounters()
+        {
+            thread_local ThreadCounters *counters = nullptr;
+            if (counters == nullptr)
+            {
+                auto &counterRegistry = registry();
+                std::lock_guard<std::mutex> lock{counterRegistry.mutex};
+                counterRegistry.threads.push_back(std::make_unique<ThreadCounters>());
+                counters = counterRegistry.threads.back().get();
+            }
+            return *counters;
+        }
+    } // namespace
+
+    const char *VkeRenderStats::getName(VkeStatCounter counter)
+    {
+        static const char *names[VKE_STAT_COUNT] = {
+            "Draw calls",
+            "Triangles",
+            "Pipeline binds",
+            "Descriptor set binds",
+            "Push constant bytes",
+            "Buffer write bytes",
+            "Staging bytes",
+            "Objects culled",
+            "Static chunks culled",
+        };
+        return names[counter];
+    }
+
+    void VkeRenderStats::add(VkeStatCounter counter, uint64_t value)
+    {
+        auto &total = threadCounters().totals[counter];
+        total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void VkeRenderStats::add(const Counters &counters)
+    {
+        auto &totals = threadCounters().totals;
+        for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+        {
+            totals[i].store(totals[i].load(std::memory_order_relaxed) + counters[i], std::memory_order_relaxed);
+        }
+    }
+
+    VkeRenderStats::Counters VkeRenderStats::getThreadTotals()
+    {
+        Counters result{};
+        auto &totals = threadCounters().totals;
+        for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+        {
+            result[i] = totals[i].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    VkeRenderStats::Counters VkeRenderStats::getTotals()
+    {
+        Counters result{};
+        auto &counterRegistry = registry();
+        std::lock_guard<std::mutex> lock{counterRegistry.mutex};
+        for (const auto &thread : counterRegistry.threads)
+        {
+            for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+            {
+                result[i] += thread->totals[i].load(std::memory_order_relaxed);
+            }
+        }
+        return result;
+    }
+
+    VkeStatsHistory::VkeStatsHistory()
+    {
+        previousTotals = VkeRenderStats::getTotals();
+    }
+
+    void VkeStatsHistory::endFrame()
+    {
+        uint64_t nowNs = VkeTrace::now();
+        uint64_t beginNs = lastFrameNs;
+        lastFrameNs = nowNs;
+        // the first call only starts the clock, whatever was counted before it, loading included, is dropped
+        VkeRenderStats::Counters totals = VkeRenderStats::getTotals();
+        for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+        {
+            latest[i] = totals[i] - previousTotals[i];
+        }
+        previousTotals = totals;
+        if (beginNs == 0)
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+        {
+            counterHistory[i][next] = static_cast<float>(latest[i]);
+        }
+        frameTimeHistory[next] = static_cast<float>(static_cast<double>(nowNs - beginNs) * 1e-6);
+        next = (next + 1) % RENDER_STATS_HISTORY;
+        recordedFrames = std::min(recordedFrames + 1, static_cast<uint32_t>(RENDER_STATS_HISTORY));
+
+        // the window is small, sorting a copy every frame is cheaper than keeping an order statistic
+        std::array<float, RENDER_STATS_HISTORY> sorted;
+        uint32_t first = (next + RENDER_STATS_HISTORY - recordedFrames) % RENDER_STATS_HISTORY;
+        double sum = 0.0;
+        for (uint32_t i = 0; i < recordedFrames; i++)
+        {
+            sorted[i] = frameTimeHistory[(first + i) % RENDER_STATS_HISTORY];
+            sum += sorted[i];
+        }
+        std::sort(sorted.begin(), sorted.begin() + recordedFrames);
+        frameTimes.min = sorted[0];
+        frameTimes.max = sorted[recordedFrames - 1];
+        frameTimes.average = static_cast<float>(sum / recordedFrames);
+        // nearest rank
+        uint32_t rank = (recordedFrames * 99 + 99) / 100;
+        frameTimes.p99 = sorted[std::max(rank, 1u) - 1];
+    }
+} // namespace vke
@@ -1,27 +1,40 @@
 #include "renderer.hpp"
 
 #include "app.hpp"
+#include "trace.hpp"
+#include "upload_queue.hpp"
 
 // std
 #include <stdexcept>
+#include <algorithm>
 #include <array>
 #include <iostream>
 
 namespace vke
 {
-    VkeRenderer::VkeRenderer(VkeWindow &window, VkeDevice &device) : vkeWindow(window), vkeDevice(device)
+    VkeRenderer::VkeRenderer(VkeWindow &window, VkeDevice &device, uint32_t recordingThreadCount) : vkeWindow(window), vkeDevice(device)
     {
         recreateSwapChain();
+        gpuProfiler = std::make_unique<VkeGpuProfiler>(vkeDevice);
         createCommandBuffers();
+        createSecondaryCommandPools(recordingThreadCount);
     }
     VkeRenderer::~VkeRenderer()
     {
+        VkeTimeline &timeline = vkeDevice.getGraphicsTimeline();
+        timeline.wait(timeline.getSubmittedValue());
+        retireDeferredDestroys(true);
+        for (auto &destroy : frameDestroys)
+        {
+            destroy();
+        }
         freeCommandBuffers();
+        destroySecondaryCommandPools();
     }
 
     void VkeRenderer::createCommandBuffers()
     {
-        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT * 2);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -34,6 +47,119 @@ namespace vke
             throw std::runtime_error("failed to allocate command buffer");
         }
     }
+    void VkeRenderer::createSecondaryCommandPools(uint32_t threadCount)
+    {
+        secondaryPools.resize(std::max(threadCount, 1u));
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = vkeDevice.findPhysicalQueueFamilies().graphicsFamily;
+        // buffers are never reset one by one, the whole pool is reset once its frame comes around again
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (auto &threadPools : secondaryPools)
+        {
+            for (auto &pool : threadPools)
+            {
+                if (vkCreateCommandPool(vkeDevice.device(), &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create secondary command pool");
+                }
+            }
+        }
+    }
+    void VkeRenderer::destroySecondaryCommandPools()
+    {
+        for (auto &threadPools : secondaryPools)
+        {
+            for (auto &pool : threadPools)
+            {
+                // destroying the pool frees every buffer allocated from it
+                vkDestroyCommandPool(vkeDevice.device(), pool.commandPool, nullptr);
+            }
+        }
+        secondaryPools.clear();
+    }
+    void VkeRenderer::resetSecondaryCommandPools()
+    {
+        for (auto &threadPools : secondaryPools)
+        {
+            auto &pool = threadPools[currentFrameIndex];
+            if (pool.usedCount == 0)
+            {
+                continue;
+            }
+            vkResetCommandPool(vkeDevice.device(), pool.commandPool, 0);
+            pool.usedCount = 0;
+        }
+    }
+    VkCommandBuffer VkeRenderer::beginSecondaryCommandBuffer(uint32_t threadIndex)
+    {
+        VkCommandBuffer commandBuffer;
+        if (beginSecondaryCommandBuffer(threadIndex, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin secondary command buffer");
+        }
+        return commandBuffer;
+    }
+    VkResult VkeRenderer::beginSecondaryCommandBuffer(uint32_t threadIndex, VkCommandBuffer *commandBuffer)
+    {
+        assert(isFrameStarted && "cannot begin secondary command buffer when frame not in progress");
+        assert(activeRenderPass != VK_NULL_HANDLE && "secondary command buffers must be recorded inside a render pass");
+        assert(threadIndex < secondaryPools.size() && "thread index out of range");
+
+        auto &pool = secondaryPools[threadIndex][currentFrameIndex];
+        if (pool.usedCount == pool.commandBuffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandPool = pool.commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer allocated;
+            VkResult result = vkAllocateCommandBuffers(vkeDevice.device(), &allocInfo, &allocated);
+            if (result != VK_SUCCESS)
+            {
+                return result;
+            }
+            pool.commandBuffers.push_back(allocated);
+        }
+        *commandBuffer = pool.commandBuffers[pool.usedCount++];
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = activeRenderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = activeFramebuffer;
+        // the render pass runs inside a pipeline statistics query when the device can inherit it, 0 otherwise
+        inheritanceInfo.pipelineStatistics = gpuProfiler->getInheritedPipelineStatistics();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        VkResult result = vkBeginCommandBuffer(*commandBuffer, &beginInfo);
+        if (result != VK_SUCCESS)
+        {
+            return result;
+        }
+
+        // dynamic state is not inherited from the primary
+        vkCmdSetViewport(*commandBuffer, 0, 1, &activeViewport);
+        vkCmdSetScissor(*commandBuffer, 0, 1, &activeScissor);
+        return VK_SUCCESS;
+    }
+    void VkeRenderer::executeSecondaryCommandBuffers(VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer> &secondaryCommandBuffers)
+    {
+        assert(commandBuffer == getCurrentCommandBuffer() && "cannot execute secondary command buffers on command buffer from a different frame");
+        if (secondaryCommandBuffers.empty())
+        {
+            return;
+        }
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+    }
     void VkeRenderer::recreateSwapChain()
     {
         auto extent = vkeWindow.getExtent();
@@ -59,6 +185,35 @@ namespace vke
                 throw std::runtime_error("Swap chain image or depth format has changed");
             }
         }
+        // the device is idle, no image is in use
+        imageValues.assign(vkeSwapChain->imageCount(), 0);
+    }
+    void VkeRenderer::deferDestroy(std::function<void()> destroy)
+    {
+        if (isFrameStarted)
+        {
+            frameDestroys.push_back(std::move(destroy));
+            return;
+        }
+        deferredDestroys.push_back({vkeDevice.getGraphicsTimeline().getSubmittedValue(), std::move(destroy)});
+    }
+    void VkeRenderer::retireDeferredDestroys(bool wait)
+    {
+        VkeTimeline &timeline = vkeDevice.getGraphicsTimeline();
+        while (!deferredDestroys.empty())
+        {
+            DeferredDestroy &deferred = deferredDestroys.front();
+            if (wait)
+            {
+                timeline.wait(deferred.value);
+            }
+            else if (!timeline.isCompleted(deferred.value))
+            {
+                break;
+            }
+            deferred.destroy();
+            deferredDestroys.pop_front();
+        }
     }
     void VkeRenderer::freeCommandBuffers()
     {
@@ -68,7 +223,14 @@ namespace vke
 
     VkCommandBuffer VkeRenderer::beginFrame()
     {
+        VKE_TRACE_SCOPE("Begin frame");
         assert(!isFrameInProgress() && "cannot call beginFrame while frame is in progress");
+        {
+            VKE_TRACE_SCOPE("Wait frame");
+            // the frame that last used this slot's command buffers and semaphores
+            vkeDevice.getGraphicsTimeline().wait(frameValues[currentFrameIndex]);
+        }
+        retireDeferredDestroys(false);
         auto result = vkeSwapChain->acquireNextImage(&currentImageIndex);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -82,6 +244,9 @@ namespace vke
             throw std::runtime_error("falied to acquire swap chain image");
         }
         isFrameStarted = true;
+        earlyCommandsSubmitted = false;
+        // the slot's last frame was waited for above, so its secondaries are no longer in use
+        resetSecondaryCommandPools();
 
         auto commandBuffer = getCurrentCommandBuffer();
 
@@ -89,6 +254,42 @@ namespace vke
 
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin rendering command buffer");
+        }
+        gpuProfiler->beginFrame(commandBuffer, currentFrameIndex);
+        return commandBuffer;
+    }
+    VkCommandBuffer VkeRenderer::submitEarlyCommands()
+    {
+        VKE_TRACE_SCOPE("Submit early commands");
+        assert(isFrameStarted && "cannot submit early commands when frame not in progress");
+        assert(!earlyCommandsSubmitted && "early commands can only be submitted once per frame");
+        assert(activeRenderPass == VK_NULL_HANDLE && "cannot submit early commands inside a render pass");
+        auto commandBuffer = getCurrentCommandBuffer();
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record early command buffer");
+        }
+        // the early commands may draw what was uploaded while they were recorded as well
+        vkeDevice.getUploadQueue().flush();
+
+        // No semaphores, the frame's submission follows on the same queue, so the graphics timeline value
+        // it signals covers these commands too.
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (vkQueueSubmit(vkeDevice.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit early command buffer");
+        }
+        earlyCommandsSubmitted = true;
+
+        commandBuffer = getCurrentCommandBuffer();
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to begin rendering command buffer");
@@ -97,13 +298,38 @@ namespace vke
     }
     void VkeRenderer::endFrame()
     {
+        VKE_TRACE_SCOPE("End frame");
         assert(isFrameInProgress() && "cannot call endFrame while frame not in progress");
         auto commandBuffer = getCurrentCommandBuffer();
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to record command buffer");
         }
-        auto result = vkeSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+        // submitted first, so the frame sees everything uploaded while it was recorded
+        vkeDevice.getUploadQueue().flush();
+
+        // reserved after the flush, whose acquires take graphics timeline values as well
+        VkeTimeline &timeline = vkeDevice.getGraphicsTimeline();
+        if (imageValues[currentImageIndex] != 0)
+        {
+            // the last frame rendering into this image, waited for on the GPU rather than the CPU
+            frameSemaphores.wait(
+                timeline.getSemaphore(),
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                imageValues[currentImageIndex]);
+        }
+        uint64_t frameValue = timeline.next();
+        frameSemaphores.signal(timeline.getSemaphore(), frameValue);
+        frameValues[currentFrameIndex] = frameValue;
+        imageValues[currentImageIndex] = frameValue;
+        for (auto &destroy : frameDestroys)
+        {
+            deferredDestroys.push_back({frameValue, std::move(destroy)});
+        }
+        frameDestroys.clear();
+
+        auto result = vkeSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, frameSemaphores);
+        frameSemaphores.clear();
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || vkeWindow.wasWindowResized())
         {
             vkeWindow.resetWindowResizedFlag();
@@ -116,7 +342,12 @@ namespace vke
         isFrameStarted = false;
         currentFrameIndex = (currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
     }
-    void VkeRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+    void VkeRenderer::waitBeforeFrame(VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value)
+    {
+        assert(isFrameStarted && "cannot add a frame wait when frame not in progress");
+        frameSemaphores.wait(semaphore, stage, value);
+    }
+    void VkeRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
     {
         assert(isFrameStarted && "can't call beginSwapChainRenderPass if frame not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() && "cannot begin render pass on command buffer from a different frame");
@@ -135,7 +366,8 @@ namespace vke
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        activeProfilerScope = gpuProfiler->beginScope(commandBuffer, "Main pass", contents == VK_SUBPASS_CONTENTS_INLINE || gpuProfiler->canInheritStatistics());
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -147,8 +379,13 @@ namespace vke
         VkRect2D scissor{{0, 0}, vkeSwapChain->getSwapChainExtent()};
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        activeRenderPass = renderPassInfo.renderPass;
+        activeFramebuffer = renderPassInfo.framebuffer;
+        activeViewport = viewport;
+        activeScissor = scissor;
     }
-    void VkeRenderer::beginShadowSwapChainRenderPass(VkCommandBuffer commandBuffer)
+    void VkeRenderer::beginShadowSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
     {
         std::array<VkClearValue, 1> clearValues{};
         clearValues[0].depthStencil = {1.0f, 0};
@@ -164,7 +401,8 @@ namespace vke
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        activeProfilerScope = gpuProfiler->beginScope(commandBuffer, "Shadow pass", contents == VK_SUBPASS_CONTENTS_INLINE || gpuProfiler->canInheritStatistics());
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -177,6 +415,11 @@ namespace vke
         VkRect2D scissor{{0, 0}, vkeSwapChain->getSwapChainExtent()};
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        activeRenderPass = renderPassInfo.renderPass;
+        activeFramebuffer = renderPassInfo.framebuffer;
+        activeViewport = viewport;
+        activeScissor = scissor;
     }
     void VkeRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
     {
@@ -184,5 +427,9 @@ namespace vke
         assert(commandBuffer == getCurrentCommandBuffer() && "cannot end render pass on command buffer from a different frame");
 
         vkCmdEndRenderPass(commandBuffer);
+        gpuProfiler->endScope(commandBuffer, activeProfilerScope);
+        activeProfilerScope = VkeGpuProfiler::NO_SCOPE;
+        activeRenderPass = VK_NULL_HANDLE;
+        activeFramebuffer = VK_NULL_HANDLE;
     }
 }
\ No newline at end of file
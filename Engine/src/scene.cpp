@@ -0,0 +1,512 @@
+#include "scene.hpp"
+#include "settings.hpp"
+#include "transform_kernels.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <stdexcept>
+
+namespace vke
+{
+    VkeEntity VkeEntityAllocator::create()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        aliveCount++;
+        if (!freeIndices.empty())
+        {
+            uint32_t index = freeIndices.back();
+            freeIndices.pop_back();
+            return VkeEntity{index, generations[index]};
+        }
+        if (generations.size() == VkeEntity::INVALID_INDEX)
+        {
+            throw std::runtime_error("out of entity slots");
+        }
+        generations.push_back(0);
+        return VkeEntity{static_cast<uint32_t>(generations.size() - 1), 0};
+    }
+    bool VkeEntityAllocator::destroy(VkeEntity entity)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (entity.index >= generations.size() || generations[entity.index] != entity.generation)
+        {
+            return false;
+        }
+        // bumping the generation invalidates every handle still pointing at this slot
+        generations[entity.index]++;
+        freeIndices.push_back(entity.index);
+        aliveCount--;
+        return true;
+    }
+    bool VkeEntityAllocator::isAlive(VkeEntity entity) const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return entity.index < generations.size() && generations[entity.index] == entity.generation;
+    }
+    uint32_t VkeEntityAllocator::getAliveCount() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return aliveCount;
+    }
+
+    uint32_t VkeSparseSet::indexOf(VkeEntity entity) const
+    {
+        if (entity.index >= sparse.size())
+        {
+            return NOT_FOUND;
+        }
+        uint32_t index = sparse[entity.index];
+        if (index == NOT_FOUND || entities[index] != entity)
+        {
+            return NOT_FOUND;
+        }
+        return index;
+    }
+    uint32_t VkeSparseSet::insertEntity(VkeEntity entity)
+    {
+        assert(!contains(entity) && "entity already has this component");
+        if (entity.index >= sparse.size())
+        {
+            sparse.resize(entity.index + 1, NOT_FOUND);
+        }
+        sparse[entity.index] = static_cast<uint32_t>(entities.size());
+        entities.push_back(entity);
+        layoutVersion++;
+        return sparse[entity.index];
+    }
+    uint32_t VkeSparseSet::eraseEntity(VkeEntity entity)
+    {
+        uint32_t index = indexOf(entity);
+        if (index == NOT_FOUND)
+        {
+            return NOT_FOUND;
+        }
+        sparse[entities.back().index] = index;
+        sparse[entity.index] = NOT_FOUND;
+        swapRemove(entities, index);
+        layoutVersion++;
+        return index;
+    }
+
+    uint32_t TransformStore::add(VkeEntity entity, const TransformComponent &transform)
+    {
+        uint32_t index = insertEntity(entity);
+        translations.push_back(transform.translation);
+        rotations.push_back(transform.rotation);
+        scales.push_back(transform.scale);
+        worldMatrices.emplace_back(1.f);
+        normalMatrices.emplace_back(1.f);
+        dirty.push_back(0);
+        matrixVersions.push_back(0);
+        parents.emplace_back();
+        firstChildren.emplace_back();
+        nextSiblings.emplace_back();
+        depths.push_back(0);
+        markDirty(index);
+        return index;
+    }
+    void TransformStore::remove(VkeEntity entity)
+    {
+        uint32_t index = indexOf(entity);
+        if (index == NOT_FOUND)
+        {
+            return;
+        }
+        unlinkFromParent(index);
+        // orphaned children become roots, keeping their local values
+        VkeEntity child = firstChildren[index];
+        while (child.isValid())
+        {
+            uint32_t childIndex = indexOf(child);
+            child = nextSiblings[childIndex];
+            parents[childIndex] = VkeEntity{};
+            nextSiblings[childIndex] = VkeEntity{};
+            parentedCount--;
+            updateSubtreeDepths(childIndex);
+            markDirty(childIndex);
+        }
+        firstChildren[index] = VkeEntity{};
+
+        eraseEntity(entity);
+        dirtyCount -= dirty[index];
+        swapRemove(translations, index);
+        swapRemove(rotations, index);
+        swapRemove(scales, index);
+        swapRemove(worldMatrices, index);
+        swapRemove(normalMatrices, index);
+        swapRemove(dirty, index);
+        swapRemove(matrixVersions, index);
+        swapRemove(parents, index);
+        swapRemove(firstChildren, index);
+        swapRemove(nextSiblings, index);
+        swapRemove(depths, index);
+        version++;
+    }
+    void TransformStore::setTranslation(uint32_t index, const glm::vec3 &translation)
+    {
+        translations[index] = translation;
+        markDirty(index);
+    }
+    void TransformStore::setRotation(uint32_t index, const glm::vec3 &rotation)
+    {
+        rotations[index] = rotation;
+        markDirty(index);
+    }
+    void TransformStore::setScale(uint32_t index, const glm::vec3 &scale)
+    {
+        scales[index] = scale;
+        markDirty(index);
+    }
+    void TransformStore::setParent(uint32_t index, VkeEntity parent)
+    {
+        if (parents[index] == parent)
+        {
+            return;
+        }
+        if (parent.isValid())
+        {
+            uint32_t ancestor = indexOf(parent);
+            assert(ancestor != NOT_FOUND && "parent has no transform");
+            while (true)
+            {
+                if (ancestor == index)
+                {
+                    throw std::runtime_error("transform parent would create a cycle");
+                }
+                if (!parents[ancestor].isValid())
+                {
+                    break;
+                }
+                ancestor = indexOf(parents[ancestor]);
+            }
+        }
+
+        unlinkFromParent(index);
+        if (parent.isValid())
+        {
+            uint32_t parentIndex = indexOf(parent);
+            parents[index] = parent;
+            nextSiblings[index] = firstChildren[parentIndex];
+            firstChildren[parentIndex] = entities[index];
+            parentedCount++;
+        }
+        updateSubtreeDepths(index);
+        markDirty(index);
+    }
+    void TransformStore::unlinkFromParent(uint32_t index)
+    {
+        if (!parents[index].isValid())
+        {
+            return;
+        }
+        uint32_t parentIndex = indexOf(parents[index]);
+        VkeEntity self = entities[index];
+        if (firstChildren[parentIndex] == self)
+        {
+            firstChildren[parentIndex] = nextSiblings[index];
+        }
+        else
+        {
+            uint32_t sibling = indexOf(firstChildren[parentIndex]);
+            while (nextSiblings[sibling] != self)
+            {
+                sibling = indexOf(nextSiblings[sibling]);
+            }
+            nextSiblings[sibling] = nextSiblings[index];
+        }
+        parents[index] = VkeEntity{};
+        nextSiblings[index] = VkeEntity{};
+        parentedCount--;
+    }
+    void TransformStore::updateSubtreeDepths(uint32_t index)
+    {
+        depths[index] = parents[index].isValid() ? depths[indexOf(parents[index])] + 1 : 0;
+        std::vector<uint32_t> stack{index};
+        while (!stack.empty())
+        {
+            uint32_t current = stack.back();
+            stack.pop_back();
+            for (VkeEntity child = firstChildren[current]; child.isValid();)
+            {
+                uint32_t childIndex = indexOf(child);
+                depths[childIndex] = depths[current] + 1;
+                stack.push_back(childIndex);
+                child = nextSiblings[childIndex];
+            }
+        }
+    }
+    void TransformStore::markDirty(uint32_t index)
+    {
+        version++;
+        if (!dirty[index])
+        {
+            dirty[index] = 1;
+            dirtyCount++;
+        }
+    }
+    uint32_t TransformStore::updateMatrices(VkeThreadPool *threadPool)
+    {
+        if (dirtyCount == 0)
+        {
+            return 0;
+        }
+        dirtyIndices.clear();
+        for (uint32_t i = 0; dirtyIndices.size() < dirtyCount; i++)
+        {
+            if (dirty[i])
+            {
+                dirtyIndices.push_back(i);
+            }
+        }
+        // flat scenes never pay for the hierarchy
+        if (parentedCount > 0)
+        {
+            collectDirtySubtrees();
+        }
+        dirtyCount = 0;
+        updateCount++;
+        for (uint32_t index : dirtyIndices)
+        {
+            dirty[index] = 0;
+            matrixVersions[index] = updateCount;
+        }
+
+        // local matrices first, for roots they already are the world matrices. Every index is
+        // written by exactly one range, so the ranges need no synchronisation
+        auto job = [this](uint32_t begin, uint32_t end, uint32_t)
+        {
+            computeTransformMatrices(
+                translations.data(),
+                rotations.data(),
+                scales.data(),
+                dirtyIndices.data() + begin,
+                end - begin,
+                worldMatrices.data(),
+                normalMatrices.data());
+        };
+        uint32_t count = static_cast<uint32_t>(dirtyIndices.size());
+        if (threadPool != nullptr)
+        {
+            threadPool->parallelFor(count, job, TRANSFORMS_PER_THREAD);
+        }
+        else
+        {
+            job(0, count, 0);
+        }
+
+        if (parentedCount > 0)
+        {
+            propagateToChildren(threadPool);
+        }
+        return count;
+    }
+    void TransformStore::collectDirtySubtrees()
+    {
+        // a moved transform moves all its descendants, the dirty flag doubles as the visited mark
+        size_t initialCount = dirtyIndices.size();
+        for (size_t i = 0; i < dirtyIndices.size(); i++)
+        {
+            for (VkeEntity child = firstChildren[dirtyIndices[i]]; child.isValid();)
+            {
+                uint32_t childIndex = indexOf(child);
+                if (!dirty[childIndex])
+                {
+                    dirty[childIndex] = 1;
+                    dirtyIndices.push_back(childIndex);
+                }
+                child = nextSiblings[childIndex];
+            }
+        }
+        if (dirtyIndices.size() != initialCount)
+        {
+            // back in storage order, so the kernel and each level below walk memory forward
+            std::sort(dirtyIndices.begin(), dirtyIndices.end());
+        }
+    }
+    void TransformStore::propagateToChildren(VkeThreadPool *threadPool)
+    {
+        uint32_t maxDepth = 0;
+        for (uint32_t index : dirtyIndices)
+        {
+            maxDepth = std::max(maxDepth, depths[index]);
+        }
+        if (maxDepth == 0)
+        {
+            return;
+        }
+
+        // counting sort of the dirty children by depth, level d is [levelOffsets[d], levelOffsets[d + 1])
+        levelOffsets.assign(maxDepth + 2, 0);
+        for (uint32_t index : dirtyIndices)
+        {
+            if (depths[index] > 0)
+            {
+                levelOffsets[depths[index] + 1]++;
+            }
+        }
+        for (uint32_t depth = 1; depth < levelOffsets.size(); depth++)
+        {
+            levelOffsets[depth] += levelOffsets[depth - 1];
+        }
+        propagationOrder.resize(levelOffsets.back());
+        std::vector<uint32_t> cursors{levelOffsets};
+        for (uint32_t index : dirtyIndices)
+        {
+            if (depths[index] > 0)
+            {
+                propagationOrder[cursors[depths[index]]++] = index;
+            }
+        }
+
+        // every parent sits in an earlier level or was clean, so a level only reads finished matrices
+        // and its transforms are independent of each other
+        for (uint32_t depth = 1; depth <= maxDepth; depth++)
+        {
+            uint32_t levelBegin = levelOffsets[depth];
+            auto job = [this, levelBegin](uint32_t begin, uint32_t end, uint32_t)
+            {
+                for (uint32_t i = levelBegin + begin; i < levelBegin + end; i++)
+                {
+                    uint32_t index = propagationOrder[i];
+                    uint32_t parentIndex = indexOf(parents[index]);
+                    worldMatrices[index] = worldMatrices[parentIndex] * worldMatrices[index];
+                    normalMatrices[index] = normalMatrices[parentIndex] * normalMatrices[index];
+                }
+            };
+            uint32_t levelSize = levelOffsets[depth + 1] - levelBegin;
+            if (threadPool != nullptr)
+            {
+                threadPool->parallelFor(levelSize, job, TRANSFORMS_PER_THREAD);
+            }
+            else
+            {
+                job(0, levelSize, 0);
+            }
+        }
+    }
+    TransformComponent TransformStore::get(uint32_t index) const
+    {
+        TransformComponent transform{};
+        transform.translation = translations[index];
+        transform.rotation = rotations[index];
+        transform.scale = scales[index];
+        return transform;
+    }
+
+    uint32_t RenderableStore::add(VkeEntity entity, const RenderableComponent &renderable)
+    {
+        uint32_t index = insertEntity(entity);
+        models.push_back(renderable.model.get());
+        descriptorSets.push_back(renderable.descriptorSet);
+        hasNormalMap.push_back(renderable.material && renderable.material->flags.hasNormal);
+        isStatic.push_back(renderable.isStatic);
+        modelRefs.push_back(renderable.model);
+        materials.push_back(renderable.material);
+        return index;
+    }
+    void RenderableStore::remove(VkeEntity entity)
+    {
+        uint32_t index = eraseEntity(entity);
+        if (index == NOT_FOUND)
+        {
+            return;
+        }
+        swapRemove(models, index);
+        swapRemove(descriptorSets, index);
+        swapRemove(hasNormalMap, index);
+        swapRemove(isStatic, index);
+        swapRemove(modelRefs, index);
+        swapRemove(materials, index);
+    }
+    RenderableComponent RenderableStore::get(uint32_t index) const
+    {
+        RenderableComponent renderable{};
+        renderable.model = modelRefs[index];
+        renderable.material = materials[index];
+        renderable.descriptorSet = descriptorSets[index];
+        renderable.isStatic = isStatic[index];
+        return renderable;
+    }
+
+    uint32_t PointLightStore::add(VkeEntity entity, const PointLightComponent &light)
+    {
+        uint32_t index = insertEntity(entity);
+        colors.push_back(light.color);
+        intensities.push_back(light.lightIntensity);
+        radii.push_back(light.radius);
+        return index;
+    }
+    void PointLightStore::remove(VkeEntity entity)
+    {
+        uint32_t index = eraseEntity(entity);
+        if (index == NOT_FOUND)
+        {
+            return;
+        }
+        swapRemove(colors, index);
+        swapRemove(intensities, index);
+        swapRemove(radii, index);
+    }
+    void PointLightStore::sortBackToFront(const TransformStore &transforms, glm::vec3 viewer, std::vector<uint32_t> &order) const
+    {
+        std::map<float, uint32_t> sorted;
+        for (uint32_t i = 0; i < size(); i++)
+        {
+            auto offset = viewer - transforms.getTranslation(transforms.indexOf(entities[i]));
+            float disSquared = glm::dot(offset, offset);
+            sorted[disSquared] = i;
+        }
+        order.clear();
+        for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+        {
+            order.push_back(it->second);
+        }
+    }
+
+    void VkeScene::destroyEntity(VkeEntity entity)
+    {
+        if (!allocator.destroy(entity))
+        {
+            return;
+        }
+        transforms.remove(entity);
+        renderables.remove(entity);
+        pointLights.remove(entity);
+    }
+    VkeEntity VkeScene::clone(VkeEntity source)
+    {
+        assert(isAlive(source) && "cannot clone a destroyed entity");
+        VkeEntity entity = createEntity();
+        if (uint32_t index = transforms.indexOf(source); index != VkeSparseSet::NOT_FOUND)
+        {
+            uint32_t cloneIndex = transforms.add(entity, transforms.get(index));
+            transforms.setParent(cloneIndex, transforms.getParent(index));
+        }
+        if (uint32_t index = renderables.indexOf(source); index != VkeSparseSet::NOT_FOUND)
+        {
+            renderables.add(entity, renderables.get(index));
+        }
+        if (uint32_t index = pointLights.indexOf(source); index != VkeSparseSet::NOT_FOUND)
+        {
+            PointLightComponent light{};
+            light.color = pointLights.colors[index];
+            light.lightIntensity = pointLights.intensities[index];
+            light.radius = pointLights.radii[index];
+            pointLights.add(entity, light);
+        }
+        return entity;
+    }
+    VkeEntity VkeScene::createPointLight(float intensity, float radius, glm::vec3 color)
+    {
+        VkeEntity entity = createEntity();
+        transforms.add(entity, TransformComponent{});
+        PointLightComponent light{};
+        light.color = color;
+        light.lightIntensity = intensity;
+        light.radius = radius;
+        pointLights.add(entity, light);
+        return entity;
+    }
+} // namespace vke
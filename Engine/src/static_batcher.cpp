@@ -0,0 +1,144 @@
+#include "static_batcher.hpp"
+
+#include "bounds.hpp"
+#include "static_chunks.hpp"
+#include "trace.hpp"
+
+// std
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+namespace vke
+{
+    VkeStaticBatcher::VkeStaticBatcher(VkeDevice &device, VkeGeometryArena &geometryArena, VkeRenderer &renderer)
+        : vkeDevice{device}, geometryArena{geometryArena}, vkeRenderer{renderer}
+    {
+    }
+
+    uint32_t VkeStaticBatcher::build(VkeScene &scene)
+    {
+        VKE_TRACE_SCOPE("Build static batches");
+        clear(scene);
+        auto &renderables = scene.renderables;
+        auto &transforms = scene.transforms;
+        transforms.updateMatrices();
+
+        // material and chunk of the world bounds center -> renderables, ordered so batches come out the same every build
+        using GroupKey = std::tuple<const VkeMaterial *, VkeStaticChunks::Cell>;
+        std::map<GroupKey, std::vector<uint32_t>> groups;
+        for (uint32_t i = 0; i < renderables.size(); i++)
+        {
+            if (!renderables.isStatic[i] || renderables.materials[i] == nullptr || renderables.models[i]->getSourcePath().empty())
+            {
+                continue;
+            }
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+            assert(transformIndex != VkeSparseSet::NOT_FOUND && "renderable without a transform");
+            glm::vec3 center = renderables.models[i]->getBounds().transformed(transforms.getWorldMatrix(transformIndex)).center();
+            GroupKey key{renderables.materials[i].get(), VkeStaticChunks::getCell(center)};
+            groups[key].push_back(i);
+        }
+
+        // merge everything first, dense indices move once renderables are removed
+        std::vector<std::shared_ptr<VkeModel>> mergedModels;
+        // loaded again for this build only, models keep no CPU copy of their geometry
+        std::unordered_map<std::string, VkeModel::Builder> sources;
+        uint32_t replacedCount = 0;
+        for (const auto &[key, members] : groups)
+        {
+            if (members.size() < 2)
+            {
+                continue;
+            }
+            VkeModel::Builder merged{};
+            Batch batch{};
+            for (uint32_t i : members)
+            {
+                uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+                const glm::mat4 &worldMatrix = transforms.getWorldMatrix(transformIndex);
+                glm::mat3 normalMatrix{transforms.getNormalMatrix(transformIndex)};
+                const std::string &sourcePath = renderables.models[i]->getSourcePath();
+                auto sourceIt = sources.find(sourcePath);
+                if (sourceIt == sources.end())
+                {
+                    sourceIt = sources.emplace(sourcePath, VkeModel::Builder{}).first;
+                    sourceIt->second.loadModels(sourcePath);
+                }
+                const VkeModel::Builder &source = sourceIt->second;
+
+                uint32_t firstVertex = static_cast<uint32_t>(merged.vertices.size());
+                for (VkeModel::Vertex vertex : source.vertices)
+                {
+                    vertex.position = glm::vec3(worldMatrix * glm::vec4(vertex.position, 1.f));
+                    glm::vec3 normal = normalMatrix * vertex.normal;
+                    float normalLength = glm::length(normal);
+                    vertex.normal = normalLength > 0.f ? normal / normalLength : normal;
+                    merged.vertices.push_back(vertex);
+                }
+                // a mirroring transform turns the triangles around, flip them back to keep the front faces
+                bool mirrored = glm::determinant(glm::mat3(worldMatrix)) < 0.f;
+                for (size_t t = 0; t + 2 < source.indices.size(); t += 3)
+                {
+                    merged.indices.push_back(firstVertex + source.indices[t]);
+                    merged.indices.push_back(firstVertex + source.indices[t + (mirrored ? 2 : 1)]);
+                    merged.indices.push_back(firstVertex + source.indices[t + (mirrored ? 1 : 2)]);
+                }
+                batch.sources.emplace_back(renderables.entities[i], renderables.get(i));
+            }
+            replacedCount += static_cast<uint32_t>(members.size());
+            mergedModels.push_back(std::make_shared<VkeModel>(vkeDevice, geometryArena, std::move(merged)));
+            batches.push_back(std::move(batch));
+        }
+
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            Batch &batch = batches[b];
+            for (const auto &source : batch.sources)
+            {
+                renderables.remove(source.first);
+            }
+            // the vertices are in world space already, and every source used the same material descriptor
+            batch.entity = scene.createEntity();
+            transforms.add(batch.entity, TransformComponent{});
+            RenderableComponent renderable{};
+            renderable.model = std::move(mergedModels[b]);
+            renderable.material = batch.sources.front().second.material;
+            renderable.descriptorSet = batch.sources.front().second.descriptorSet;
+            renderable.isStatic = true;
+            renderables.add(batch.entity, renderable);
+        }
+        std::cout << "Static batches:" << batches.size() << " replacing " << replacedCount << " objects" << std::endl;
+        return static_cast<uint32_t>(batches.size());
+    }
+
+    void VkeStaticBatcher::clear(VkeScene &scene)
+    {
+        for (auto &batch : batches)
+        {
+            // the merged geometry is freed once the frames drawing it finished
+            uint32_t index = scene.renderables.indexOf(batch.entity);
+            if (index != VkeSparseSet::NOT_FOUND)
+            {
+                std::shared_ptr<VkeModel> model = scene.renderables.modelRefs[index];
+                vkeRenderer.deferDestroy([model]() mutable
+                {
+                    model.reset();
+                });
+            }
+            scene.destroyEntity(batch.entity);
+            for (auto &source : batch.sources)
+            {
+                // sources destroyed while batched stay gone
+                if (scene.isAlive(source.first) && !scene.renderables.contains(source.first))
+                {
+                    scene.renderables.add(source.first, source.second);
+                }
+            }
+        }
+        batches.clear();
+    }
+} // namespace vke
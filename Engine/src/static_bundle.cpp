@@ -0,0 +1,127 @@
+#include "static_bundle.hpp"
+#include "utils.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+
+namespace vke
+{
+    VkeStaticBundle::VkeStaticBundle(VkeDevice &device) : vkeDevice{device}
+    {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = vkeDevice.findPhysicalQueueFamilies().graphicsFamily;
+        // each frame's copy is re-recorded on its own, never the whole pool at once
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        if (vkCreateCommandPool(vkeDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create static bundle command pool");
+        }
+
+        std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers;
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+        if (vkAllocateCommandBuffers(vkeDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate static bundle command buffers");
+        }
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            entries[i].commandBuffer = commandBuffers[i];
+        }
+    }
+    VkeStaticBundle::~VkeStaticBundle()
+    {
+        vkDestroyCommandPool(vkeDevice.device(), commandPool, nullptr);
+    }
+
+    uint64_t VkeStaticBundle::hashStaticObject(VkeEntity entity, const VkeModel *model, uint32_t lod, VkDescriptorSet descriptorSet, uint64_t matrixVersion)
+    {
+        std::size_t seed = 0;
+        lve::hashCombine(seed, entity.index, entity.generation, model, lod, descriptorSet, matrixVersion);
+        return seed;
+    }
+
+    void VkeStaticBundle::invalidate()
+    {
+        for (auto &entry : entries)
+        {
+            entry.valid = false;
+        }
+    }
+
+    bool VkeStaticBundle::isStale(const Entry &entry, VkeRenderer &renderer, VkDescriptorSet descriptorSet, uint32_t dynamicOffset, uint64_t staticSetHash) const
+    {
+        return !entry.valid ||
+               entry.renderPass != renderer.getActiveRenderPass() ||
+               std::memcmp(&entry.viewport, &renderer.getActiveViewport(), sizeof(VkViewport)) != 0 ||
+               std::memcmp(&entry.scissor, &renderer.getActiveScissor(), sizeof(VkRect2D)) != 0 ||
+               entry.descriptorSet != descriptorSet ||
+               entry.dynamicOffset != dynamicOffset ||
+               entry.staticSetHash != staticSetHash;
+    }
+
+    VkCommandBuffer VkeStaticBundle::get(VkeRenderer &renderer, int frameIndex, VkDescriptorSet descriptorSet, uint32_t dynamicOffset, uint64_t staticSetHash, const RecordFn &record)
+    {
+        assert(renderer.getActiveRenderPass() != VK_NULL_HANDLE && "static bundles must be used inside a render pass");
+
+        auto &entry = entries[frameIndex];
+        if (!isStale(entry, renderer, descriptorSet, dynamicOffset, staticSetHash))
+        {
+#if RENDER_STATS_ENABLED
+            VkeRenderStats::add(entry.recordedStats);
+#endif
+            return entry.commandBuffer;
+        }
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderer.getActiveRenderPass();
+        inheritanceInfo.subpass = 0;
+        // the swap chain pass uses a different framebuffer per image, leave it unspecified so one recording fits all
+        inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+        inheritanceInfo.pipelineStatistics = renderer.getGpuProfiler().getInheritedPipelineStatistics();
+
+        // no ONE_TIME_SUBMIT, the buffer is replayed until stale. This frame slot's last submission was
+        // waited for, so only the other frames' copies can still be pending
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(entry.commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin static bundle command buffer");
+        }
+        vkCmdSetViewport(entry.commandBuffer, 0, 1, &renderer.getActiveViewport());
+        vkCmdSetScissor(entry.commandBuffer, 0, 1, &renderer.getActiveScissor());
+#if RENDER_STATS_ENABLED
+        VkeRenderStats::Counters statsBefore = VkeRenderStats::getThreadTotals();
+#endif
+        record(entry.commandBuffer);
+#if RENDER_STATS_ENABLED
+        VkeRenderStats::Counters statsAfter = VkeRenderStats::getThreadTotals();
+        for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+        {
+            entry.recordedStats[i] = statsAfter[i] - statsBefore[i];
+        }
+#endif
+        if (vkEndCommandBuffer(entry.commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record static bundle command buffer");
+        }
+
+        entry.valid = true;
+        entry.renderPass = renderer.getActiveRenderPass();
+        entry.viewport = renderer.getActiveViewport();
+        entry.scissor = renderer.getActiveScissor();
+        entry.descriptorSet = descriptorSet;
+        entry.dynamicOffset = dynamicOffset;
+        entry.staticSetHash = staticSetHash;
+        return entry.commandBuffer;
+    }
+} // namespace vke
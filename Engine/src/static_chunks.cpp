@@ -0,0 +1,109 @@
+#include "static_chunks.hpp"
+#include "settings.hpp"
+
+// std
+#include <cassert>
+#include <cmath>
+#include <map>
+
+namespace vke
+{
+    VkeStaticChunks::Cell VkeStaticChunks::getCell(const glm::vec3 &point)
+    {
+        return {static_cast<int64_t>(std::floor(point.x / STATIC_BATCH_CHUNK_SIZE)),
+                static_cast<int64_t>(std::floor(point.y / STATIC_BATCH_CHUNK_SIZE)),
+                static_cast<int64_t>(std::floor(point.z / STATIC_BATCH_CHUNK_SIZE))};
+    }
+
+    void VkeStaticChunks::update(const VkeScene &scene)
+    {
+        const auto &renderables = scene.renderables;
+        const auto &transforms = scene.transforms;
+        if (renderables.getLayoutVersion() != renderableLayout || transforms.getLayoutVersion() != transformLayout)
+        {
+            rebuild(scene);
+            return;
+        }
+
+        uint64_t updateCount = transforms.getUpdateCount();
+        if (updateCount == transformUpdates)
+        {
+            return;
+        }
+        if (updateCount != transformUpdates + 1)
+        {
+            // missed an update, the updated list no longer covers everything that moved
+            rebuild(scene);
+            return;
+        }
+        transformUpdates = updateCount;
+        for (uint32_t transformIndex : transforms.getUpdatedIndices())
+        {
+            uint32_t item = renderables.indexOf(transforms.entities[transformIndex]);
+            if (item != VkeSparseSet::NOT_FOUND && renderables.isStatic[item])
+            {
+                rebuild(scene);
+                return;
+            }
+        }
+    }
+
+    void VkeStaticChunks::rebuild(const VkeScene &scene)
+    {
+        const auto &renderables = scene.renderables;
+        const auto &transforms = scene.transforms;
+        renderableLayout = renderables.getLayoutVersion();
+        transformLayout = transforms.getLayoutVersion();
+        transformUpdates = transforms.getUpdateCount();
+
+        std::vector<uint32_t> items;
+        std::vector<VkeAabb> itemBounds;
+        for (uint32_t i = 0; i < renderables.size(); i++)
+        {
+            if (!renderables.isStatic[i])
+            {
+                continue;
+            }
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+            assert(transformIndex != VkeSparseSet::NOT_FOUND && "renderable without a transform");
+            items.push_back(i);
+            itemBounds.push_back(renderables.models[i]->getBounds().transformed(transforms.getWorldMatrix(transformIndex)));
+        }
+        build(items, itemBounds);
+    }
+
+    void VkeStaticChunks::build(const std::vector<uint32_t> &items, const std::vector<VkeAabb> &itemBounds)
+    {
+        assert(items.size() == itemBounds.size() && "one box per item");
+        // chunks are numbered by their first item, so regrouping an unchanged set keeps every chunk's
+        // index and with it the bundle recorded for it
+        std::map<Cell, uint32_t> chunkOfCell;
+        chunks.clear();
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            auto [it, inserted] = chunkOfCell.emplace(getCell(itemBounds[i].center()), 0);
+            if (inserted)
+            {
+                it->second = static_cast<uint32_t>(chunks.size());
+                chunks.emplace_back();
+            }
+            Chunk &chunk = chunks[it->second];
+            chunk.bounds.grow(itemBounds[i]);
+            chunk.objects.push_back(items[i]);
+        }
+    }
+
+    void VkeStaticChunks::queryFrustums(const VkeFrustum *frustums, uint32_t frustumCount, std::vector<uint32_t> *results) const
+    {
+        for (uint32_t chunk = 0; chunk < chunks.size(); chunk++)
+        {
+            for (uint32_t f = 0; f < frustumCount; f++)
+            {
+                if (frustums[f].classify(chunks[chunk].bounds) != VkeFrustum::OUTSIDE)
+                {
+                    results[f].push_back(chunk);
+                }
+            }
+        }
+    }
+} // namespace vke
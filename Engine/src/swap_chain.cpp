@@ -1,6 +1,7 @@
 #include "swap_chain.hpp"
 
 #include "settings.hpp"
+#include "trace.hpp"
 
 // std
 #include <array>
@@ -76,20 +77,13 @@ namespace vke
     {
       vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
       vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-      vkDestroyFence(device.device(), inFlightFences[i], nullptr);
     }
 
   }
 
   VkResult VkeSwapChain::acquireNextImage(uint32_t *imageIndex)
   {
-    vkWaitForFences(
-        device.device(),
-        1,
-        &inFlightFences[currentFrame],
-        VK_TRUE,
-        std::numeric_limits<uint64_t>::max());
-
+    VKE_TRACE_SCOPE("Acquire image");
     VkResult result = vkAcquireNextImageKHR(
         device.device(),
         swapChain,
@@ -102,35 +96,25 @@ namespace vke
   }
 
   VkResult VkeSwapChain::submitCommandBuffers(
-      const VkCommandBuffer *buffers, uint32_t *imageIndex)
+      const VkCommandBuffer *buffers, uint32_t *imageIndex, VkeSubmitSemaphores &semaphores)
   {
-    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-    {
-      vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-    }
-    imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
-
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
+    semaphores.wait(imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = buffers;
 
     VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    semaphores.signal(signalSemaphores[0]);
+    semaphores.apply(submitInfo);
 
-    vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-        VK_SUCCESS)
     {
-      throw std::runtime_error("failed to submit draw command buffer!");
+      VKE_TRACE_SCOPE("Queue submit");
+      if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+      {
+        throw std::runtime_error("failed to submit draw command buffer!");
+      }
     }
 
     VkPresentInfoKHR presentInfo = {};
@@ -145,7 +129,11 @@ namespace vke
 
     presentInfo.pImageIndices = imageIndex;
 
-    auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+    VkResult result;
+    {
+      VKE_TRACE_SCOPE("Present");
+      result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+    }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -512,23 +500,17 @@ namespace vke
   {
     imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
+    // binary, acquisition and presentation can't use timeline semaphores
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
       if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
               VK_SUCCESS ||
           vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-              VK_SUCCESS ||
-          vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+              VK_SUCCESS)
       {
         throw std::runtime_error("failed to create synchronization objects for a frame!");
       }
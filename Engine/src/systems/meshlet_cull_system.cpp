@@ -0,0 +1,369 @@
+#include "systems/meshlet_cull_system.hpp"
+
+#include "bounds.hpp"
+#include "render_stats.hpp"
+#include "trace.hpp"
+#include "upload_queue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+namespace vke
+{
+    MeshletCullSystem::MeshletCullSystem(VkeDevice &device, VkeFrameRingBuffer &frameRing) : vkeDevice{device}, frameRing{frameRing}
+    {
+        createDescriptorSetLayouts();
+        createPipelineLayout();
+        createPipeline();
+
+        // the smallest valid buffers, prepare grows them
+        createFrameBuffers(1, 3);
+        if (vkeDevice.hasAsyncComputeQueue())
+        {
+            createComputeCommandBuffers();
+        }
+    }
+    MeshletCullSystem::~MeshletCullSystem()
+    {
+        if (computeTimeline)
+        {
+            // the last dispatches may outlive the frames that waited on them
+            computeTimeline->wait(computeTimeline->getSubmittedValue());
+            for (auto &frame : frames)
+            {
+                vkFreeCommandBuffers(vkeDevice.device(), vkeDevice.getComputeCommandPool(), 1, &frame.computeCommands);
+            }
+        }
+        vkDestroyPipelineLayout(vkeDevice.device(), pipelineLayout, nullptr);
+    }
+
+    void MeshletCullSystem::createComputeCommandBuffers()
+    {
+        computeTimeline = std::make_unique<VkeTimeline>(vkeDevice);
+        for (auto &frame : frames)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = vkeDevice.getComputeCommandPool();
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(vkeDevice.device(), &allocInfo, &frame.computeCommands) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate meshlet cull compute command buffer");
+            }
+        }
+    }
+
+    void MeshletCullSystem::createDescriptorSetLayouts()
+    {
+        frameSetLayout = VkeDescriptorSetLayout::Builder(vkeDevice)
+                             .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT) // frustum and camera, from the frame ring
+                             .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // draw commands
+                             .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // compacted indices
+                             .build();
+        modelSetLayout = VkeDescriptorSetLayout::Builder(vkeDevice)
+                             .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // meshlets
+                             .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // source indices
+                             .build();
+    }
+
+    void MeshletCullSystem::createPipelineLayout()
+    {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(MeshletCullPushConstants);
+
+        VkDescriptorSetLayout setLayouts[] = {frameSetLayout->getDescriptorSetLayout(), modelSetLayout->getDescriptorSetLayout()};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 2;
+        pipelineLayoutInfo.pSetLayouts = setLayouts;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(vkeDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout");
+        }
+    }
+
+    void MeshletCullSystem::createPipeline()
+    {
+        assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+        computePipeline = std::make_unique<VkeComputePipeline>(
+            vkeDevice,
+            std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/meshlet_cull.comp.spv",
+            pipelineLayout);
+    }
+
+    void MeshletCullSystem::createFrameBuffers(uint32_t newCommandCapacity, uint32_t newIndexCapacity)
+    {
+        commandCapacity = newCommandCapacity;
+        indexCapacity = newIndexCapacity;
+        // written on the compute queue and read on the graphics queue
+        for (auto &frame : frames)
+        {
+            frame.commandBuffer = std::make_unique<VkeBuffer>(
+                vkeDevice,
+                sizeof(VkDrawIndexedIndirectCommand),
+                commandCapacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                1,
+                true);
+            frame.commandBuffer->map();
+            frame.indexBuffer = std::make_unique<VkeBuffer>(
+                vkeDevice,
+                sizeof(uint32_t),
+                indexCapacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                1,
+                true);
+        }
+        version++;
+    }
+
+    VkDescriptorSet MeshletCullSystem::getModelDescriptorSet(VkeModel *model, VkeDescriptorAllocator &transientDescriptors)
+    {
+        auto it = modelDescriptorSets.find(model);
+        if (it != modelDescriptorSets.end())
+        {
+            return it->second;
+        }
+        assert(model->getIndexType() == VK_INDEX_TYPE_UINT32 && "meshlet source indices must be 32 bit");
+        auto meshletInfo = model->getMeshletBuffer()->descriptorInfo();
+        auto indexInfo = model->getIndexBuffer()->descriptorInfo();
+        VkDescriptorSet descriptorSet;
+        VkeDescriptorWriter(*modelSetLayout, transientDescriptors)
+            .writeBuffer(0, &meshletInfo)
+            .writeBuffer(1, &indexInfo)
+            .build(descriptorSet);
+        modelDescriptorSets[model] = descriptorSet;
+        return descriptorSet;
+    }
+
+    void MeshletCullSystem::prepare(VkeScene &scene, VkeRenderer &renderer)
+    {
+        auto &renderables = scene.renderables;
+        if (renderables.getLayoutVersion() == preparedLayoutVersion)
+        {
+            return;
+        }
+        preparedLayoutVersion = renderables.getLayoutVersion();
+
+        // every object with meshlets owns a region as large as its full detail level
+        outputBases.assign(renderables.size(), NO_SLOT);
+        slotModels.assign(renderables.size(), nullptr);
+        uint32_t indexCount = 0;
+        for (uint32_t i = 0; i < renderables.size(); i++)
+        {
+            const VkeModel *model = renderables.models[i];
+            if (model == nullptr || model->getMeshletCount() == 0)
+            {
+                continue;
+            }
+            outputBases[i] = indexCount;
+            slotModels[i] = model;
+            indexCount += model->getLod(0).indexCount;
+        }
+
+        uint32_t commandCount = std::max(static_cast<uint32_t>(renderables.size()), 1u);
+        if (commandCount > commandCapacity || indexCount > indexCapacity)
+        {
+            // the frames in flight may still read the old buffers
+            for (auto &frame : frames)
+            {
+                std::shared_ptr<VkeBuffer> commands = std::move(frame.commandBuffer);
+                std::shared_ptr<VkeBuffer> indices = std::move(frame.indexBuffer);
+                renderer.deferDestroy([commands, indices]() mutable
+                {
+                    commands.reset();
+                    indices.reset();
+                });
+            }
+            createFrameBuffers(std::max(commandCount, commandCapacity * 2), std::max(indexCount, indexCapacity * 2));
+        }
+        version++;
+    }
+
+    void MeshletCullSystem::cull(FrameInfo &frameInfo, const std::vector<uint32_t> &objects)
+    {
+        VKE_TRACE_SCOPE("Meshlet cull");
+        auto &renderables = frameInfo.scene.renderables;
+        auto &transforms = frameInfo.scene.transforms;
+        prepare(frameInfo.scene, frameInfo.renderer);
+        culled.assign(renderables.size(), 0);
+        dispatches.clear();
+        // the model sets come from the frame's transient allocator, which was reset when the frame began
+        modelDescriptorSets.clear();
+
+        // the same LOD choice as the main pass, only objects drawing the full detail level have meshlets
+        float pixelScale = getLodPixelScale(frameInfo);
+        glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+        FrameResources &frame = frames[frameInfo.frameIndex];
+        auto *commands = static_cast<VkDrawIndexedIndirectCommand *>(frame.commandBuffer->getMappedMemory());
+        for (uint32_t i : objects)
+        {
+            VkeModel *model = renderables.models[i];
+            if (outputBases[i] == NO_SLOT || slotModels[i] != model)
+            {
+                continue;
+            }
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+            if (model->selectLod(transforms.getWorldMatrix(transformIndex), cameraPosition, pixelScale, LOD_ERROR_PIXELS) != 0)
+            {
+                continue;
+            }
+            // the shader accumulates the surviving index count
+            commands[i] = {0, 1, outputBases[i], model->getVertexOffset(), 0};
+            culled[i] = 1;
+            dispatches.push_back(i);
+        }
+        if (dispatches.empty())
+        {
+            return;
+        }
+
+        MeshletCullUbo ubo{};
+        VkeFrustum frustum = VkeFrustum::fromViewProjection(frameInfo.camera.getProjection() * frameInfo.camera.getView());
+        std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(ubo.frustumPlanes));
+        ubo.cameraPosition = glm::vec4(cameraPosition, 1.f);
+        uint32_t uboOffset = frameInfo.frameRing.push(ubo);
+
+        // written every frame, the buffers it points at may be replaced by the next prepare
+        auto uboInfo = frameRing.descriptorInfo(sizeof(MeshletCullUbo));
+        auto commandInfo = frame.commandBuffer->descriptorInfo();
+        auto indexInfo = frame.indexBuffer->descriptorInfo();
+        VkDescriptorSet frameDescriptorSet;
+        VkeDescriptorWriter(*frameSetLayout, frameInfo.transientDescriptors)
+            .writeBuffer(0, &uboInfo)
+            .writeBuffer(1, &commandInfo)
+            .writeBuffer(2, &indexInfo)
+            .build(frameDescriptorSet);
+
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        if (computeTimeline)
+        {
+            // the frame's previous dispatches finished before its graphics submission, which beginFrame waited for
+            commandBuffer = frame.computeCommands;
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to begin meshlet cull compute command buffer");
+            }
+        }
+        computePipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            pipelineLayout,
+            0,
+            1,
+            &frameDescriptorSet,
+            1,
+            &uboOffset);
+        VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
+        for (uint32_t i : dispatches)
+        {
+            VkeModel *model = renderables.models[i];
+            VkDescriptorSet modelDescriptorSet = getModelDescriptorSet(model, frameInfo.transientDescriptors);
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipelineLayout,
+                1,
+                1,
+                &modelDescriptorSet,
+                0,
+                nullptr);
+            VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
+
+            MeshletCullPushConstants push{};
+            push.modelMatrix = transforms.getWorldMatrix(transforms.indexOf(renderables.entities[i]));
+            push.outputBase = outputBases[i];
+            push.commandIndex = i;
+            vkCmdPushConstants(
+                commandBuffer,
+                pipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(MeshletCullPushConstants),
+                &push);
+            VKE_STAT_ADD(VKE_STAT_PUSH_CONSTANT_BYTES, sizeof(MeshletCullPushConstants));
+            vkCmdDispatch(commandBuffer, model->getMeshletCount(), 1, 1);
+        }
+
+        if (computeTimeline)
+        {
+            submitCompute(frameInfo, frame);
+            return;
+        }
+        // the draws read the counts as indirect parameters and the compacted list as indices
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+    }
+
+    void MeshletCullSystem::submitCompute(FrameInfo &frameInfo, FrameResources &frame)
+    {
+        if (vkEndCommandBuffer(frame.computeCommands) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record meshlet cull compute command buffer");
+        }
+        // the dispatches read meshlets and indices of models loaded while the frame was recorded
+        auto &uploadQueue = vkeDevice.getUploadQueue();
+        uploadQueue.flush();
+        VkeSubmitSemaphores semaphores{};
+        uploadQueue.waitForFlushed(semaphores, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        uint64_t value = computeTimeline->next();
+        semaphores.signal(computeTimeline->getSemaphore(), value);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &frame.computeCommands;
+        semaphores.apply(submitInfo);
+        {
+            VKE_TRACE_SCOPE("Compute submit");
+            if (vkQueueSubmit(vkeDevice.computeQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to submit meshlet cull dispatches");
+            }
+        }
+        // the semaphore wait makes the counts and the compacted list visible to the indirect draws
+        frameInfo.renderer.waitBeforeFrame(
+            computeTimeline->getSemaphore(),
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            value);
+    }
+
+    void MeshletCullSystem::drawCulled(VkCommandBuffer commandBuffer, int frameIndex, uint32_t renderable) const
+    {
+        const FrameResources &frame = frames[frameIndex];
+        vkCmdBindIndexBuffer(commandBuffer, frame.indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirect(
+            commandBuffer,
+            frame.commandBuffer->getBuffer(),
+            static_cast<VkDeviceSize>(renderable) * sizeof(VkDrawIndexedIndirectCommand),
+            1,
+            sizeof(VkDrawIndexedIndirectCommand));
+        VKE_STAT_ADD(VKE_STAT_DRAW_CALLS, 1);
+    }
+} // namespace vke
@@ -1,5 +1,8 @@
 #include "systems/point_light_system.hpp"
 
+#include "render_stats.hpp"
+#include "trace.hpp"
+
 // libs
 #define GLM_FORCE_RADIANT
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -11,7 +14,6 @@
 #include <array>
 #include <cassert>
 #include <stdexcept>
-#include <map>
 #include <settings.hpp>
 #include <iostream>
 
@@ -74,26 +76,31 @@ namespace vke
 
     void PointLightSystem::update(FrameInfo &frameInfo, GlobalUbo &ubo)
     {
+        VKE_TRACE_SCOPE("Update point lights");
         // rotation matrix
         auto rotate = glm::rotate(glm::mat4(1.f), frameInfo.frameTime, {0.f, -1.f, 0.f});
 
 
+        auto &lights = frameInfo.scene.pointLights;
+        auto &transforms = frameInfo.scene.transforms;
         int lightIndex = 0;
-        for (auto &kv : frameInfo.gameObjects)
+        for (uint32_t i = 0; i < lights.size(); i++)
         {
-            auto &obj = kv.second;
-            if (obj.pointLight == nullptr)
-                continue;
-
             assert(lightIndex < MAX_LIGHTS && "Exceeded max point lights");
+            uint32_t transformIndex = transforms.indexOf(lights.entities[i]);
+            assert(transformIndex != VkeSparseSet::NOT_FOUND && "point light without a transform");
 
             // update point light position
-            // obj.transform.translation = glm::vec3(rotate * glm::vec4(obj.transform.translation, 1.f));
-            obj.transform.translation = frameInfo.camera.getPosition()+glm::vec3(0.f,0.f,0);
+            // transforms.setTranslation(transformIndex, glm::vec3(rotate * glm::vec4(transforms.getTranslation(transformIndex), 1.f)));
+            glm::vec3 translation = frameInfo.camera.getPosition()+glm::vec3(0.f,0.f,0);
+            if (translation != transforms.getTranslation(transformIndex))
+            {
+                transforms.setTranslation(transformIndex, translation);
+            }
 
             // copy light to ubo
-            ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
-            ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+            ubo.pointLights[lightIndex].position = glm::vec4(translation, 1.f);
+            ubo.pointLights[lightIndex].color = glm::vec4(lights.colors[i], lights.intensities[i]);
 
             lightIndex++;
         }
@@ -102,17 +109,11 @@ namespace vke
 
     void PointLightSystem::render(FrameInfo &frameInfo)
     {
+        VKE_TRACE_SCOPE("Render point lights");
         // sort lights
-        std::map<float, VkeGameObject::id_t> sorted;
-        for (auto &kv : frameInfo.gameObjects)
-        {
-            auto &obj = kv.second;
-            if (obj.pointLight == nullptr)
-                continue;
-            auto offset = frameInfo.camera.getPosition() - obj.transform.translation;
-            float disSquared = glm::dot(offset, offset);
-            sorted[disSquared] = obj.getId();
-        }
+        auto &lights = frameInfo.scene.pointLights;
+        auto &transforms = frameInfo.scene.transforms;
+        lights.sortBackToFront(transforms, frameInfo.camera.getPosition(), sortedLights);
 
         // render
         vkePipeline->bind(frameInfo.commandBuffer);
@@ -124,18 +125,15 @@ namespace vke
             0,
             1,
             &frameInfo.globalDescriptorSet,
-            0,
-            nullptr);
-        // iterate through sorted lights in reverse order
-        for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+            1,
+            &frameInfo.globalUboOffset);
+        VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
+        for (uint32_t light : sortedLights)
         {
-            // use game obj to find light object
-            auto &obj = frameInfo.gameObjects.at(it->second);
-
             PointLightPushConstants push{};
-            push.position = glm::vec4(obj.transform.translation, 1.f);
-            push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-            push.radius = obj.transform.scale.x;
+            push.position = glm::vec4(transforms.getTranslation(transforms.indexOf(lights.entities[light])), 1.f);
+            push.color = glm::vec4(lights.colors[light], lights.intensities[light]);
+            push.radius = lights.radii[light];
             vkCmdPushConstants(
                 frameInfo.commandBuffer,
                 pipelineLayout,
@@ -144,6 +142,9 @@ namespace vke
                 sizeof(PointLightPushConstants),
                 &push);
             vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+            VKE_STAT_ADD(VKE_STAT_PUSH_CONSTANT_BYTES, sizeof(PointLightPushConstants));
+            VKE_STAT_ADD(VKE_STAT_DRAW_CALLS, 1);
+            VKE_STAT_ADD(VKE_STAT_TRIANGLES, 2);
         }
     }
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "systems/render_system.hpp"
 
+#include "render_stats.hpp"
+#include "trace.hpp"
+
 // libs
 #define GLM_FORCE_RADIANT
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,6 +10,7 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <settings.hpp>
@@ -56,52 +60,168 @@ namespace vke
             std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/shader.vert.spv",
             std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/shader.frag.spv",
             pipelineConfig);
+        for (auto &bundle : chunkBundles)
+        {
+            bundle->invalidate();
+        }
     }
 
-    void RenderSystem::renderGameObjects(FrameInfo &frameInfo)
+    void RenderSystem::renderGameObjects(
+        FrameInfo &frameInfo,
+        const std::vector<uint32_t> &objects,
+        const VkeStaticChunks &staticChunks,
+        const std::vector<uint32_t> &visibleChunks,
+        const MeshletCullSystem *meshletCull)
     {
-        // render
-        vkePipeline->bind(frameInfo.commandBuffer);
+        VKE_TRACE_SCOPE("Render objects");
+        auto &renderables = frameInfo.scene.renderables;
+        auto &transforms = frameInfo.scene.transforms;
+        // LOD from the simplification error projected to the screen
+        float pixelScale = getLodPixelScale(frameInfo);
+        glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+        selectedLods.resize(renderables.size());
+        auto selectLod = [&](uint32_t i)
+        {
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+            selectedLods[i] = static_cast<uint8_t>(renderables.models[i]->selectLod(transforms.getWorldMatrix(transformIndex), cameraPosition, pixelScale, LOD_ERROR_PIXELS));
+        };
+        for (uint32_t i : objects)
+        {
+            assert(!renderables.isStatic[i] && "static objects are drawn through their chunks");
+            selectLod(i);
+        }
+
+        // one secondary per worker, each recording a contiguous slice of the dynamic objects
+        secondaryCommandBuffers.assign(frameInfo.threadPool.getThreadCount(), VK_NULL_HANDLE);
+        recordResults.assign(frameInfo.threadPool.getThreadCount(), VK_SUCCESS);
+        frameInfo.threadPool.parallelFor(
+            static_cast<uint32_t>(objects.size()),
+            [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+            {
+                VKE_TRACE_SCOPE("Record objects");
+                // an exception would escape the worker thread, failures are thrown after the join
+                VkCommandBuffer commandBuffer;
+                VkResult result = frameInfo.renderer.beginSecondaryCommandBuffer(threadIndex, &commandBuffer);
+                if (result == VK_SUCCESS)
+                {
+                    recordGameObjects(frameInfo, commandBuffer, objects, begin, end, meshletCull);
+                    result = vkEndCommandBuffer(commandBuffer);
+                }
+                recordResults[threadIndex] = result;
+                if (result == VK_SUCCESS)
+                {
+                    secondaryCommandBuffers[threadIndex] = commandBuffer;
+                }
+            },
+            RENDER_OBJECTS_PER_THREAD);
+        for (VkResult result : recordResults)
+        {
+            if (result != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to record secondary command buffer");
+            }
+        }
+
+        secondaryCommandBuffers.erase(
+            std::remove(secondaryCommandBuffers.begin(), secondaryCommandBuffers.end(), VK_NULL_HANDLE),
+            secondaryCommandBuffers.end());
+        while (chunkBundles.size() < staticChunks.getChunkCount())
+        {
+            chunkBundles.push_back(std::make_unique<VkeStaticBundle>(vkeDevice));
+        }
+        for (uint32_t chunk : visibleChunks)
+        {
+            const auto &chunkObjects = staticChunks.getChunk(chunk).objects;
+            // culled draws point into the cull pass buffers, which are replaced as the scene grows
+            uint64_t staticSetHash = meshletCull != nullptr ? meshletCull->getVersion() : 0;
+            for (uint32_t i : chunkObjects)
+            {
+                selectLod(i);
+                uint64_t matrixVersion = transforms.getMatrixVersion(transforms.indexOf(renderables.entities[i]));
+                staticSetHash += VkeStaticBundle::hashStaticObject(renderables.entities[i], renderables.models[i], selectedLods[i], renderables.descriptorSets[i], matrixVersion);
+            }
+            secondaryCommandBuffers.push_back(chunkBundles[chunk]->get(
+                frameInfo.renderer,
+                frameInfo.frameIndex,
+                frameInfo.globalDescriptorSet,
+                frameInfo.globalUboOffset,
+                staticSetHash,
+                [&](VkCommandBuffer commandBuffer)
+                { recordGameObjects(frameInfo, commandBuffer, chunkObjects, 0, static_cast<uint32_t>(chunkObjects.size()), meshletCull); }));
+        }
+        frameInfo.renderer.executeSecondaryCommandBuffers(frameInfo.commandBuffer, secondaryCommandBuffers);
+    }
+
+    void RenderSystem::recordGameObjects(FrameInfo &frameInfo, VkCommandBuffer commandBuffer, const std::vector<uint32_t> &objects, uint32_t begin, uint32_t end, const MeshletCullSystem *meshletCull)
+    {
+        vkePipeline->bind(commandBuffer);
 
         vkCmdBindDescriptorSets(
-            frameInfo.commandBuffer,
+            commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             pipelineLayout,
             0,
             1,
             &frameInfo.globalDescriptorSet,
-            0,
-            nullptr);
+            1,
+            &frameInfo.globalUboOffset);
+        VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
 
-        for (auto &kv : frameInfo.gameObjects)
+        auto &renderables = frameInfo.scene.renderables;
+        auto &transforms = frameInfo.scene.transforms;
+        // models of one arena share its buffers, only a different index type needs a rebind
+        const VkeGeometryArena *boundArena = nullptr;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        for (uint32_t i = begin; i < end; i++)
         {
-            auto &obj = kv.second;
-            if (obj.model == nullptr)
-            {
-                continue;
-            }
+            uint32_t object = objects[i];
+            VkeModel *model = renderables.models[object];
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[object]);
+            assert(transformIndex != VkeSparseSet::NOT_FOUND && "renderable without a transform");
+
             SimplePushConstantData push{};
-            push.modelMatrix = obj.transform.mat4();
-            push.normalMatrix = obj.transform.normalMatrix();
-            push.hasNormalMap = obj.material->flags.hasNormal;
+            push.modelMatrix = transforms.getWorldMatrix(transformIndex) * model->getPositionDecodeMatrix();
+            push.normalMatrix = transforms.getNormalMatrix(transformIndex);
+            push.hasNormalMap = renderables.hasNormalMap[object];
             vkCmdPushConstants(
-                frameInfo.commandBuffer,
+                commandBuffer,
                 pipelineLayout,
                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
                 0,
                 sizeof(SimplePushConstantData),
                 &push);
             vkCmdBindDescriptorSets(
-                frameInfo.commandBuffer,
+                commandBuffer,
                 VK_PIPELINE_BIND_POINT_GRAPHICS,
                 pipelineLayout,
                 1,
                 1,
-                &obj.descriptorSet,
+                &renderables.descriptorSets[object],
                 0,
                 nullptr);
-            obj.model->bind(frameInfo.commandBuffer);
-            obj.model->draw(frameInfo.commandBuffer);
+            VKE_STAT_ADD(VKE_STAT_PUSH_CONSTANT_BYTES, sizeof(SimplePushConstantData));
+            VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
+            if (&model->getGeometryArena() != boundArena)
+            {
+                model->bind(commandBuffer);
+                boundArena = &model->getGeometryArena();
+                boundIndexType = model->getIndexType();
+            }
+            else if (model->getIndexType() != boundIndexType)
+            {
+                model->bindIndices(commandBuffer);
+                boundIndexType = model->getIndexType();
+            }
+            if (meshletCull != nullptr && meshletCull->isCulled(object))
+            {
+                meshletCull->drawCulled(commandBuffer, frameInfo.frameIndex, object);
+                // it leaves its compacted indices bound
+                boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+            }
+            else
+            {
+                model->draw(commandBuffer, selectedLods[object]);
+            }
         }
     }
 }
\ No newline at end of file
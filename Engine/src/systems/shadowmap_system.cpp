@@ -1,5 +1,8 @@
 #include "systems/shadowmap_system.hpp"
 #include "systems/render_system.hpp"
+#include "texture_sampler.hpp"
+#include "render_stats.hpp"
+#include "trace.hpp"
 
 // libs
 #define GLM_FORCE_RADIANT
@@ -8,6 +11,7 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <settings.hpp>
@@ -19,16 +23,31 @@ namespace vke
         VkeDevice &device,
         VkRenderPass shadowRenderPass,
         VkDescriptorSetLayout globalSetLayout,
-        VkExtent2D shadowMapExtent) : vkeDevice{device},
-                                      shadowRenderPass{shadowRenderPass},
-                                      shadowMapExtent{shadowMapExtent}
+        VkExtent2D shadowMapExtent,
+        VkImageView shadowDepthImageView,
+        VkeDescriptorAllocator &descriptorAllocator) : vkeDevice{device},
+                                             shadowRenderPass{shadowRenderPass},
+                                             shadowMapExtent{shadowMapExtent}
     {
         createPipelineLayout(globalSetLayout);
         createPipeline(shadowRenderPass);
+        createMomentsResources();
+        createMomentsRenderPass();
+        createMomentsPipeline(shadowDepthImageView, descriptorAllocator);
     }
     ShadowMapSystem::~ShadowMapSystem()
     {
         vkDestroyPipelineLayout(vkeDevice.device(), pipelineLayout, nullptr);
+
+        momentsPipeline = nullptr;
+        vkDestroyPipelineLayout(vkeDevice.device(), momentsPipelineLayout, nullptr);
+        vkDestroyFramebuffer(vkeDevice.device(), momentsFramebuffer, nullptr);
+        vkDestroyRenderPass(vkeDevice.device(), momentsRenderPass, nullptr);
+        vkDestroySampler(vkeDevice.device(), depthSampler, nullptr);
+        vkDestroySampler(vkeDevice.device(), momentsSampler, nullptr);
+        vkDestroyImageView(vkeDevice.device(), momentsImageView, nullptr);
+        vkDestroyImage(vkeDevice.device(), momentsImage, nullptr);
+        vkFreeMemory(vkeDevice.device(), momentsImageMemory, nullptr);
     }
     void ShadowMapSystem::createPipelineLayout(VkDescriptorSetLayout &setLayout)
     {
@@ -54,9 +73,10 @@ namespace vke
     {
         assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
+        usePositionStreams = VkeModel::hasPositionStreams(vkeDevice);
         PipelineConfigInfo pipelineConfig{};
         VkePipeline::defaultPipelineConfigInfo(pipelineConfig);
-        VkePipeline::defaultShadowPipelineConfigInfo(pipelineConfig);
+        VkePipeline::defaultShadowPipelineConfigInfo(pipelineConfig, usePositionStreams);
         pipelineConfig.renderPass = renderPass;
 
         pipelineConfig.pipelineLayout = pipelineLayout;
@@ -65,41 +85,412 @@ namespace vke
             std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/shadow.vert.spv",
             std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/shadow.frag.spv",
             pipelineConfig);
+        for (auto &bundle : chunkBundles)
+        {
+            bundle->invalidate();
+        }
     }
 
-    void ShadowMapSystem::renderShadowMaps(FrameInfo &frameInfo, glm::mat4 &lightViewProj)
+    void ShadowMapSystem::renderShadowMaps(
+        FrameInfo &frameInfo,
+        glm::mat4 &lightViewProj,
+        const std::vector<uint32_t> &casters,
+        const VkeStaticChunks &staticChunks,
+        const std::vector<uint32_t> &visibleChunks)
     {
+        VKE_TRACE_SCOPE("Render shadow casters");
+        auto &renderables = frameInfo.scene.renderables;
+        auto &transforms = frameInfo.scene.transforms;
+        // LOD error measured in shadow map texels, the light projection is orthographic so the texel size
+        // is the same everywhere and doesn't change as the camera moves
+        float texelsPerUnit = std::max(
+            glm::length(glm::vec3(lightViewProj[0][0], lightViewProj[1][0], lightViewProj[2][0])),
+            glm::length(glm::vec3(lightViewProj[0][1], lightViewProj[1][1], lightViewProj[2][1]))) *
+            0.5f * static_cast<float>(SHADOWMAP_DIM);
+        selectedLods.resize(renderables.size());
+        auto selectLod = [&](uint32_t i)
+        {
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[i]);
+            selectedLods[i] = static_cast<uint8_t>(renderables.models[i]->selectLodOrthographic(transforms.getWorldMatrix(transformIndex), texelsPerUnit, SHADOW_LOD_ERROR_PIXELS));
+        };
+        for (uint32_t i : casters)
+        {
+            assert(!renderables.isStatic[i] && "static casters are drawn through their chunks");
+            selectLod(i);
+        }
+
+        secondaryCommandBuffers.assign(frameInfo.threadPool.getThreadCount(), VK_NULL_HANDLE);
+        recordResults.assign(frameInfo.threadPool.getThreadCount(), VK_SUCCESS);
+        frameInfo.threadPool.parallelFor(
+            static_cast<uint32_t>(casters.size()),
+            [&](uint32_t begin, uint32_t end, uint32_t threadIndex)
+            {
+                VKE_TRACE_SCOPE("Record shadow casters");
+                // an exception would escape the worker thread, failures are thrown after the join
+                VkCommandBuffer commandBuffer;
+                VkResult result = frameInfo.renderer.beginSecondaryCommandBuffer(threadIndex, &commandBuffer);
+                if (result == VK_SUCCESS)
+                {
+                    recordShadowCasters(frameInfo, commandBuffer, casters, begin, end);
+                    result = vkEndCommandBuffer(commandBuffer);
+                }
+                recordResults[threadIndex] = result;
+                if (result == VK_SUCCESS)
+                {
+                    secondaryCommandBuffers[threadIndex] = commandBuffer;
+                }
+            },
+            RENDER_OBJECTS_PER_THREAD);
+        for (VkResult result : recordResults)
+        {
+            if (result != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to record secondary command buffer");
+            }
+        }
+
+        secondaryCommandBuffers.erase(
+            std::remove(secondaryCommandBuffers.begin(), secondaryCommandBuffers.end(), VK_NULL_HANDLE),
+            secondaryCommandBuffers.end());
+        while (chunkBundles.size() < staticChunks.getChunkCount())
+        {
+            chunkBundles.push_back(std::make_unique<VkeStaticBundle>(vkeDevice));
+        }
+        for (uint32_t chunk : visibleChunks)
+        {
+            const auto &chunkCasters = staticChunks.getChunk(chunk).objects;
+            uint64_t staticSetHash = 0;
+            for (uint32_t i : chunkCasters)
+            {
+                selectLod(i);
+                uint64_t matrixVersion = transforms.getMatrixVersion(transforms.indexOf(renderables.entities[i]));
+                staticSetHash += VkeStaticBundle::hashStaticObject(renderables.entities[i], renderables.models[i], selectedLods[i], renderables.descriptorSets[i], matrixVersion);
+            }
+            secondaryCommandBuffers.push_back(chunkBundles[chunk]->get(
+                frameInfo.renderer,
+                frameInfo.frameIndex,
+                frameInfo.shadowDescriptorSet,
+                frameInfo.shadowUboOffset,
+                staticSetHash,
+                [&](VkCommandBuffer commandBuffer)
+                { recordShadowCasters(frameInfo, commandBuffer, chunkCasters, 0, static_cast<uint32_t>(chunkCasters.size())); }));
+        }
+        frameInfo.renderer.executeSecondaryCommandBuffers(frameInfo.commandBuffer, secondaryCommandBuffers);
+    }
 
-        vkePipeline->bind(frameInfo.commandBuffer);
+    void ShadowMapSystem::recordShadowCasters(FrameInfo &frameInfo, VkCommandBuffer commandBuffer, const std::vector<uint32_t> &casters, uint32_t begin, uint32_t end)
+    {
+        vkePipeline->bind(commandBuffer);
         vkCmdBindDescriptorSets(
-            frameInfo.commandBuffer,
+            commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             pipelineLayout,
             0,
             1,
             &frameInfo.shadowDescriptorSet,
-            0,
-            nullptr);
+            1,
+            &frameInfo.shadowUboOffset);
+        VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
 
-        for (auto &kv : frameInfo.gameObjects)
+        auto &renderables = frameInfo.scene.renderables;
+        auto &transforms = frameInfo.scene.transforms;
+        // models of one arena share its buffers, only a different index type needs a rebind
+        const VkeGeometryArena *boundArena = nullptr;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        for (uint32_t i = begin; i < end; i++)
         {
-            auto &obj = kv.second;
-            if (!obj.model)
-                continue;
+            uint32_t caster = casters[i];
+            VkeModel *model = renderables.models[caster];
+            uint32_t transformIndex = transforms.indexOf(renderables.entities[caster]);
+            assert(transformIndex != VkeSparseSet::NOT_FOUND && "shadow caster without a transform");
+
             ShadowMapPushConstants push{};
-            push.modelMatrix = obj.transform.mat4();
+            push.modelMatrix = transforms.getWorldMatrix(transformIndex) * model->getPositionDecodeMatrix();
 
             vkCmdPushConstants(
-                frameInfo.commandBuffer,
+                commandBuffer,
                 pipelineLayout,
                 VK_SHADER_STAGE_VERTEX_BIT,
                 0,
                 sizeof(ShadowMapPushConstants),
                 &push);
-            obj.model->bind(frameInfo.commandBuffer);
-            obj.model->draw(frameInfo.commandBuffer);
+            VKE_STAT_ADD(VKE_STAT_PUSH_CONSTANT_BYTES, sizeof(ShadowMapPushConstants));
+            if (&model->getGeometryArena() != boundArena)
+            {
+                if (usePositionStreams)
+                {
+                    model->bindPositions(commandBuffer);
+                }
+                else
+                {
+                    model->bind(commandBuffer);
+                }
+                boundArena = &model->getGeometryArena();
+                boundIndexType = model->getIndexType();
+            }
+            else if (model->getIndexType() != boundIndexType)
+            {
+                model->bindIndices(commandBuffer);
+                boundIndexType = model->getIndexType();
+            }
+            model->draw(commandBuffer, selectedLods[caster]);
+        }
+    }
+    void ShadowMapSystem::createMomentsResources()
+    {
+        // 32 bit moments allow much larger warp exponents (less light bleeding), but linear filtering of
+        // RGBA32F is optional, so fall back to half floats where the device can't filter it
+        try
+        {
+            momentsFormat = vkeDevice.findSupportedFormat(
+                {VK_FORMAT_R32G32B32A32_SFLOAT},
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+            evsmExponents = glm::vec2(40.f, 5.f);
+        }
+        catch (const std::runtime_error &)
+        {
+            momentsFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+            evsmExponents = glm::vec2(5.f, 5.f);
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {momentsExtent.width, momentsExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = momentsFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        vkeDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, momentsImage, momentsImageMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = momentsImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = momentsFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(vkeDevice.device(), &viewInfo, nullptr, &momentsImageView) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create shadow moments image view!");
+        }
+
+        // the moments map is bound in the global set even when EVSM is not selected, so it must always be in a readable layout
+        VkCommandBuffer commandBuffer = vkeDevice.beginSingleTimeCommands();
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = momentsImage;
+        barrier.subresourceRange = viewInfo.subresourceRange;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+        vkeDevice.endSingleTimeCommands(commandBuffer);
+
+        momentsSampler = TextureSampler(vkeDevice, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE).getSampler();
+        depthSampler = TextureSampler(vkeDevice, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE).getSampler();
+    }
+
+    void ShadowMapSystem::createMomentsRenderPass()
+    {
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = momentsFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // every texel is overwritten
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkAttachmentReference colorReference{};
+        colorReference.attachment = 0;
+        colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+
+        std::array<VkSubpassDependency, 2> dependencies;
+
+        // previous frame's main pass must be done sampling before we overwrite the moments
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(vkeDevice.device(), &renderPassInfo, nullptr, &momentsRenderPass) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create shadow moments render pass");
         }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = momentsRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &momentsImageView;
+        framebufferInfo.width = momentsExtent.width;
+        framebufferInfo.height = momentsExtent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(vkeDevice.device(), &framebufferInfo, nullptr, &momentsFramebuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create shadow moments framebuffer!");
+        }
+    }
+
+    void ShadowMapSystem::createMomentsPipeline(VkImageView shadowDepthImageView, VkeDescriptorAllocator &descriptorAllocator)
+    {
+        momentsSetLayout = VkeDescriptorSetLayout::Builder(vkeDevice)
+                               .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // shadow depth
+                               .build();
+
+        VkDescriptorImageInfo depthInfo{};
+        depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        depthInfo.imageView = shadowDepthImageView;
+        depthInfo.sampler = depthSampler;
+        VkeDescriptorWriter(*momentsSetLayout, descriptorAllocator)
+            .writeImage(0, &depthInfo)
+            .build(momentsDescriptorSet);
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(ShadowMomentsPushConstants);
+
+        VkDescriptorSetLayout setLayout = momentsSetLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(vkeDevice.device(), &pipelineLayoutInfo, nullptr, &momentsPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline layout");
+        }
+
+        PipelineConfigInfo pipelineConfig{};
+        VkePipeline::defaultPipelineConfigInfo(pipelineConfig);
+        // fullscreen triangle generated from gl_VertexIndex
+        pipelineConfig.bindingDescriptions.clear();
+        pipelineConfig.attributeDescriptions.clear();
+        pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+        pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+        pipelineConfig.renderPass = momentsRenderPass;
+        pipelineConfig.pipelineLayout = momentsPipelineLayout;
+        momentsPipeline = std::make_unique<VkePipeline>(
+            vkeDevice,
+            std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/shadow_moments.vert.spv",
+            std::string(VKENGINE_ABSOLUTE_PATH) + "Engine/shaders/shadow_moments.frag.spv",
+            pipelineConfig);
+    }
+
+    void ShadowMapSystem::renderMoments(FrameInfo &frameInfo)
+    {
+        VKE_TRACE_SCOPE("Render EVSM moments");
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = momentsRenderPass;
+        renderPassInfo.framebuffer = momentsFramebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = momentsExtent;
+        renderPassInfo.clearValueCount = 0;
+        renderPassInfo.pClearValues = nullptr;
+
+        vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(momentsExtent.width);
+        viewport.height = static_cast<float>(momentsExtent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{{0, 0}, momentsExtent};
+        vkCmdSetViewport(frameInfo.commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
+
+        momentsPipeline->bind(frameInfo.commandBuffer);
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            momentsPipelineLayout,
+            0,
+            1,
+            &momentsDescriptorSet,
+            0,
+            nullptr);
+        VKE_STAT_ADD(VKE_STAT_DESCRIPTOR_SET_BINDS, 1);
+
+        ShadowMomentsPushConstants push{};
+        push.exponents = evsmExponents;
+        push.downsample = static_cast<int>(shadowMapExtent.width / momentsExtent.width);
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            momentsPipelineLayout,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            0,
+            sizeof(ShadowMomentsPushConstants),
+            &push);
+        vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+        VKE_STAT_ADD(VKE_STAT_PUSH_CONSTANT_BYTES, sizeof(ShadowMomentsPushConstants));
+        VKE_STAT_ADD(VKE_STAT_DRAW_CALLS, 1);
+        VKE_STAT_ADD(VKE_STAT_TRIANGLES, 1);
+
+        vkCmdEndRenderPass(frameInfo.commandBuffer);
+    }
+
+    VkDescriptorImageInfo ShadowMapSystem::getMomentsDescriptor() const
+    {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = momentsImageView;
+        imageInfo.sampler = momentsSampler;
+        return imageInfo;
     }
+
     glm::mat4 ShadowMapSystem::getLightViewProjection(const glm::vec3 &dirLightPos, const glm::vec3 &cameraPosition, float sceneRadius, VkeCamera &camera)
     {
         float zNear = 0.01f;
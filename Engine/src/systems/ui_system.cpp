@@ -10,9 +10,14 @@
 #include "descriptors.hpp"
 #include "device.hpp"
 
+// std
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+
 namespace vke
 {
-    UISystem::UISystem(VkeWindow &vkeWindow, VkeDevice &vkeDevice, VkeDescriptorPool &globalPool, VkeRenderer &vkeRenderer)
+    UISystem::UISystem(VkeWindow &vkeWindow, VkeDevice &vkeDevice, VkeDescriptorPool &descriptorPool, VkeRenderer &vkeRenderer)
     {
         IMGUI_CHECKVERSION();
         ImGui::CreateContext();
@@ -31,7 +36,7 @@ namespace vke
         init_info.QueueFamily = vkeDevice.findPhysicalQueueFamilies().graphicsFamily;
         init_info.Queue = vkeDevice.graphicsQueue();
         init_info.PipelineCache = VK_NULL_HANDLE;
-        init_info.DescriptorPool = globalPool.getDescriptorPool();
+        init_info.DescriptorPool = descriptorPool.getDescriptorPool();
         init_info.Subpass = 0;
         init_info.MinImageCount = MAX_FRAMES_IN_FLIGHT;
         init_info.ImageCount = MAX_FRAMES_IN_FLIGHT;
@@ -91,4 +96,30 @@ namespace vke
         style.ScrollbarSize = 10.0f;
         style.Alpha = 0.9f;
     }
+
+    void UISystem::renderStatsOverlay(const VkeStatsHistory &stats)
+    {
+        ImGui::Begin("Performance");
+        const auto &frameTimes = stats.getFrameTimes();
+        ImGui::Text("Frame time min %.2f  avg %.2f  max %.2f  p99 %.2f ms", frameTimes.min, frameTimes.average, frameTimes.max, frameTimes.p99);
+        ImGui::PlotLines("##frame times", stats.getFrameTimeHistory(), stats.getHistorySize(), stats.getHistoryOffset(),
+                         nullptr, 0.0f, std::max(frameTimes.max, 1.0f), ImVec2(0.0f, 60.0f));
+
+#if RENDER_STATS_ENABLED
+        char value[32];
+        for (uint32_t i = 0; i < VKE_STAT_COUNT; i++)
+        {
+            VkeStatCounter counter = static_cast<VkeStatCounter>(i);
+            snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(stats.getLatest(counter)));
+            ImGui::PushID(static_cast<int>(i));
+            // the latest value is drawn over its own graph, scaled to the window's peak
+            ImGui::PlotLines(VkeRenderStats::getName(counter), stats.getHistory(counter), stats.getHistorySize(), stats.getHistoryOffset(),
+                             value, 0.0f, FLT_MAX, ImVec2(0.0f, 30.0f));
+            ImGui::PopID();
+        }
+#else
+        ImGui::Text("Render counters are compiled out, see RENDER_STATS_ENABLED");
+#endif
+        ImGui::End();
+    }
 } // namespace vke
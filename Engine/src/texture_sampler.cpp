@@ -10,8 +10,12 @@ namespace vke
     {
         createTextureSampler(addressMode);
     }
+    TextureSampler::TextureSampler(VkeDevice &device, VkSamplerAddressMode addressMode, VkCompareOp compareOp) : vkeDevice(device)
+    {
+        createTextureSampler(addressMode, VK_TRUE, compareOp);
+    }
 
-    void TextureSampler::createTextureSampler(VkSamplerAddressMode addressMode)
+    void TextureSampler::createTextureSampler(VkSamplerAddressMode addressMode, VkBool32 compareEnable, VkCompareOp compareOp)
     {
         VkPhysicalDeviceProperties properties{};
         vkGetPhysicalDeviceProperties(vkeDevice.getPhysicalDevice(), &properties);
@@ -27,13 +31,23 @@ namespace vke
         samplerInfo.addressModeW = addressMode;
         samplerInfo.mipLodBias = 0.0f;
         samplerInfo.maxAnisotropy = 16.0f;
-        samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+        samplerInfo.compareEnable = compareEnable;
+        samplerInfo.compareOp = compareOp;
         samplerInfo.minLod = 0.0f;
         samplerInfo.maxLod = 100.f;
 
         samplerInfo.anisotropyEnable = VK_TRUE;
         samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
+        if (compareEnable)
+        {
+            // depth maps have a single mip, and anisotropy is not allowed on comparison lookups on every device
+            samplerInfo.anisotropyEnable = VK_FALSE;
+            samplerInfo.maxAnisotropy = 1.0f;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.maxLod = 0.0f;
+        }
+
         textureSampler = VkSampler{};
         if (vkCreateSampler(vkeDevice.device(), &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
         {
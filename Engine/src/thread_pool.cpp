@@ -0,0 +1,95 @@
+#include "thread_pool.hpp"
+
+#include "trace.hpp"
+
+// std
+#include <algorithm>
+#include <string>
+
+namespace vke
+{
+    VkeThreadPool::VkeThreadPool(uint32_t threadCount)
+    {
+        threadCount = std::max(threadCount, 1u);
+        workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            workers.emplace_back(&VkeThreadPool::workerLoop, this, i);
+        }
+    }
+    VkeThreadPool::~VkeThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void VkeThreadPool::parallelFor(uint32_t count, const RangeJob &job, uint32_t minRangeSize)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        uint32_t threadCount = getThreadCount();
+        uint32_t size = std::max((count + threadCount - 1) / threadCount, std::max(minRangeSize, 1u));
+        if (size >= count)
+        {
+            // a single range is not worth waking the workers for
+            job(0, count, 0);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock{mutex};
+        currentJob = &job;
+        jobCount = count;
+        rangeSize = size;
+        pendingWorkers = threadCount;
+        generation++;
+        wakeWorkers.notify_all();
+        jobDone.wait(lock, [this]
+                     { return pendingWorkers == 0; });
+        currentJob = nullptr;
+    }
+
+    void VkeThreadPool::workerLoop(uint32_t threadIndex)
+    {
+        VkeTrace::setThreadName("Worker " + std::to_string(threadIndex));
+        uint64_t seenGeneration = 0;
+        while (true)
+        {
+            const RangeJob *job;
+            uint32_t begin;
+            uint32_t end;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                wakeWorkers.wait(lock, [this, seenGeneration]
+                                 { return stopping || generation != seenGeneration; });
+                if (stopping)
+                {
+                    return;
+                }
+                seenGeneration = generation;
+                job = currentJob;
+                begin = std::min(threadIndex * rangeSize, jobCount);
+                end = std::min(begin + rangeSize, jobCount);
+            }
+
+            if (begin < end)
+            {
+                (*job)(begin, end, threadIndex);
+            }
+
+            std::lock_guard<std::mutex> lock{mutex};
+            if (--pendingWorkers == 0)
+            {
+                jobDone.notify_one();
+            }
+        }
+    }
+} // namespace vke
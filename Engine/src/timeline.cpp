@@ -0,0 +1,108 @@
+#include "timeline.hpp"
+
+#include "device.hpp"
+#include "trace.hpp"
+
+// std
+#include <stdexcept>
+
+namespace vke
+{
+    VkeTimeline::VkeTimeline(VkeDevice &device) : vkeDevice{device}
+    {
+        VkSemaphoreTypeCreateInfoKHR typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        if (vkCreateSemaphore(vkeDevice.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create timeline semaphore!");
+        }
+    }
+
+    VkeTimeline::~VkeTimeline()
+    {
+        vkDestroySemaphore(vkeDevice.device(), semaphore, nullptr);
+    }
+
+    uint64_t VkeTimeline::getCompletedValue()
+    {
+        uint64_t value = 0;
+        if (vkeDevice.getSemaphoreCounterValue(vkeDevice.device(), semaphore, &value) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to read timeline semaphore!");
+        }
+        completedValue = value;
+        return completedValue;
+    }
+
+    void VkeTimeline::wait(uint64_t value)
+    {
+        if (value <= completedValue)
+        {
+            return;
+        }
+        VKE_TRACE_SCOPE("Wait timeline");
+        VkSemaphoreWaitInfoKHR waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore;
+        waitInfo.pValues = &value;
+        if (vkeDevice.waitSemaphores(vkeDevice.device(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to wait for timeline semaphore!");
+        }
+        completedValue = value;
+    }
+
+    void VkeSubmitSemaphores::wait(VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value)
+    {
+        waitSemaphores.push_back(semaphore);
+        waitStages.push_back(stage);
+        waitValues.push_back(value);
+        hasTimelineValues = hasTimelineValues || value != 0;
+    }
+
+    void VkeSubmitSemaphores::signal(VkSemaphore semaphore, uint64_t value)
+    {
+        signalSemaphores.push_back(semaphore);
+        signalValues.push_back(value);
+        hasTimelineValues = hasTimelineValues || value != 0;
+    }
+
+    void VkeSubmitSemaphores::apply(VkSubmitInfo &submitInfo)
+    {
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+        if (!hasTimelineValues)
+        {
+            return;
+        }
+        // one value per semaphore, binary ones included
+        timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+        timelineInfo.pNext = submitInfo.pNext;
+        submitInfo.pNext = &timelineInfo;
+    }
+
+    void VkeSubmitSemaphores::clear()
+    {
+        waitSemaphores.clear();
+        waitStages.clear();
+        waitValues.clear();
+        signalSemaphores.clear();
+        signalValues.clear();
+        hasTimelineValues = false;
+    }
+} // namespace vke
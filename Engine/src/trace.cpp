@@ -0,0 +1,235 @@
+#include "trace.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vke
+{
+    namespace
+    {
+        static_assert((TRACE_RING_CAPACITY & (TRACE_RING_CAPACITY - 1)) == 0, "TRACE_RING_CAPACITY must be a power of two");
+
+        // fields are atomics so a dump can read a slot its thread is rewriting, the copy is checked afterwards
+        struct TraceEvent
+        {
+            std::atomic<const char *> name{nullptr};
+            std::atomic<uint64_t> beginNs{0};
+            std::atomic<uint64_t> endNs{0};
+        };
+
+        struct ThreadRing
+        {
+            std::array<TraceEvent, TRACE_RING_CAPACITY> events;
+            // events ever written, only the owning thread stores it
+            std::atomic<uint64_t> head{0};
+            uint32_t threadId = 0;
+            // guarded by the registry mutex
+            std::string threadName;
+        };
+
+        struct TraceRegistry
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadRing>> rings;
+        };
+
+        // never destroyed, threads may still record while statics are torn down
+        TraceRegistry &registry()
+        {
+            static TraceRegistry *instance = new TraceRegistry{};
+            return *instance;
+        }
+
+        // rings outlive their threads so a dump still shows threads that already exited
+        ThreadRing &threadRing()
+        {
+            thread_local ThreadRing *ring = nullptr;
+            if (ring == nullptr)
+            {
+                auto &traceRegistry = registry();
+                std::lock_guard<std::mutex> lock{traceRegistry.mutex};
+                traceRegistry.rings.push_back(std::make_unique<ThreadRing>());
+                ring = traceRegistry.rings.back().get();
+                ring->threadId = static_cast<uint32_t>(traceRegistry.rings.size());
+                ring->threadName = "Thread " + std::to_string(ring->threadId);
+            }
+            return *ring;
+        }
+
+        struct CopiedEvent
+        {
+            const char *name;
+            uint64_t beginNs;
+            uint64_t endNs;
+            uint32_t threadId;
+        };
+
+        void writeJsonString(std::ofstream &file, const char *text)
+        {
+            file << '"';
+            for (const char *c = text; *c != '\0'; c++)
+            {
+                if (*c == '"' || *c == '\\')
+                {
+                    file << '\\' << *c;
+                }
+                else if (static_cast<unsigned char>(*c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+                    file << escaped;
+                }
+                else
+                {
+                    file << *c;
+                }
+            }
+            file << '"';
+        }
+    } // namespace
+
+    uint64_t VkeTrace::now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    void VkeTrace::record(const char *name, uint64_t beginNs, uint64_t endNs)
+    {
+        ThreadRing &ring = threadRing();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        TraceEvent &event = ring.events[head & (TRACE_RING_CAPACITY - 1)];
+        event.name.store(name, std::memory_order_relaxed);
+        event.beginNs.store(beginNs, std::memory_order_relaxed);
+        event.endNs.store(endNs, std::memory_order_relaxed);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    void VkeTrace::setThreadName(const std::string &name)
+    {
+        ThreadRing &ring = threadRing();
+        std::lock_guard<std::mutex> lock{registry().mutex};
+        ring.threadName = name;
+    }
+
+    bool VkeTrace::writeChromeTrace(const std::string &path, double seconds)
+    {
+        uint64_t cutoffNs = now() - static_cast<uint64_t>(seconds * 1e9);
+        std::vector<CopiedEvent> events;
+        std::vector<std::pair<uint32_t, std::string>> threadNames;
+        {
+            // only keeps threads from registering or renaming while the rings are walked
+            auto &traceRegistry = registry();
+            std::lock_guard<std::mutex> lock{traceRegistry.mutex};
+            for (const auto &ring : traceRegistry.rings)
+            {
+                threadNames.emplace_back(ring->threadId, ring->threadName);
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                uint64_t first = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+                size_t copiedFrom = events.size();
+                for (uint64_t i = first; i < head; i++)
+                {
+                    const TraceEvent &event = ring->events[i & (TRACE_RING_CAPACITY - 1)];
+                    events.push_back({event.name.load(std::memory_order_relaxed),
+                                      event.beginNs.load(std::memory_order_relaxed),
+                                      event.endNs.load(std::memory_order_relaxed),
+                                      ring->threadId});
+                }
+                // the owner kept writing, slots up to the one it may be writing now were overwritten
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64_t headAfter = ring->head.load(std::memory_order_relaxed);
+                uint64_t firstIntact = headAfter + 1 > TRACE_RING_CAPACITY ? headAfter + 1 - TRACE_RING_CAPACITY : 0;
+                if (firstIntact > first)
+                {
+                    size_t overwritten = static_cast<size_t>(std::min(firstIntact - first, head - first));
+                    events.erase(events.begin() + copiedFrom, events.begin() + copiedFrom + overwritten);
+                }
+            }
+        }
+        events.erase(std::remove_if(events.begin(), events.end(), [cutoffNs](const CopiedEvent &event)
+                                    { return event.endNs < cutoffNs; }),
+                     events.end());
+        std::sort(events.begin(), events.end(), [](const CopiedEvent &a, const CopiedEvent &b)
+                  { return a.beginNs < b.beginNs; });
+
+        std::ofstream file{path, std::ios::out | std::ios::trunc};
+        if (!file.is_open())
+        {
+            return false;
+        }
+        // microseconds from the first scope, as the format expects
+        uint64_t originNs = events.empty() ? 0 : events.front().beginNs;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool firstEntry = true;
+        for (const auto &[threadId, threadName] : threadNames)
+        {
+            file << (firstEntry ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId << ",\"args\":{\"name\":";
+            writeJsonString(file, threadName.c_str());
+            file << "}}";
+            firstEntry = false;
+        }
+        char numbers[96];
+        for (const auto &event : events)
+        {
+            file << (firstEntry ? "" : ",") << "\n{\"name\":";
+            writeJsonString(file, event.name);
+            std::snprintf(numbers, sizeof(numbers), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                          static_cast<double>(event.beginNs - originNs) * 1e-3,
+                          static_cast<double>(event.endNs - event.beginNs) * 1e-3);
+            file << numbers << ",\"pid\":1,\"tid\":" << event.threadId << '}';
+            firstEntry = false;
+        }
+        file << "\n]}\n";
+        return file.good();
+    }
+
+    VkeFlightRecorder::VkeFlightRecorder(double budgetMilliseconds, double seconds) : budgetMilliseconds{budgetMilliseconds}, seconds{seconds}
+    {
+    }
+
+    bool VkeFlightRecorder::endFrame()
+    {
+        uint64_t frameEndNs = VkeTrace::now();
+        uint64_t beginNs = frameBeginNs;
+        frameBeginNs = frameEndNs;
+        frameCount++;
+        // the first call has no frame start to measure from
+        if (beginNs == 0)
+        {
+            return false;
+        }
+#if TRACE_ENABLED
+        VkeTrace::record("Frame", beginNs, frameEndNs);
+
+        double frameMilliseconds = static_cast<double>(frameEndNs - beginNs) * 1e-6;
+        bool cooledDown = lastDumpNs == 0 || static_cast<double>(frameEndNs - lastDumpNs) * 1e-9 >= seconds;
+        if (!enabled || frameMilliseconds <= budgetMilliseconds || !cooledDown)
+        {
+            return false;
+        }
+        std::string path = "hitch_" + std::to_string(frameCount) + ".json";
+        if (!VkeTrace::writeChromeTrace(path, seconds))
+        {
+            std::cout << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+        std::cout << "Frame " << frameCount << " took " << frameMilliseconds << " ms, trace written to: " << path << std::endl;
+        lastDumpPath = path;
+        dumpCount++;
+        lastDumpNs = frameBeginNs = VkeTrace::now();
+        return true;
+#else
+        return false;
+#endif
+    }
+} // namespace vke
@@ -0,0 +1,172 @@
+#include "transform_kernels.hpp"
+#include "simd.hpp"
+
+// std
+#include <cmath>
+
+namespace vke
+{
+    namespace
+    {
+        using simd::ScalarLanes;
+        using simd::VectorLanes;
+
+        // sin and cos of x, Cephes style: reduce to [-pi/4, pi/4] around the nearest multiple of pi/2,
+        // evaluate both minimax polynomials and pick / negate by quadrant. Branch free so it vectorizes.
+        template <typename L>
+        inline void sinCos(typename L::Reg x, typename L::Reg &sinOut, typename L::Reg &cosOut)
+        {
+            using Reg = typename L::Reg;
+            const Reg one = L::set1(1.f);
+            const Reg half = L::set1(0.5f);
+
+            Reg j = L::floor(L::fmadd(x, L::set1(0.636619772f), half));
+            // pi/2 split in three parts so j * pi/2 is subtracted without losing precision
+            Reg r = L::fmadd(j, L::set1(-1.5703125f), x);
+            r = L::fmadd(j, L::set1(-4.837512969970703125e-4f), r);
+            r = L::fmadd(j, L::set1(-7.54978995489188216e-8f), r);
+            Reg r2 = L::mul(r, r);
+
+            Reg s = L::fmadd(r2, L::set1(-1.9515295891e-4f), L::set1(8.3321608736e-3f));
+            s = L::fmadd(s, r2, L::set1(-1.6666654611e-1f));
+            s = L::fmadd(L::mul(s, r2), r, r);
+
+            Reg c = L::fmadd(r2, L::set1(2.443315711809948e-5f), L::set1(-1.388731625493765e-3f));
+            c = L::fmadd(c, r2, L::set1(4.166664568298827e-2f));
+            c = L::fmadd(L::mul(c, r2), r2, L::fmadd(r2, L::set1(-0.5f), one));
+
+            // quadrant q = j mod 4: sin is s, c, -s, -c and cos is c, -s, -c, s
+            const Reg quarter = L::set1(0.25f);
+            const Reg two = L::set1(2.f);
+            const Reg four = L::set1(4.f);
+            Reg q = L::sub(j, L::mul(four, L::floor(L::mul(j, quarter))));
+            Reg qHalf = L::floor(L::mul(q, half));
+            Reg odd = L::sub(q, L::mul(two, qHalf));
+            Reg q1 = L::add(q, one);
+            Reg cosHalf = L::floor(L::mul(L::sub(q1, L::mul(four, L::floor(L::mul(q1, quarter)))), half));
+
+            Reg sinBase = L::fmadd(odd, L::sub(c, s), s);
+            Reg cosBase = L::fmadd(odd, L::sub(s, c), c);
+            sinOut = L::mul(sinBase, L::fmadd(qHalf, L::set1(-2.f), one));
+            cosOut = L::mul(cosBase, L::fmadd(cosHalf, L::set1(-2.f), one));
+        }
+
+        // libm is faster than the polynomial when there is only one lane to evaluate
+        template <>
+        inline void sinCos<ScalarLanes>(float x, float &sinOut, float &cosOut)
+        {
+            sinOut = std::sin(x);
+            cosOut = std::cos(x);
+        }
+
+        // count must be a multiple of L::WIDTH
+        template <typename L>
+        void computeBatch(
+            const glm::vec3 *translations,
+            const glm::vec3 *rotations,
+            const glm::vec3 *scales,
+            const uint32_t *indices,
+            uint32_t count,
+            glm::mat4 *worldMatrices,
+            glm::mat4 *normalMatrices)
+        {
+            using Reg = typename L::Reg;
+            constexpr uint32_t W = L::WIDTH;
+
+            // gathered inputs and computed columns, transposed so every row is one register
+            alignas(32) float rotX[W], rotY[W], rotZ[W], scaleX[W], scaleY[W], scaleZ[W];
+            alignas(32) float world[9][W];
+            alignas(32) float normal[9][W];
+
+            for (uint32_t base = 0; base < count; base += W)
+            {
+                for (uint32_t lane = 0; lane < W; lane++)
+                {
+                    uint32_t index = indices[base + lane];
+                    rotX[lane] = rotations[index].x;
+                    rotY[lane] = rotations[index].y;
+                    rotZ[lane] = rotations[index].z;
+                    scaleX[lane] = scales[index].x;
+                    scaleY[lane] = scales[index].y;
+                    scaleZ[lane] = scales[index].z;
+                }
+
+                // same YXZ composition as TransformComponent::mat4()
+                Reg s1, c1, s2, c2, s3, c3;
+                sinCos<L>(L::load(rotY), s1, c1);
+                sinCos<L>(L::load(rotX), s2, c2);
+                sinCos<L>(L::load(rotZ), s3, c3);
+
+                Reg rotation[9] = {
+                    L::fmadd(L::mul(s1, s2), s3, L::mul(c1, c3)),
+                    L::mul(c2, s3),
+                    L::sub(L::mul(L::mul(c1, s2), s3), L::mul(c3, s1)),
+                    L::sub(L::mul(L::mul(c3, s1), s2), L::mul(c1, s3)),
+                    L::mul(c2, c3),
+                    L::fmadd(L::mul(c1, c3), s2, L::mul(s1, s3)),
+                    L::mul(c2, s1),
+                    L::sub(L::set1(0.f), s2),
+                    L::mul(c1, c2),
+                };
+                const Reg one = L::set1(1.f);
+                Reg scale[3] = {L::load(scaleX), L::load(scaleY), L::load(scaleZ)};
+                Reg invScale[3] = {L::div(one, scale[0]), L::div(one, scale[1]), L::div(one, scale[2])};
+                for (int column = 0; column < 3; column++)
+                {
+                    for (int row = 0; row < 3; row++)
+                    {
+                        L::store(world[column * 3 + row], L::mul(scale[column], rotation[column * 3 + row]));
+                        L::store(normal[column * 3 + row], L::mul(invScale[column], rotation[column * 3 + row]));
+                    }
+                }
+
+                for (uint32_t lane = 0; lane < W; lane++)
+                {
+                    uint32_t index = indices[base + lane];
+                    const glm::vec3 &t = translations[index];
+                    worldMatrices[index] = glm::mat4{
+                        {world[0][lane], world[1][lane], world[2][lane], 0.f},
+                        {world[3][lane], world[4][lane], world[5][lane], 0.f},
+                        {world[6][lane], world[7][lane], world[8][lane], 0.f},
+                        {t.x, t.y, t.z, 1.f}};
+                    normalMatrices[index] = glm::mat4{
+                        {normal[0][lane], normal[1][lane], normal[2][lane], 0.f},
+                        {normal[3][lane], normal[4][lane], normal[5][lane], 0.f},
+                        {normal[6][lane], normal[7][lane], normal[8][lane], 0.f},
+                        {0.f, 0.f, 0.f, 1.f}};
+                }
+            }
+        }
+    } // namespace
+
+    void computeTransformMatrices(
+        const glm::vec3 *translations,
+        const glm::vec3 *rotations,
+        const glm::vec3 *scales,
+        const uint32_t *indices,
+        uint32_t count,
+        glm::mat4 *worldMatrices,
+        glm::mat4 *normalMatrices)
+    {
+        uint32_t vectorCount = count - count % VectorLanes::WIDTH;
+        computeBatch<VectorLanes>(translations, rotations, scales, indices, vectorCount, worldMatrices, normalMatrices);
+        computeBatch<ScalarLanes>(translations, rotations, scales, indices + vectorCount, count - vectorCount, worldMatrices, normalMatrices);
+    }
+
+    void computeTransformMatricesScalar(
+        const glm::vec3 *translations,
+        const glm::vec3 *rotations,
+        const glm::vec3 *scales,
+        const uint32_t *indices,
+        uint32_t count,
+        glm::mat4 *worldMatrices,
+        glm::mat4 *normalMatrices)
+    {
+        computeBatch<ScalarLanes>(translations, rotations, scales, indices, count, worldMatrices, normalMatrices);
+    }
+
+    const char *getTransformKernelName()
+    {
+        return VectorLanes::NAME;
+    }
+} // namespace vke
@@ -0,0 +1,417 @@
+#include "upload_queue.hpp"
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "render_stats.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vke
+{
+    namespace
+    {
+        // everything that reads uploaded geometry, meshlets and textures
+        constexpr VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                         VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        constexpr VkAccessFlags CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                                  VK_ACCESS_INDEX_READ_BIT |
+                                                  VK_ACCESS_SHADER_READ_BIT;
+
+        // uploads larger than a block get a block of their own, freed rather than reused
+        constexpr VkDeviceSize STAGING_BLOCK_SIZE = 8 * 1024 * 1024;
+        // reusable blocks kept once their batch retires, a loading burst's surplus is freed
+        constexpr size_t MAX_FREE_STAGING_BLOCKS = 4;
+        // buffer to image copies need offsets aligned to 4 and the texel size
+        constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+    } // namespace
+
+    VkeUploadQueue::VkeUploadQueue(VkeDevice &device) : vkeDevice{device}, timeline{device}
+    {
+        QueueFamilyIndices indices = vkeDevice.findPhysicalQueueFamilies();
+        dedicatedTransfer = vkeDevice.hasDedicatedTransferQueue();
+        transferFamily = indices.transferFamily;
+        graphicsFamily = indices.graphicsFamily;
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        if (vkCreateCommandPool(vkeDevice.device(), &poolInfo, nullptr, &acquireCommandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload acquire command pool!");
+        }
+    }
+
+    VkeUploadQueue::~VkeUploadQueue()
+    {
+        waitIdle();
+        for (auto &block : freeStagingBlocks)
+        {
+            destroyStagingBlock(block);
+        }
+        vkDestroyCommandPool(vkeDevice.device(), acquireCommandPool, nullptr);
+    }
+
+    VkCommandBuffer VkeUploadQueue::getPendingCommands()
+    {
+        if (pending.transferCommands != VK_NULL_HANDLE)
+        {
+            return pending.transferCommands;
+        }
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = vkeDevice.getTransferCommandPool();
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(vkeDevice.device(), &allocInfo, &pending.transferCommands) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(pending.transferCommands, &beginInfo);
+        return pending.transferCommands;
+    }
+
+    VkeUploadQueue::StagingBlock VkeUploadQueue::createStagingBlock(VkDeviceSize size)
+    {
+        StagingBlock block{};
+        block.size = size;
+        vkeDevice.createBuffer(
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            block.buffer,
+            block.memory);
+        if (vkMapMemory(vkeDevice.device(), block.memory, 0, size, 0, &block.mapped) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to map staging memory!");
+        }
+        return block;
+    }
+
+    void VkeUploadQueue::destroyStagingBlock(StagingBlock &block)
+    {
+        vkUnmapMemory(vkeDevice.device(), block.memory);
+        vkDestroyBuffer(vkeDevice.device(), block.buffer, nullptr);
+        vkFreeMemory(vkeDevice.device(), block.memory, nullptr);
+    }
+
+    VkBuffer VkeUploadQueue::stage(const void *data, VkDeviceSize size, VkDeviceSize &offset)
+    {
+        auto &blocks = pending.stagingBlocks;
+        VkDeviceSize alignedUsed = blocks.empty() ? 0 : (blocks.back().used + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+        if (blocks.empty() || alignedUsed + size > blocks.back().size)
+        {
+            if (size <= STAGING_BLOCK_SIZE && !freeStagingBlocks.empty())
+            {
+                blocks.push_back(freeStagingBlocks.back());
+                freeStagingBlocks.pop_back();
+            }
+            else
+            {
+                blocks.push_back(createStagingBlock(std::max(size, STAGING_BLOCK_SIZE)));
+            }
+            alignedUsed = 0;
+        }
+        StagingBlock &block = blocks.back();
+        offset = alignedUsed;
+        std::memcpy(static_cast<char *>(block.mapped) + offset, data, static_cast<size_t>(size));
+        block.used = offset + size;
+        VKE_STAT_ADD(VKE_STAT_STAGING_BYTES, size);
+        return block.buffer;
+    }
+
+    void VkeUploadQueue::uploadBuffer(VkeBuffer &buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock{mutex};
+        VkDeviceSize stagingOffset;
+        VkBuffer stagingBuffer = stage(data, size, stagingOffset);
+        VkCommandBuffer commandBuffer = getPendingCommands();
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = offset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer.getBuffer(), 1, &copyRegion);
+
+        if (!dedicatedTransfer)
+        {
+            // one memory barrier at the end of the batch covers every buffer
+            pendingBufferWrites = true;
+            return;
+        }
+        if (buffer.isConcurrent())
+        {
+            // no owner to hand it to, the semaphores every consumer waits on make the copy visible
+            return;
+        }
+        // The release and the acquire are the same barrier, on both queues. Whatever the range held
+        // before is overwritten, so it needs no transfer to the transfer family first.
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.buffer = buffer.getBuffer();
+        barrier.offset = offset;
+        barrier.size = size;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = CONSUMER_ACCESS;
+        bufferAcquires.push_back(barrier);
+    }
+
+    void VkeUploadQueue::uploadImage(VkImage image, uint32_t width, uint32_t height, const void *texels, VkDeviceSize size)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        VkDeviceSize stagingOffset;
+        VkBuffer stagingBuffer = stage(texels, size, stagingOffset);
+        VkCommandBuffer commandBuffer = getPendingCommands();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = stagingOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        // with a dedicated transfer family, the release and the acquire both make the layout transition
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        if (!dedicatedTransfer)
+        {
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
+            return;
+        }
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        imageAcquires.push_back(barrier);
+    }
+
+    void VkeUploadQueue::flush()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        flushLocked();
+    }
+
+    void VkeUploadQueue::flushLocked()
+    {
+        retire(false);
+        if (pending.transferCommands == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        VKE_TRACE_SCOPE("Upload flush");
+        if (pendingBufferWrites)
+        {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = CONSUMER_ACCESS;
+            vkCmdPipelineBarrier(
+                pending.transferCommands,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES,
+                0,
+                1, &barrier,
+                0, nullptr,
+                0, nullptr);
+        }
+        if (vkEndCommandBuffer(pending.transferCommands) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to record upload command buffer!");
+        }
+
+        pending.transferValue = timeline.next();
+        VkeSubmitSemaphores transferSemaphores{};
+        transferSemaphores.signal(timeline.getSemaphore(), pending.transferValue);
+        VkSubmitInfo transferSubmit{};
+        transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmit.commandBufferCount = 1;
+        transferSubmit.pCommandBuffers = &pending.transferCommands;
+        transferSemaphores.apply(transferSubmit);
+        // without a dedicated family the transfer queue is the graphics queue, later frames are ordered after the barriers
+        if (vkQueueSubmit(vkeDevice.transferQueue(), 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit uploads!");
+        }
+
+        if (dedicatedTransfer)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = acquireCommandPool;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(vkeDevice.device(), &allocInfo, &pending.acquireCommands) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate upload acquire command buffer!");
+            }
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(pending.acquireCommands, &beginInfo);
+            vkCmdPipelineBarrier(
+                pending.acquireCommands,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, CONSUMER_STAGES,
+                0,
+                0, nullptr,
+                static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+                static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+            vkEndCommandBuffer(pending.acquireCommands);
+
+            // the graphics queue runs the acquires before anything submitted after them
+            VkeTimeline &graphicsTimeline = vkeDevice.getGraphicsTimeline();
+            pending.acquireValue = graphicsTimeline.next();
+            VkeSubmitSemaphores acquireSemaphores{};
+            acquireSemaphores.wait(timeline.getSemaphore(), CONSUMER_STAGES, pending.transferValue);
+            acquireSemaphores.signal(graphicsTimeline.getSemaphore(), pending.acquireValue);
+            VkSubmitInfo acquireSubmit{};
+            acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireSubmit.commandBufferCount = 1;
+            acquireSubmit.pCommandBuffers = &pending.acquireCommands;
+            acquireSemaphores.apply(acquireSubmit);
+            if (vkQueueSubmit(vkeDevice.graphicsQueue(), 1, &acquireSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to submit upload acquires!");
+            }
+        }
+
+        submitted.push_back(std::move(pending));
+        pending = Batch{};
+        pendingBufferWrites = false;
+        bufferAcquires.clear();
+        imageAcquires.clear();
+    }
+
+    bool VkeUploadQueue::isFinished(Batch &batch)
+    {
+        return timeline.isCompleted(batch.transferValue) &&
+               (batch.acquireValue == 0 || vkeDevice.getGraphicsTimeline().isCompleted(batch.acquireValue));
+    }
+
+    void VkeUploadQueue::retire(bool wait)
+    {
+        while (!submitted.empty())
+        {
+            Batch &batch = submitted.front();
+            if (wait)
+            {
+                timeline.wait(batch.transferValue);
+                if (batch.acquireValue != 0)
+                {
+                    vkeDevice.getGraphicsTimeline().wait(batch.acquireValue);
+                }
+            }
+            else if (!isFinished(batch))
+            {
+                break;
+            }
+            vkFreeCommandBuffers(vkeDevice.device(), vkeDevice.getTransferCommandPool(), 1, &batch.transferCommands);
+            if (batch.acquireCommands != VK_NULL_HANDLE)
+            {
+                vkFreeCommandBuffers(vkeDevice.device(), acquireCommandPool, 1, &batch.acquireCommands);
+            }
+            for (auto &block : batch.stagingBlocks)
+            {
+                if (block.size == STAGING_BLOCK_SIZE && freeStagingBlocks.size() < MAX_FREE_STAGING_BLOCKS)
+                {
+                    block.used = 0;
+                    freeStagingBlocks.push_back(block);
+                }
+                else
+                {
+                    destroyStagingBlock(block);
+                }
+            }
+            submitted.pop_front();
+        }
+    }
+
+    void VkeUploadQueue::waitIdle()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        flushLocked();
+        retire(true);
+    }
+
+    void VkeUploadQueue::waitForFlushed(VkeSubmitSemaphores &semaphores, VkPipelineStageFlags stage)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (timeline.getSubmittedValue() > 0)
+        {
+            semaphores.wait(timeline.getSemaphore(), stage, timeline.getSubmittedValue());
+        }
+    }
+
+    uint32_t VkeUploadQueue::getBatchesInFlight()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return static_cast<uint32_t>(submitted.size());
+    }
+} // namespace vke
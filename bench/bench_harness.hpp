@@ -0,0 +1,201 @@
+#pragma once
+
+// Timing harness of the CPU microbenchmarks. A case is first calibrated to a batch of operations
+// lasting at least the minimum sample time, then timed over a number of such batches. Results are
+// per operation: the median, and the mean with its 95% confidence interval.
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace vke::bench
+{
+    // keeps the compiler from dropping work whose result is otherwise unused
+    template <typename T>
+    inline void doNotOptimize(const T &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    class Runner
+    {
+    public:
+        // usage: [--samples N] [--min-ms N] [filter ...], cases run when their name contains any filter
+        Runner(int argc, char **argv)
+        {
+            for (int i = 1; i < argc; i++)
+            {
+                std::string argument = argv[i];
+                if (argument == "--samples" && i + 1 < argc)
+                {
+                    samples = std::max(2, std::atoi(argv[++i]));
+                }
+                else if (argument == "--min-ms" && i + 1 < argc)
+                {
+                    minSampleMs = std::max(0.1, std::atof(argv[++i]));
+                }
+                else
+                {
+                    filters.push_back(argument);
+                }
+            }
+            std::printf("%d samples of at least %.1f ms per case, times per operation\n", samples, minSampleMs);
+            std::printf("%-44s %12s %18s %16s\n", "case", "median", "mean +- 95% ci", "throughput");
+        }
+
+        // Times body, one operation per call. items is what one operation processes, in unit, for the
+        // throughput column.
+        template <typename Body>
+        void run(const std::string &name, double items, const char *unit, Body &&body)
+        {
+            if (!selected(name))
+            {
+                return;
+            }
+            // calibrate, doubling the batch until it lasts long enough to time reliably
+            uint64_t batch = 1;
+            while (timeBatch(body, batch) < minSampleMs * 1e6 && batch < (uint64_t{1} << 40))
+            {
+                batch *= 2;
+            }
+
+            std::vector<double> nsPerOperation(samples);
+            for (auto &sample : nsPerOperation)
+            {
+                sample = timeBatch(body, batch) / static_cast<double>(batch);
+            }
+            std::sort(nsPerOperation.begin(), nsPerOperation.end());
+            double median = nsPerOperation[nsPerOperation.size() / 2];
+            double mean = 0.0;
+            for (double sample : nsPerOperation)
+            {
+                mean += sample;
+            }
+            mean /= samples;
+            double variance = 0.0;
+            for (double sample : nsPerOperation)
+            {
+                variance += (sample - mean) * (sample - mean);
+            }
+            variance /= samples - 1;
+            double interval = studentT95(samples - 1) * std::sqrt(variance / samples);
+            double relative = mean > 0.0 ? interval / mean * 100.0 : 0.0;
+
+            // above 5%, the machine was too busy for the result to be compared with another run
+            std::printf("%-44s %12s %10s +-%4.1f%%%s %10s%s/s\n", name.c_str(), formatTime(median).c_str(), formatTime(mean).c_str(),
+                        relative, relative > 5.0 ? "?" : " ", formatCount(items / (median * 1e-9)).c_str(), unit);
+            std::fflush(stdout);
+            caseCount++;
+            if (relative > 5.0)
+            {
+                noisyCount++;
+            }
+        }
+
+        // for cases that also verify what they time, a failed check fails the whole run
+        void check(bool condition, const std::string &what)
+        {
+            if (!condition)
+            {
+                std::printf("check failed: %s\n", what.c_str());
+                failedCount++;
+            }
+        }
+
+        // returns the process exit code
+        int finish() const
+        {
+            if (caseCount == 0)
+            {
+                std::printf("no case matches the filters\n");
+                return EXIT_FAILURE;
+            }
+            if (failedCount > 0)
+            {
+                std::printf("%u checks failed\n", failedCount);
+                return EXIT_FAILURE;
+            }
+            if (noisyCount > 0)
+            {
+                std::printf("%u of %u cases marked ? had a confidence interval above 5%% of the mean\n", noisyCount, caseCount);
+            }
+            return EXIT_SUCCESS;
+        }
+
+    private:
+        bool selected(const std::string &name) const
+        {
+            if (filters.empty())
+            {
+                return true;
+            }
+            return std::any_of(filters.begin(), filters.end(), [&name](const std::string &filter)
+                               { return name.find(filter) != std::string::npos; });
+        }
+
+        template <typename Body>
+        static double timeBatch(Body &body, uint64_t batch)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < batch; i++)
+            {
+                body();
+            }
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::nano>(end - start).count();
+        }
+
+        // two sided 95% quantile of Student's t distribution, Cornish-Fisher expansion around the normal one
+        static double studentT95(int degreesOfFreedom)
+        {
+            constexpr double z = 1.959964;
+            double n = static_cast<double>(degreesOfFreedom);
+            return z + (z * z * z + z) / (4.0 * n) + (5.0 * std::pow(z, 5) + 16.0 * z * z * z + 3.0 * z) / (96.0 * n * n);
+        }
+
+        static std::string formatTime(double nanoseconds)
+        {
+            char text[32];
+            if (nanoseconds < 1e3)
+            {
+                std::snprintf(text, sizeof(text), "%.2f ns", nanoseconds);
+            }
+            else if (nanoseconds < 1e6)
+            {
+                std::snprintf(text, sizeof(text), "%.2f us", nanoseconds * 1e-3);
+            }
+            else
+            {
+                std::snprintf(text, sizeof(text), "%.2f ms", nanoseconds * 1e-6);
+            }
+            return text;
+        }
+
+        static std::string formatCount(double count)
+        {
+            const char *prefixes[] = {" ", " k", " M", " G"};
+            int prefix = 0;
+            while (count >= 1e3 && prefix < 3)
+            {
+                count *= 1e-3;
+                prefix++;
+            }
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.2f%s", count, prefixes[prefix]);
+            return text;
+        }
+
+        int samples = 30;
+        double minSampleMs = 10.0;
+        std::vector<std::string> filters;
+        uint32_t caseCount = 0;
+        uint32_t noisyCount = 0;
+        uint32_t failedCount = 0;
+    };
+} // namespace vke::bench
@@ -0,0 +1,251 @@
+// CPU hot paths of the engine, timed without a GPU. Built and run by `make bench` from the repository
+// root, which is where the models are looked up. Arguments are passed to bench::Runner, for example
+// `bin/cpu_bench camera` only runs the camera cases.
+
+#include "bench_harness.hpp"
+
+#include "camera.hpp"
+#include "components.hpp"
+#include "frame_info.hpp"
+#include "model.hpp"
+#include "scene.hpp"
+#include "settings.hpp"
+#include "static_chunks.hpp"
+#include "utils.hpp"
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t ELEMENT_COUNT = 4096;
+    // a loaded mesh repeats each of its vertices about four times in the face corners
+    constexpr uint32_t UNIQUE_VERTEX_COUNT = 16384;
+    constexpr uint32_t CORNER_COUNT = UNIQUE_VERTEX_COUNT * 4;
+
+    void benchModels(vke::bench::Runner &runner)
+    {
+        std::vector<std::filesystem::path> assets;
+        if (std::filesystem::is_directory("models"))
+        {
+            for (const auto &entry : std::filesystem::directory_iterator{"models"})
+            {
+                if (entry.path().extension() == ".obj")
+                {
+                    assets.push_back(entry.path());
+                }
+            }
+        }
+        std::sort(assets.begin(), assets.end());
+        if (assets.empty())
+        {
+            std::printf("no models/*.obj found, run from the repository root to time model loading\n");
+        }
+
+        for (const auto &asset : assets)
+        {
+            std::string name = asset.filename().string();
+            double fileBytes = static_cast<double>(std::filesystem::file_size(asset));
+            runner.run("Builder::loadModels/" + name, fileBytes, "B", [&]
+                       {
+                vke::VkeModel::Builder builder{};
+                builder.loadModels(asset.string());
+                vke::bench::doNotOptimize(builder.indices.data()); });
+
+            vke::VkeModel::Builder loaded{};
+            loaded.loadModels(asset.string());
+            // includes copying the loaded geometry, small next to the processing itself
+            runner.run("Builder::optimize+meshlets+lods/" + name, static_cast<double>(loaded.indices.size() / 3), "tris", [&]
+                       {
+                vke::VkeModel::Builder builder = loaded;
+                builder.optimize();
+                builder.buildMeshlets();
+                builder.generateLods();
+                vke::bench::doNotOptimize(builder.indices.data()); });
+        }
+    }
+
+    void benchVertexHash(vke::bench::Runner &runner, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit{-1.f, 1.f};
+        std::vector<vke::VkeModel::Vertex> unique(UNIQUE_VERTEX_COUNT);
+        for (auto &vertex : unique)
+        {
+            vertex.position = {unit(rng), unit(rng), unit(rng)};
+            vertex.color = {1.f, 1.f, 1.f};
+            vertex.normal = glm::normalize(glm::vec3{unit(rng), unit(rng), unit(rng)});
+            vertex.uv = {unit(rng), unit(rng)};
+        }
+        std::vector<vke::VkeModel::Vertex> corners(CORNER_COUNT);
+        std::uniform_int_distribution<uint32_t> pick{0, UNIQUE_VERTEX_COUNT - 1};
+        for (auto &corner : corners)
+        {
+            corner = unique[pick(rng)];
+        }
+
+        runner.run("lve::hashCombine/Vertex", CORNER_COUNT, "vertices", [&]
+                   {
+            std::hash<vke::VkeModel::Vertex> hasher{};
+            size_t combined = 0;
+            for (const auto &corner : corners)
+            {
+                combined ^= hasher(corner);
+            }
+            vke::bench::doNotOptimize(combined); });
+
+        // the same lookups Builder::loadModels makes to weld bit identical corners
+        runner.run("Builder::loadModels dedup map/Vertex", CORNER_COUNT, "vertices", [&]
+                   {
+            std::unordered_map<vke::VkeModel::Vertex, uint32_t> uniqueVertices{};
+            std::vector<uint32_t> indices;
+            indices.reserve(corners.size());
+            for (const auto &corner : corners)
+            {
+                if (uniqueVertices.count(corner) == 0)
+                {
+                    uniqueVertices[corner] = static_cast<uint32_t>(uniqueVertices.size());
+                }
+                indices.push_back(uniqueVertices[corner]);
+            }
+            vke::bench::doNotOptimize(indices.data()); });
+    }
+
+    void benchTransforms(vke::bench::Runner &runner, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> position{-100.f, 100.f};
+        std::uniform_real_distribution<float> angle{-6.3f, 6.3f};
+        std::uniform_real_distribution<float> scale{0.1f, 10.f};
+        std::vector<vke::TransformComponent> transforms(ELEMENT_COUNT);
+        for (auto &transform : transforms)
+        {
+            transform.translation = {position(rng), position(rng), position(rng)};
+            transform.rotation = {angle(rng), angle(rng), angle(rng)};
+            transform.scale = {scale(rng), scale(rng), scale(rng)};
+        }
+        std::vector<glm::mat4> worldMatrices(ELEMENT_COUNT);
+        std::vector<glm::mat3> normalMatrices(ELEMENT_COUNT);
+
+        runner.run("TransformComponent::mat4", ELEMENT_COUNT, "transforms", [&]
+                   {
+            for (uint32_t i = 0; i < ELEMENT_COUNT; i++)
+            {
+                worldMatrices[i] = transforms[i].mat4();
+            }
+            vke::bench::doNotOptimize(worldMatrices.data()); });
+        runner.run("TransformComponent::normalMatrix", ELEMENT_COUNT, "transforms", [&]
+                   {
+            for (uint32_t i = 0; i < ELEMENT_COUNT; i++)
+            {
+                normalMatrices[i] = transforms[i].normalMatrix();
+            }
+            vke::bench::doNotOptimize(normalMatrices.data()); });
+
+        vke::VkeCamera camera{};
+        runner.run("VkeCamera::setViewYXZ", ELEMENT_COUNT, "views", [&]
+                   {
+            for (uint32_t i = 0; i < ELEMENT_COUNT; i++)
+            {
+                camera.setViewYXZ(transforms[i].translation, transforms[i].rotation);
+                vke::bench::doNotOptimize(camera);
+            } });
+    }
+
+    // also checks that chunks off screen are dropped and those holding a visible box are kept
+    void benchStaticChunks(vke::bench::Runner &runner, std::mt19937 &rng)
+    {
+        constexpr int GRID_CELLS = 32;
+        constexpr uint32_t BOXES_PER_CELL = 4;
+        std::uniform_real_distribution<float> offset{1.f, STATIC_BATCH_CHUNK_SIZE - 1.f};
+        std::vector<uint32_t> items;
+        std::vector<vke::VkeAabb> itemBounds;
+        for (int x = -GRID_CELLS / 2; x < GRID_CELLS / 2; x++)
+        {
+            for (int z = -GRID_CELLS / 2; z < GRID_CELLS / 2; z++)
+            {
+                for (uint32_t i = 0; i < BOXES_PER_CELL; i++)
+                {
+                    glm::vec3 center = glm::vec3{x, 0.f, z} * STATIC_BATCH_CHUNK_SIZE + glm::vec3{offset(rng), 0.f, offset(rng)};
+                    items.push_back(static_cast<uint32_t>(items.size()));
+                    itemBounds.push_back({center - glm::vec3{1.f}, center + glm::vec3{1.f}});
+                }
+            }
+        }
+
+        // looking down +z from the middle of the grid, so the half behind the camera is off screen
+        vke::VkeCamera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, 0.1f, 100.f);
+        camera.setViewDirection(glm::vec3{0.f}, {0.f, 0.f, 1.f});
+        vke::VkeFrustum frustum = vke::VkeFrustum::fromViewProjection(camera.getProjection() * camera.getView());
+
+        vke::VkeStaticChunks chunks{};
+        std::vector<uint32_t> visible;
+        chunks.build(items, itemBounds);
+        chunks.queryFrustums(&frustum, 1, &visible);
+        runner.check(chunks.getChunkCount() == GRID_CELLS * GRID_CELLS, "VkeStaticChunks::build groups one chunk per cell");
+        std::vector<bool> isVisible(chunks.getChunkCount(), false);
+        for (uint32_t chunk : visible)
+        {
+            isVisible[chunk] = true;
+            runner.check(chunks.getChunk(chunk).bounds.max.z > 0.f, "VkeStaticChunks::queryFrustums drops chunks behind the camera");
+        }
+        for (uint32_t chunk = 0; chunk < chunks.getChunkCount(); chunk++)
+        {
+            for (uint32_t item : chunks.getChunk(chunk).objects)
+            {
+                if (frustum.classify(itemBounds[item]) != vke::VkeFrustum::OUTSIDE)
+                {
+                    runner.check(isVisible[chunk], "VkeStaticChunks::queryFrustums keeps chunks holding a visible box");
+                }
+            }
+        }
+        runner.check(visible.size() < chunks.getChunkCount() / 2, "VkeStaticChunks::queryFrustums drops off screen chunks");
+
+        runner.run("VkeStaticChunks::build", static_cast<double>(items.size()), "boxes", [&]
+                   {
+            chunks.build(items, itemBounds);
+            vke::bench::doNotOptimize(chunks); });
+        runner.run("VkeStaticChunks::queryFrustums", chunks.getChunkCount(), "chunks", [&]
+                   {
+            visible.clear();
+            chunks.queryFrustums(&frustum, 1, &visible);
+            vke::bench::doNotOptimize(visible.data()); });
+    }
+
+    void benchPointLights(vke::bench::Runner &runner, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> position{-50.f, 50.f};
+        for (uint32_t lightCount : {static_cast<uint32_t>(MAX_LIGHTS), 256u})
+        {
+            vke::VkeScene scene{};
+            for (uint32_t i = 0; i < lightCount; i++)
+            {
+                auto light = scene.createPointLight();
+                scene.transforms.setTranslation(scene.transforms.indexOf(light), {position(rng), position(rng), position(rng)});
+            }
+            std::vector<uint32_t> order;
+            glm::vec3 viewer{position(rng), position(rng), position(rng)};
+            runner.run("PointLightStore::sortBackToFront/" + std::to_string(lightCount), lightCount, "lights", [&]
+                       {
+                scene.pointLights.sortBackToFront(scene.transforms, viewer, order);
+                vke::bench::doNotOptimize(order.data()); });
+        }
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    vke::bench::Runner runner{argc, argv};
+    std::mt19937 rng{42};
+    benchModels(runner);
+    benchVertexHash(runner, rng);
+    benchTransforms(runner, rng);
+    benchStaticChunks(runner, rng);
+    benchPointLights(runner, rng);
+    return runner.finish();
+}
@@ -0,0 +1,103 @@
+// Compares the per object TransformComponent path against the batch transform kernels.
+// Built and run by `make bench`.
+
+#include "components.hpp"
+#include "thread_pool.hpp"
+#include "transform_kernels.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t TRANSFORM_COUNT = 100000;
+    constexpr int ITERATIONS = 50;
+
+    // best of ITERATIONS, in milliseconds
+    double measure(const std::function<void()> &body)
+    {
+        double best = 1e30;
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            body();
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+} // namespace
+
+int main()
+{
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> angle{-6.3f, 6.3f};
+    std::uniform_real_distribution<float> scale{0.1f, 10.f};
+
+    std::vector<glm::vec3> translations(TRANSFORM_COUNT);
+    std::vector<glm::vec3> rotations(TRANSFORM_COUNT);
+    std::vector<glm::vec3> scales(TRANSFORM_COUNT);
+    std::vector<vke::TransformComponent> components(TRANSFORM_COUNT);
+    std::vector<uint32_t> indices(TRANSFORM_COUNT);
+    for (uint32_t i = 0; i < TRANSFORM_COUNT; i++)
+    {
+        translations[i] = {position(rng), position(rng), position(rng)};
+        rotations[i] = {angle(rng), angle(rng), angle(rng)};
+        scales[i] = {scale(rng), scale(rng), scale(rng)};
+        components[i].translation = translations[i];
+        components[i].rotation = rotations[i];
+        components[i].scale = scales[i];
+        indices[i] = i;
+    }
+    std::vector<glm::mat4> worldMatrices(TRANSFORM_COUNT);
+    std::vector<glm::mat4> normalMatrices(TRANSFORM_COUNT);
+
+    double glmPath = measure([&]
+                             {
+        for (uint32_t i = 0; i < TRANSFORM_COUNT; i++)
+        {
+            worldMatrices[i] = components[i].mat4();
+            normalMatrices[i] = glm::mat4{components[i].normalMatrix()};
+        } });
+    std::vector<glm::mat4> reference = worldMatrices;
+
+    double scalarKernel = measure([&]
+                                  { vke::computeTransformMatricesScalar(translations.data(), rotations.data(), scales.data(), indices.data(), TRANSFORM_COUNT, worldMatrices.data(), normalMatrices.data()); });
+    double vectorKernel = measure([&]
+                                  { vke::computeTransformMatrices(translations.data(), rotations.data(), scales.data(), indices.data(), TRANSFORM_COUNT, worldMatrices.data(), normalMatrices.data()); });
+
+    vke::VkeThreadPool threadPool{};
+    double threadedKernel = measure([&]
+                                    { threadPool.parallelFor(
+                                          TRANSFORM_COUNT,
+                                          [&](uint32_t begin, uint32_t end, uint32_t)
+                                          { vke::computeTransformMatrices(translations.data(), rotations.data(), scales.data(), indices.data() + begin, end - begin, worldMatrices.data(), normalMatrices.data()); },
+                                          1024); });
+
+    float maxError = 0.f;
+    for (uint32_t i = 0; i < TRANSFORM_COUNT; i++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                maxError = std::max(maxError, std::abs(worldMatrices[i][column][row] - reference[i][column][row]));
+            }
+        }
+    }
+
+    std::printf("%u transforms, best of %d runs\n", TRANSFORM_COUNT, ITERATIONS);
+    std::printf("  glm per object        %8.3f ms\n", glmPath);
+    std::printf("  batch scalar          %8.3f ms  %.2fx\n", scalarKernel, glmPath / scalarKernel);
+    std::printf("  batch %-6s          %8.3f ms  %.2fx\n", vke::getTransformKernelName(), vectorKernel, glmPath / vectorKernel);
+    std::printf("  batch %-6s x%-2u threads %6.3f ms  %.2fx\n", vke::getTransformKernelName(), threadPool.getThreadCount(), threadedKernel, glmPath / threadedKernel);
+    std::printf("  max abs error vs glm  %g\n", maxError);
+    return 0;
+}